@@ -0,0 +1,127 @@
+// gethostname e getpid sono POSIX e non fanno parte di C99
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "autotune.h"
+
+#define AUTOTUNE_LINE_LEN 512
+#define AUTOTUNE_HOST_LEN 256
+
+/**
+ * Funzione che scrive la chiave di una scelta: nome dell'host, numero massimo di thread, dimensione spaziale e intervallo di numeri di
+ * corpi [2^k, 2^(k+1) - 1] che contiene nBodies.
+ */
+static void cache_key(const int nBodies, const int spatialDim, const int maxThreads, char *key)
+{
+    char host[AUTOTUNE_HOST_LEN] = "unknown";
+    int low = 1;
+
+    if (gethostname(host, AUTOTUNE_HOST_LEN) != 0)
+    {
+        strcpy(host, "unknown");
+    }
+    host[AUTOTUNE_HOST_LEN - 1] = '\0';
+
+    while (low <= nBodies / 2)
+    {
+        low *= 2;
+    }
+
+    snprintf(key, AUTOTUNE_LINE_LEN, "%s %d %d %d %d", host, maxThreads, spatialDim, low, 2 * low - 1);
+}
+
+void autotune_cache_path(const char *cachePath, char *path)
+{
+    const char *home = getenv("HOME");
+
+    if (cachePath[0] != '\0')
+    {
+        snprintf(path, FILENAME_MAX, "%s", cachePath);
+    }
+    else if (home)
+    {
+        snprintf(path, FILENAME_MAX, "%s/%s", home, AUTOTUNE_CACHE_NAME);
+    }
+    else
+    {
+        snprintf(path, FILENAME_MAX, "%s", AUTOTUNE_CACHE_NAME);
+    }
+}
+
+int autotune_lookup(const char *path, const int nBodies, const int spatialDim, const int maxThreads, AutotuneChoice *choice)
+{
+    char key[AUTOTUNE_LINE_LEN], line[AUTOTUNE_LINE_LEN];
+    int found = 0;
+    FILE *cacheFile = fopen(path, "r");
+
+    cache_key(nBodies, spatialDim, maxThreads, key);
+
+    // la chiave è seguita da uno spazio, così un host che è prefisso di un altro non viene confuso con quello
+    while (cacheFile && !found && fgets(line, AUTOTUNE_LINE_LEN, cacheFile))
+    {
+        size_t len = strlen(key);
+
+        if (strncmp(line, key, len) == 0 && line[len] == ' ' &&
+            sscanf(line + len, "%31s %d %lf", choice->variant, &choice->threads, &choice->seconds) == 3)
+        {
+            found = 1;
+        }
+    }
+
+    if (cacheFile)
+    {
+        fclose(cacheFile);
+    }
+
+    return found;
+}
+
+int autotune_store(const char *path, const int nBodies, const int spatialDim, const int maxThreads, const AutotuneChoice *choice)
+{
+    char key[AUTOTUNE_LINE_LEN], line[AUTOTUNE_LINE_LEN], tmpPath[FILENAME_MAX + 32];
+    size_t len;
+
+    cache_key(nBodies, spatialDim, maxThreads, key);
+    len = strlen(key);
+
+    // il file temporaneo ha il pid nel nome perché più processi (ad esempio i rami di un insieme) possono aggiornare la cache insieme
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%ld.tmp", path, (long)getpid());
+
+    FILE *outFile = fopen(tmpPath, "w");
+    if (!outFile)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", tmpPath);
+        return -1;
+    }
+
+    fprintf(outFile, "# autotune cache: host threads dim nmin nmax variant threads seconds_per_step\n");
+
+    FILE *cacheFile = fopen(path, "r");
+    while (cacheFile && fgets(line, AUTOTUNE_LINE_LEN, cacheFile))
+    {
+        if (line[0] == '#' || (strncmp(line, key, len) == 0 && line[len] == ' '))
+        {
+            continue;
+        }
+        fputs(line, outFile);
+    }
+    if (cacheFile)
+    {
+        fclose(cacheFile);
+    }
+
+    fprintf(outFile, "%s %s %d %.6e\n", key, choice->variant, choice->threads, choice->seconds);
+
+    if (fclose(outFile) != 0 || rename(tmpPath, path) != 0)
+    {
+        fprintf(stderr, "\nImpossibile scrivere il file: %s\n\n", path);
+        remove(tmpPath);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+// nome del file della cache nella cartella home (nella cartella corrente se HOME non è definita)
+#define AUTOTUNE_CACHE_NAME ".three_body_autotune"
+#define AUTOTUNE_NAME_LEN 32
+
+// ogni variante viene misurata per almeno AUTOTUNE_MIN_STEPS passi e AUTOTUNE_MIN_SECONDS secondi, ma dopo AUTOTUNE_MIN_STEPS passi
+// viene scartata appena è più lenta di AUTOTUNE_SLOWDOWN volte la migliore trovata fino a quel momento
+#define AUTOTUNE_MIN_STEPS 4
+#define AUTOTUNE_MIN_SECONDS 0.02
+#define AUTOTUNE_SLOWDOWN 2.
+
+/**
+ * Scelta dell'autotuning:
+ * - variant : nome della variante del calcolo della forza;
+ * - threads : numero di thread OpenMP;
+ * - seconds : tempo misurato per passo di integrazione.
+ */
+typedef struct
+{
+    char variant[AUTOTUNE_NAME_LEN];
+    int threads;
+    double seconds;
+} AutotuneChoice;
+
+/**
+ * Funzione che scrive in path il percorso della cache: cachePath se non è vuoto, altrimenti AUTOTUNE_CACHE_NAME nella cartella home.
+ *
+ * @param cachePath Percorso scelto dall'utente (stringa vuota per quello di default).
+ * @param path Stringa di almeno FILENAME_MAX caratteri in cui salvare il percorso.
+ */
+void autotune_cache_path(const char *cachePath, char *path);
+
+/**
+ * Funzione che cerca nella cache la scelta salvata per questa macchina (nome dell'host e numero massimo di thread OpenMP), la
+ * dimensione spaziale e l'intervallo di numeri di corpi [2^k, 2^(k+1)) che contiene nBodies.
+ *
+ * @param path Percorso della cache.
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param maxThreads Numero massimo di thread OpenMP disponibili, letto prima che l'autotuning lo cambi.
+ * @param choice Puntatore alla struct in cui salvare la scelta trovata.
+ *
+ * @return 1 se la scelta è presente nella cache, 0 altrimenti (anche se la cache non esiste).
+ */
+int autotune_lookup(const char *path, const int nBodies, const int spatialDim, const int maxThreads, AutotuneChoice *choice);
+
+/**
+ * Funzione che salva una scelta nella cache, sostituendo quella con la stessa chiave (vedere autotune_lookup) se presente. La cache
+ * viene riscritta in un file temporaneo e poi rinominata, così un processo che la legge non trova mai un file scritto a metà.
+ *
+ * @param path Percorso della cache.
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param maxThreads Numero massimo di thread OpenMP disponibili (lo stesso passato a autotune_lookup).
+ * @param choice Puntatore alla scelta da salvare.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int autotune_store(const char *path, const int nBodies, const int spatialDim, const int maxThreads, const AutotuneChoice *choice);
+
+#endif
@@ -0,0 +1,124 @@
+// fork, exec, waitpid, mkdir, setenv e realpath (estensione XSI) sono POSIX e non fanno parte di C99
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "branch.h"
+
+int branch_procs(void)
+{
+#ifdef _OPENMP
+    return omp_get_num_procs();
+#else
+    long procs = sysconf(_SC_NPROCESSORS_ONLN);
+    return procs > 0 ? (int)procs : 1;
+#endif
+}
+
+int branch_dir(const int k, char *dir)
+{
+    snprintf(dir, FILENAME_MAX, BRANCH_DIR_FORMAT, k);
+
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+    {
+        fprintf(stderr, "\nImpossibile creare la cartella: %s\n\n", dir);
+        return -1;
+    }
+
+    return 0;
+}
+
+int branch_run(const char *program, const int nBranches, const int jobs)
+{
+    // i figli cambiano cartella prima di eseguire il programma, quindi un percorso relativo va reso assoluto (senza '/' il programma
+    // viene invece cercato nel PATH da execvp)
+    char *path = strchr(program, '/') ? realpath(program, NULL) : strdup(program);
+    pid_t *pids = (pid_t *)malloc(nBranches * sizeof(pid_t));
+
+    if (!path || !pids)
+    {
+        fprintf(stderr, "\nImpossibile preparare l'esecuzione dei rami.\n\n");
+        free(path);
+        free(pids);
+        return -1;
+    }
+
+    // il valore viene impostato prima di fork, perché tra fork ed exec il figlio può chiamare solo funzioni sicure
+    char threads[32];
+    int perBranch = branch_procs() / jobs;
+    snprintf(threads, sizeof(threads), "%d", perBranch > 0 ? perBranch : 1);
+    setenv("OMP_NUM_THREADS", threads, 1);
+
+    int launched = 0, running = 0, failed = 0;
+
+    while (launched < nBranches || running > 0)
+    {
+        if (launched < nBranches && running < jobs)
+        {
+            char dir[FILENAME_MAX];
+            snprintf(dir, FILENAME_MAX, BRANCH_DIR_FORMAT, launched);
+
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                char *args[] = {path, BRANCH_INPUT, NULL};
+                if (chdir(dir) == 0)
+                {
+                    execvp(path, args);
+                }
+                _exit(127);
+            }
+            if (pid == -1)
+            {
+                fprintf(stderr, "\nImpossibile avviare il ramo %d.\n\n", launched);
+                failed += nBranches - launched;
+                launched = nBranches;
+                continue;
+            }
+
+            pids[launched++] = pid;
+            running++;
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (pid == -1)
+        {
+            break;
+        }
+        running--;
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            int k = 0;
+            while (k < launched && pids[k] != pid)
+            {
+                k++;
+            }
+
+            fprintf(stderr, "Il ramo %d (" BRANCH_DIR_FORMAT ") è terminato con errore.\n", k, k);
+            failed++;
+        }
+    }
+
+    free(path);
+    free(pids);
+
+    return failed;
+}
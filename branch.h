@@ -0,0 +1,37 @@
+#ifndef BRANCH_H
+#define BRANCH_H
+
+// cartella di ogni ramo (con il suo numero, da 0) e nome del file di input scritto al suo interno
+#define BRANCH_DIR_FORMAT "branch_%04d"
+#define BRANCH_INPUT "input.dat"
+
+/**
+ * Funzione che restituisce il numero di processori disponibili (omp_get_num_procs, o sysconf se il programma è compilato senza OpenMP).
+ */
+int branch_procs(void);
+
+/**
+ * Funzione che crea (se non esiste già) la cartella del ramo k e ne scrive il nome in dir.
+ *
+ * @param k Numero del ramo.
+ * @param dir Stringa di almeno FILENAME_MAX caratteri in cui salvare il nome della cartella.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int branch_dir(const int k, char *dir);
+
+/**
+ * Funzione che esegue i rami di un insieme: per ogni ramo avvia un processo del programma program con argomento BRANCH_INPUT nella
+ * cartella del ramo, da cui legge il file di input e in cui scrive i file di output. Al più jobs processi vengono eseguiti insieme,
+ * ognuno con OMP_NUM_THREADS impostato così da dividere tra loro i processori disponibili. La funzione ritorna quando tutti i rami
+ * sono terminati e segnala su stderr quelli falliti.
+ *
+ * @param program Percorso del programma da eseguire (tipicamente argv[0]).
+ * @param nBranches Numero di rami.
+ * @param jobs Numero massimo di rami eseguiti contemporaneamente.
+ *
+ * @return -1 se non è stato possibile avviare i processi, altrimenti il numero di rami terminati con errore.
+ */
+int branch_run(const char *program, const int nBranches, const int jobs);
+
+#endif
@@ -0,0 +1,430 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "collisions.h"
+
+// le coordinate di cella vengono limitate a questo valore, così i corpi molto lontani (ad esempio in fuga) non causano overflow
+#define COLLISIONS_MAX_CELL 1000000000000L
+
+// Stato del rilevamento, impostato da collisions_setup. La tabella hash ha nBuckets liste doppiamente concatenate (head, next, prev):
+// ogni corpo sta nella lista della propria cella, quindi può essere spostato in O(1) quando cambia cella.
+static FILE *outFile = NULL;
+static int response = COLLISIONS_NONE;
+static int nB = 0;
+static int dim = 0;
+static long double cellSize = 0.L;
+static unsigned long long bucketMask = 0;
+static int *head = NULL;
+static int *next = NULL;
+static int *prev = NULL;
+static int *bucketOf = NULL;
+static long int *cells = NULL;
+static int *ids = NULL;     // numero di ogni corpo nel file di input
+static int *partner = NULL; // -1, il corpo con cui si fonde in questa chiamata, oppure -2 se rimosso da una fusione
+static int *merged = NULL;  // indici minori delle coppie da fondere
+static int nOffsets = 0;    // celle vicine di una cella (3^dim, compresa la cella stessa)
+static int *visited = NULL; // liste delle celle vicine già visitate
+static long int *nearCell = NULL;
+static long double *sep = NULL; // distanza e velocità relativa di una coppia (dim valori ciascuna)
+
+static long int cell_coord(const long double x)
+{
+    long double c = floorl(x / cellSize);
+
+    if (c > COLLISIONS_MAX_CELL)
+    {
+        return COLLISIONS_MAX_CELL;
+    }
+    if (c < -COLLISIONS_MAX_CELL)
+    {
+        return -COLLISIONS_MAX_CELL;
+    }
+    return (long int)c;
+}
+
+/**
+ * Funzione che calcola la lista della tabella hash di una cella (hash FNV-1a sulle coordinate intere). Celle diverse possono finire
+ * nella stessa lista: la distanza viene comunque controllata per ogni coppia.
+ */
+static int hash_cell(const long int *c)
+{
+    unsigned long long h = 1469598103934665603ULL;
+
+    for (int k = 0; k < dim; k++)
+    {
+        h = (h ^ (unsigned long long)c[k]) * 1099511628211ULL;
+    }
+
+    return (int)(h & bucketMask);
+}
+
+static void link_body(const int i, const int b)
+{
+    bucketOf[i] = b;
+    prev[i] = -1;
+    next[i] = head[b];
+    if (head[b] != -1)
+    {
+        prev[head[b]] = i;
+    }
+    head[b] = i;
+}
+
+static void unlink_body(const int i)
+{
+    if (prev[i] != -1)
+    {
+        next[prev[i]] = next[i];
+    }
+    else
+    {
+        head[bucketOf[i]] = next[i];
+    }
+
+    if (next[i] != -1)
+    {
+        prev[next[i]] = prev[i];
+    }
+}
+
+/**
+ * Funzione che ricostruisce da zero la griglia, con lato delle celle pari al doppio del raggio massimo: due corpi che si toccano
+ * stanno quindi in celle adiacenti.
+ */
+static void build_grid(const long double *coord, const long double *radii)
+{
+    long double maxRadius = 0.L;
+
+    for (int i = 0; i < nB; i++)
+    {
+        maxRadius = radii[i] > maxRadius ? radii[i] : maxRadius;
+    }
+    cellSize = 2.L * maxRadius;
+
+    for (unsigned long long b = 0; b <= bucketMask; b++)
+    {
+        head[b] = -1;
+    }
+
+    for (int i = 0; i < nB; i++)
+    {
+        for (int k = 0; k < dim; k++)
+        {
+            cells[k + i * dim] = cell_coord(coord[k + i * dim]);
+        }
+        link_body(i, hash_cell(cells + i * dim));
+    }
+}
+
+/**
+ * Funzione che aggiorna la griglia dopo un passo di integrazione, spostando solo i corpi che hanno cambiato cella.
+ */
+static void update_grid(const long double *coord)
+{
+    for (int i = 0; i < nB; i++)
+    {
+        int moved = 0;
+
+        for (int k = 0; k < dim; k++)
+        {
+            long int c = cell_coord(coord[k + i * dim]);
+            moved |= c != cells[k + i * dim];
+            cells[k + i * dim] = c;
+        }
+
+        if (moved)
+        {
+            int b = hash_cell(cells + i * dim);
+            if (b != bucketOf[i])
+            {
+                unlink_body(i);
+                link_body(i, b);
+            }
+        }
+    }
+}
+
+int collisions_setup(const char *path, const int mode, const int nBodies, const int spatialDim, const long double *coord,
+                     const long double *radii)
+{
+    long double maxRadius = 0.L;
+    for (int i = 0; i < nBodies; i++)
+    {
+        maxRadius = radii[i] > maxRadius ? radii[i] : maxRadius;
+    }
+
+    if (maxRadius <= 0.L)
+    {
+        fprintf(stderr, "\nLe collisioni richiedono corpi di raggio positivo (colonna del raggio o header density).\n\n");
+        return -1;
+    }
+
+    response = mode;
+    nB = nBodies;
+    dim = spatialDim;
+    nOffsets = 1;
+    for (int k = 0; k < dim; k++)
+    {
+        nOffsets *= 3;
+    }
+
+    // almeno due liste per corpo, in numero pari a una potenza di 2 per calcolare la lista con una maschera
+    bucketMask = 15;
+    while (bucketMask + 1 < 2ULL * nBodies)
+    {
+        bucketMask = 2 * bucketMask + 1;
+    }
+
+    head = (int *)malloc((bucketMask + 1) * sizeof(int));
+    next = (int *)malloc(nBodies * sizeof(int));
+    prev = (int *)malloc(nBodies * sizeof(int));
+    bucketOf = (int *)malloc(nBodies * sizeof(int));
+    cells = (long int *)malloc(nBodies * spatialDim * sizeof(long int));
+    ids = (int *)malloc(nBodies * sizeof(int));
+    partner = (int *)malloc(nBodies * sizeof(int));
+    merged = (int *)malloc(nBodies * sizeof(int));
+    visited = (int *)malloc(nOffsets * sizeof(int));
+    nearCell = (long int *)malloc(spatialDim * sizeof(long int));
+    sep = (long double *)malloc(2 * spatialDim * sizeof(long double));
+
+    if (!head || !next || !prev || !bucketOf || !cells || !ids || !partner || !merged || !visited || !nearCell || !sep)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        collisions_free();
+        return -1;
+    }
+
+    outFile = fopen(path, "w");
+    if (!outFile)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", path);
+        collisions_free();
+        return -1;
+    }
+    fprintf(outFile, "#format:\t time\t type\t body 1\t body 2\t relative speed\n");
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        ids[i] = i + 1;
+        partner[i] = -1;
+    }
+
+    build_grid(coord, radii);
+
+    return 0;
+}
+
+/**
+ * Funzione che calcola l'energia potenziale tra un corpo di massa m in x e tutti i corpi non rimossi diversi da skip1 e skip2.
+ */
+static long double potential_with_others(const long double *x, const long double m, const int skip1, const int skip2,
+                                         const long double G, const long double *masses, const long double *coord)
+{
+    long double pot = 0.L;
+
+    for (int k = 0; k < nB; k++)
+    {
+        if (k == skip1 || k == skip2 || partner[k] == -2)
+        {
+            continue;
+        }
+
+        long double d2 = 0.L;
+        for (int c = 0; c < dim; c++)
+        {
+            long double diff = x[c] - coord[c + k * dim];
+            d2 += diff * diff;
+        }
+
+        pot += -G * m * masses[k] / sqrtl(d2);
+    }
+
+    return pot;
+}
+
+/**
+ * Funzione che fonde il corpo j nel corpo i e restituisce la variazione dell'energia totale.
+ */
+static long double merge_pair(const int i, const int j, const long double G, long double *masses, long double *coord, long double *vel,
+                              long double *radii)
+{
+    long double *xi = coord + i * dim, *xj = coord + j * dim, *vi = vel + i * dim, *vj = vel + j * dim;
+    long double m = masses[i] + masses[j], d2 = 0.L, kOld = 0.L, kNew = 0.L;
+
+    for (int k = 0; k < dim; k++)
+    {
+        d2 += (xi[k] - xj[k]) * (xi[k] - xj[k]);
+    }
+
+    long double potOld = -G * masses[i] * masses[j] / sqrtl(d2) + potential_with_others(xi, masses[i], i, j, G, masses, coord) +
+                         potential_with_others(xj, masses[j], i, j, G, masses, coord);
+
+    for (int k = 0; k < dim; k++)
+    {
+        kOld += 0.5L * (masses[i] * vi[k] * vi[k] + masses[j] * vj[k] * vj[k]);
+
+        xi[k] = (masses[i] * xi[k] + masses[j] * xj[k]) / m;
+        vi[k] = (masses[i] * vi[k] + masses[j] * vj[k]) / m;
+
+        kNew += 0.5L * m * vi[k] * vi[k];
+    }
+
+    masses[i] = m;
+    radii[i] = cbrtl(radii[i] * radii[i] * radii[i] + radii[j] * radii[j] * radii[j]);
+    partner[i] = -1;
+    partner[j] = -2;
+
+    return kNew - kOld + potential_with_others(xi, m, i, j, G, masses, coord) - potOld;
+}
+
+int collisions_step(const long double time, const long double G, int *nBodies, long double *masses, long double *coord, long double *vel,
+                    long double *radii, long double *energyJump)
+{
+    int nMerged = 0;
+    long int *c = nearCell;
+    long double *d = sep, *dv = sep + dim;
+
+    *energyJump = 0.L;
+    update_grid(coord);
+
+    for (int i = 0; i < nB; i++)
+    {
+        // celle vicine già visitate: più celle possono condividere una lista, che va però scorsa una volta sola
+        int nVisited = 0;
+
+        for (int o = 0; o < nOffsets && partner[i] == -1; o++)
+        {
+            for (int k = 0, t = o; k < dim; k++, t /= 3)
+            {
+                c[k] = cells[k + i * dim] + t % 3 - 1;
+            }
+
+            int b = hash_cell(c), seen = 0;
+            for (int v = 0; v < nVisited; v++)
+            {
+                seen |= visited[v] == b;
+            }
+            if (seen)
+            {
+                continue;
+            }
+            visited[nVisited++] = b;
+
+            for (int j = head[b]; j != -1 && partner[i] == -1; j = next[j])
+            {
+                if (j <= i || partner[j] != -1)
+                {
+                    continue;
+                }
+
+                long double d2 = 0.L, dot = 0.L, v2 = 0.L, rSum = radii[i] + radii[j];
+                for (int k = 0; k < dim; k++)
+                {
+                    d[k] = coord[k + i * dim] - coord[k + j * dim];
+                    dv[k] = vel[k + i * dim] - vel[k + j * dim];
+                    d2 += d[k] * d[k];
+                    dot += d[k] * dv[k];
+                    v2 += dv[k] * dv[k];
+                }
+
+                if (d2 >= rSum * rSum)
+                {
+                    continue;
+                }
+
+                if (response == COLLISIONS_MERGE)
+                {
+                    partner[i] = j;
+                    partner[j] = i;
+                    merged[nMerged++] = i;
+                    fprintf(outFile, "%.9Lf merge %d %d %.9Le\n", time, ids[i], ids[j], sqrtl(v2));
+                }
+                else if (dot < 0.L)
+                {
+                    // impulso lungo la congiungente che inverte la componente normale della velocità relativa
+                    long double impulse = -2.L * masses[i] * masses[j] / (masses[i] + masses[j]) * dot / d2;
+
+                    for (int k = 0; k < dim; k++)
+                    {
+                        vel[k + i * dim] += impulse / masses[i] * d[k];
+                        vel[k + j * dim] -= impulse / masses[j] * d[k];
+                    }
+                    fprintf(outFile, "%.9Lf bounce %d %d %.9Le\n", time, ids[i], ids[j], sqrtl(v2));
+                }
+            }
+        }
+    }
+
+    if (nMerged == 0)
+    {
+        return 0;
+    }
+
+    for (int p = 0; p < nMerged; p++)
+    {
+        *energyJump += merge_pair(merged[p], partner[merged[p]], G, masses, coord, vel, radii);
+    }
+
+    // compattazione dei vettori mantenendo l'ordine dei corpi rimasti
+    int w = 0;
+    for (int r = 0; r < nB; r++)
+    {
+        if (partner[r] == -2)
+        {
+            continue;
+        }
+
+        masses[w] = masses[r];
+        radii[w] = radii[r];
+        ids[w] = ids[r];
+        partner[w] = -1;
+        for (int k = 0; k < dim; k++)
+        {
+            coord[k + w * dim] = coord[k + r * dim];
+            vel[k + w * dim] = vel[k + r * dim];
+        }
+        w++;
+    }
+
+    nB = w;
+    *nBodies = w;
+
+    // gli indici sono cambiati e il raggio massimo può essere cresciuto
+    build_grid(coord, radii);
+
+    return nMerged;
+}
+
+void collisions_free(void)
+{
+    if (outFile)
+    {
+        fclose(outFile);
+    }
+
+    free(head);
+    free(next);
+    free(prev);
+    free(bucketOf);
+    free(cells);
+    free(ids);
+    free(partner);
+    free(merged);
+    free(visited);
+    free(nearCell);
+    free(sep);
+
+    outFile = NULL;
+    head = NULL;
+    next = NULL;
+    prev = NULL;
+    bucketOf = NULL;
+    cells = NULL;
+    ids = NULL;
+    partner = NULL;
+    merged = NULL;
+    visited = NULL;
+    nearCell = NULL;
+    sep = NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef COLLISIONS_H
+#define COLLISIONS_H
+
+// risposte alle collisioni selezionabili con l'header opzionale "collisions"
+#define COLLISIONS_NONE 0
+#define COLLISIONS_MERGE 1
+#define COLLISIONS_BOUNCE 2
+
+/**
+ * Funzione che prepara il rilevamento delle collisioni tra corpi di raggio finito e apre il file delle collisioni. Due corpi collidono
+ * quando la loro distanza è minore della somma dei raggi. Le coppie candidate vengono cercate con una griglia uniforme di celle di lato
+ * pari al doppio del raggio massimo, indicizzata da una tabella hash: ogni corpo viene confrontato solo con quelli delle 3^spatialDim
+ * celle vicine, quindi la ricerca costa O(N) invece di O(N^2).
+ *
+ * Ogni riga del file delle collisioni contiene: tempo, tipo ("merge" o "bounce"), i numeri dei due corpi nel file di input e la loro
+ * velocità relativa.
+ *
+ * @param path Percorso del file delle collisioni.
+ * @param mode Risposta alle collisioni (COLLISIONS_MERGE o COLLISIONS_BOUNCE).
+ * @param nBodies Numero di corpi iniziale.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param coord Puntatore al vettore delle posizioni iniziali.
+ * @param radii Puntatore al vettore dei raggi (almeno uno positivo).
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int collisions_setup(const char *path, const int mode, const int nBodies, const int spatialDim, const long double *coord,
+                     const long double *radii);
+
+/**
+ * Funzione che rileva le collisioni nello stato attuale e applica la risposta configurata. Prima aggiorna la griglia in modo
+ * incrementale: vengono spostati nella tabella solo i corpi che hanno cambiato cella.
+ * - COLLISIONS_BOUNCE : urto elastico tra sfere rigide, applicato solo se i corpi si stanno avvicinando. Cambiano solo le velocità, in
+ * modo da conservare quantità di moto ed energia cinetica, quindi le forze restano valide.
+ * - COLLISIONS_MERGE : fusione perfettamente anelastica. Il corpo con indice minore diventa quello risultante (massa totale, posizione
+ * del centro di massa, velocità che conserva la quantità di moto, raggio che conserva il volume) e l'altro viene rimosso dai vettori,
+ * che vengono compattati mantenendo l'ordine dei corpi rimasti. Un corpo partecipa al più a una fusione per chiamata: le altre
+ * sovrapposizioni vengono risolte alla chiamata successiva.
+ *
+ * @param time Tempo fisico (per il file delle collisioni).
+ * @param G Costante di gravitazione (per la variazione dell'energia).
+ * @param nBodies Puntatore al numero di corpi, aggiornato dopo le fusioni.
+ * @param masses Puntatore al vettore delle masse.
+ * @param coord Puntatore al vettore delle posizioni.
+ * @param vel Puntatore al vettore delle velocità.
+ * @param radii Puntatore al vettore dei raggi.
+ * @param energyJump Puntatore in cui salvare la variazione dell'energia totale dovuta alle fusioni (energia cinetica dissipata e
+ * cambio dell'energia potenziale), da togliere all'errore di integrazione.
+ *
+ * @return Numero di fusioni eseguite: se maggiore di 0 le forze vanno ricalcolate.
+ */
+int collisions_step(const long double time, const long double G, int *nBodies, long double *masses, long double *coord, long double *vel,
+                    long double *radii, long double *energyJump);
+
+/**
+ * Funzione che chiude il file delle collisioni e libera la memoria allocata da collisions_setup. Non fa nulla se collisions_setup non è
+ * stata chiamata.
+ */
+void collisions_free(void);
+
+#endif
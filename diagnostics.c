@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "diagnostics.h"
+#include "repro.h"
+
+// sotto questo numero di corpi le somme vengono calcolate da un solo thread (il risultato non cambia)
+#define DIAGNOSTICS_PARALLEL_MIN 4096
+
+static int n_angular(const int spatialDim)
+{
+    return spatialDim * (spatialDim - 1) / 2;
+}
+
+/**
+ * Funzione che calcola quantità di moto, momento angolare (componenti L_ab con a < b), posizione e velocità del centro di massa,
+ * salvandoli in quest'ordine in values. Le somme sui corpi sono riproducibili come quelle di repro.h: ogni blocco di REPRO_BLOCK corpi
+ * viene sommato in ordine in blocks (i blocchi in parallelo), poi i blocchi vengono combinati con un albero binario fisso.
+ */
+static void reduce(const int nMassive, const int spatialDim, const long double *masses, const long double *coord, const long double *vel,
+                   long double *values, long double *blocks)
+{
+    int nL = n_angular(spatialDim), nValues = 3 * spatialDim + nL, nSums = 1 + 2 * spatialDim + nL;
+    int nBlocks = (nMassive + REPRO_BLOCK - 1) / REPRO_BLOCK;
+
+    // in ogni blocco: massa totale, quantità di moto, momento angolare e momento di massa (per il centro di massa)
+#pragma omp parallel for if (nMassive >= DIAGNOSTICS_PARALLEL_MIN) schedule(static)
+    for (int blk = 0; blk < nBlocks; blk++)
+    {
+        long double *sums = blocks + blk * nSums, *P = sums + 1, *L = P + spatialDim, *com = L + nL;
+        int end = (blk + 1) * REPRO_BLOCK < nMassive ? (blk + 1) * REPRO_BLOCK : nMassive;
+
+        for (int i = 0; i < nSums; i++)
+        {
+            sums[i] = 0.L;
+        }
+
+        for (int j = blk * REPRO_BLOCK; j < end; j++)
+        {
+            const long double *x = coord + j * spatialDim, *v = vel + j * spatialDim;
+            int l = 0;
+
+            sums[0] += masses[j];
+
+            for (int a = 0; a < spatialDim; a++)
+            {
+                P[a] += masses[j] * v[a];
+                com[a] += masses[j] * x[a];
+
+                for (int b = a + 1; b < spatialDim; b++, l++)
+                {
+                    L[l] += masses[j] * (x[a] * v[b] - x[b] * v[a]);
+                }
+            }
+        }
+    }
+
+    for (int stride = 1; stride < nBlocks; stride *= 2)
+    {
+        for (int blk = 0; blk + stride < nBlocks; blk += 2 * stride)
+        {
+            for (int i = 0; i < nSums; i++)
+            {
+                blocks[i + blk * nSums] += blocks[i + (blk + stride) * nSums];
+            }
+        }
+    }
+
+    long double mTot = blocks[0];
+
+    for (int i = 0; i < nValues - spatialDim; i++)
+    {
+        values[i] = blocks[1 + i];
+    }
+
+    long double *P = values, *com = values + spatialDim + nL, *vcom = com + spatialDim;
+    for (int a = 0; a < spatialDim; a++)
+    {
+        com[a] /= mTot;
+        vcom[a] = P[a] / mTot;
+    }
+}
+
+Diagnostics *diagnostics_create(const char *path, const int cadence, const int nMassive, const int spatialDim, const long double *masses,
+                                const long double *coord, const long double *vel, const long double time0, const long double energy0)
+{
+    Diagnostics *diag = (Diagnostics *)calloc(1, sizeof(Diagnostics));
+    if (!diag)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return NULL;
+    }
+
+    diag->nMassive = nMassive;
+    diag->spatialDim = spatialDim;
+    diag->cadence = cadence;
+    diag->energy0 = energy0;
+    diag->energyScale = fabsl(energy0);
+    diag->time0 = time0;
+    diag->com0 = (long double *)malloc(spatialDim * sizeof(long double));
+    diag->vcom0 = (long double *)malloc(spatialDim * sizeof(long double));
+    diag->values = (long double *)malloc((3 * spatialDim + n_angular(spatialDim)) * sizeof(long double));
+    diag->blocks = (long double *)malloc(((nMassive + REPRO_BLOCK - 1) / REPRO_BLOCK) * (1 + 2 * spatialDim + n_angular(spatialDim)) *
+                                         sizeof(long double));
+
+    if (!diag->com0 || !diag->vcom0 || !diag->values || !diag->blocks)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        diagnostics_free(diag);
+        return NULL;
+    }
+
+    diag->file = fopen(path, "w");
+    if (!diag->file)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", path);
+        diagnostics_free(diag);
+        return NULL;
+    }
+
+    reduce(nMassive, spatialDim, masses, coord, vel, diag->values, diag->blocks);
+    for (int a = 0; a < spatialDim; a++)
+    {
+        diag->com0[a] = diag->values[spatialDim + n_angular(spatialDim) + a];
+        diag->vcom0[a] = diag->values[2 * spatialDim + n_angular(spatialDim) + a];
+    }
+
+    fprintf(diag->file, "#format:\t time\t momentum: (");
+    for (int a = 0; a < spatialDim; a++)
+    {
+        fprintf(diag->file, " P%d", a);
+    }
+    fprintf(diag->file, ")\t angular momentum: (");
+    if (spatialDim == 3)
+    {
+        fprintf(diag->file, " Lx Ly Lz");
+    }
+    else
+    {
+        for (int a = 0; a < spatialDim; a++)
+        {
+            for (int b = a + 1; b < spatialDim; b++)
+            {
+                fprintf(diag->file, " L%d%d", a, b);
+            }
+        }
+    }
+    fprintf(diag->file, ")\t com drift\t virial ratio\t relative energy error\n");
+
+    return diag;
+}
+
+void diagnostics_write(Diagnostics *diag, const long double time, const long double *masses, const long double *coord,
+                       const long double *vel, const long double kEnergy, const long double potEnergy)
+{
+    int dim = diag->spatialDim, nL = n_angular(dim);
+    long double *P = diag->values, *L = P + dim, *com = L + nL;
+
+    reduce(diag->nMassive, dim, masses, coord, vel, diag->values, diag->blocks);
+
+    long double drift2 = 0.L;
+    for (int a = 0; a < dim; a++)
+    {
+        long double d = com[a] - diag->com0[a] - diag->vcom0[a] * (time - diag->time0);
+        drift2 += d * d;
+    }
+
+    long double energyErr = kEnergy + potEnergy - diag->energy0;
+    if (diag->energyScale != 0.L)
+    {
+        energyErr /= diag->energyScale;
+    }
+
+    fprintf(diag->file, "%.9Lf", time);
+    for (int a = 0; a < dim; a++)
+    {
+        fprintf(diag->file, " %.9Le", P[a]);
+    }
+
+    // in 3 dimensioni L01 = Lz, L02 = -Ly e L12 = Lx
+    if (dim == 3)
+    {
+        fprintf(diag->file, " %.9Le %.9Le %.9Le", L[2], -L[1], L[0]);
+    }
+    else
+    {
+        for (int l = 0; l < nL; l++)
+        {
+            fprintf(diag->file, " %.9Le", L[l]);
+        }
+    }
+
+    fprintf(diag->file, " %.9Le %.9Le %.9Le\n", sqrtl(drift2), potEnergy != 0.L ? 2.L * kEnergy / fabsl(potEnergy) : 0.L, energyErr);
+}
+
+void diagnostics_free(Diagnostics *diag)
+{
+    if (!diag)
+    {
+        return;
+    }
+
+    if (diag->file)
+    {
+        fclose(diag->file);
+    }
+
+    free(diag->com0);
+    free(diag->vcom0);
+    free(diag->values);
+    free(diag->blocks);
+    free(diag);
+}
@@ -0,0 +1,74 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdio.h>
+
+/**
+ * Struct per il calcolo in-situ delle grandezze conservate, scritte nel file di diagnostica ogni "cadence" passi di integrazione
+ * (indipendentemente da tdump):
+ * - quantità di moto totale (spatialDim componenti);
+ * - momento angolare totale (in 3 dimensioni le componenti Lx, Ly, Lz; in generale le spatialDim * (spatialDim - 1) / 2 componenti
+ * L_ab = sum m (x_a v_b - x_b v_a) con a < b);
+ * - deriva del centro di massa: distanza tra il centro di massa e la sua posizione prevista dal moto rettilineo uniforme iniziale;
+ * - rapporto del viriale 2K / |U|;
+ * - errore relativo sull'energia totale (E - E0) / |E0| (assoluto se E0 = 0); le fusioni spostano l'energia di riferimento energy0,
+ * ma l'errore resta relativo a energyScale = |E0| iniziale.
+ *
+ * Sono considerati solo i primi nMassive corpi, gli unici per cui queste grandezze si conservano nel problema ristretto.
+ * Le somme sui corpi hanno una forma fissa (vedere repro.h), quindi il file non dipende dal numero di thread.
+ */
+typedef struct
+{
+    FILE *file;
+    int nMassive;
+    int spatialDim;
+    int cadence;
+    long double energy0;
+    long double energyScale;
+    long double time0;
+    long double *com0;
+    long double *vcom0;
+    long double *values;
+    long double *blocks;
+} Diagnostics;
+
+/**
+ * Funzione che crea il file di diagnostica, ne scrive l'intestazione e salva i valori di riferimento dallo stato iniziale.
+ *
+ * @param path Percorso del file di diagnostica.
+ * @param cadence Numero di passi di integrazione tra due righe del file.
+ * @param nMassive Numero di corpi considerati (i primi nMassive).
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param masses Puntatore al vettore delle masse.
+ * @param coord Puntatore al vettore delle posizioni iniziali.
+ * @param vel Puntatore al vettore delle velocità iniziali.
+ * @param time0 Tempo fisico dello stato iniziale, da cui si misura la deriva del centro di massa.
+ * @param energy0 Energia totale iniziale.
+ *
+ * @return Puntatore alla struct allocata, NULL in caso di errore. Va liberata con diagnostics_free().
+ */
+Diagnostics *diagnostics_create(const char *path, const int cadence, const int nMassive, const int spatialDim, const long double *masses,
+                                const long double *coord, const long double *vel, const long double time0, const long double energy0);
+
+/**
+ * Funzione che calcola le grandezze conservate nello stato attuale e le scrive come riga del file di diagnostica.
+ *
+ * @param diag Puntatore alla struct creata con diagnostics_create.
+ * @param time Tempo fisico.
+ * @param masses Puntatore al vettore delle masse.
+ * @param coord Puntatore al vettore delle posizioni.
+ * @param vel Puntatore al vettore delle velocità.
+ * @param kEnergy Energia cinetica (calcolata dal chiamante, consistente con il motore di forza).
+ * @param potEnergy Energia potenziale (calcolata dal chiamante, consistente con il motore di forza).
+ */
+void diagnostics_write(Diagnostics *diag, const long double time, const long double *masses, const long double *coord,
+                       const long double *vel, const long double kEnergy, const long double potEnergy);
+
+/**
+ * Funzione che chiude il file di diagnostica e libera la struct.
+ *
+ * @param diag Puntatore alla struct (può essere NULL).
+ */
+void diagnostics_free(Diagnostics *diag);
+
+#endif
@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "events.h"
+#include "integrator.h"
+
+// iterazioni massime e tolleranza (sulla frazione del passo) della ricerca dello zero
+#define EVENT_MAX_ITER 60
+#define EVENT_TOL 1e-12L
+
+// nome degli eventi nel file, nell'ordine di EVENT_CLOSE, EVENT_ESCAPE ed EVENT_ENERGY
+static const char *EVENT_NAMES[] = {"close", "escape", "energy"};
+
+// funzione evento g valutata alla frazione s del passo, per la coppia (a, b) o per il corpo a
+typedef long double (*EventFunction)(EventDetector *events, const int a, const int b, const long double s, const long double *coord,
+                                     const long double *vel, const long double *masses, const long double G, const long double h);
+
+static long double pair_distance(const int spatialDim, const long double *xa, const long double *xb)
+{
+    long double d2 = 0.L;
+
+    for (int k = 0; k < spatialDim; k++)
+    {
+        d2 += (xa[k] - xb[k]) * (xa[k] - xb[k]);
+    }
+
+    return sqrtl(d2);
+}
+
+/**
+ * Funzione evento per l'avvicinamento della coppia (a, b): distanza meno closeRadius (negativa dentro il raggio).
+ */
+static long double close_g(EventDetector *events, const int a, const int b, const long double s, const long double *coord,
+                           const long double *vel, const long double *masses, const long double G, const long double h)
+{
+    (void)masses;
+    (void)G;
+    int dim = events->spatialDim;
+    long double *xa = events->scratch, *xb = events->scratch + dim;
+
+    hermite_interpolate(dim, s, h, events->prevCoord + a * dim, events->prevVel + a * dim, coord + a * dim, vel + a * dim, xa, NULL);
+    hermite_interpolate(dim, s, h, events->prevCoord + b * dim, events->prevVel + b * dim, coord + b * dim, vel + b * dim, xb, NULL);
+
+    return pair_distance(dim, xa, xb) - events->closeRadius;
+}
+
+/**
+ * Funzione evento per la fuga del corpo a dallo stato (x, v) di tutti i corpi: il minimo tra distanza dal centro di massa meno
+ * escapeRadius ed energia specifica del corpo rispetto al resto del sistema (velocità relativa al centro di massa e potenziale dei
+ * corpi massivi). È positiva solo se il corpo è lontano e slegato.
+ */
+static long double escape_g_state(const EventDetector *events, const int a, const long double *x, const long double *v,
+                                  const long double *masses, const long double G)
+{
+    int dim = events->spatialDim;
+    long double *xcm = events->scratch, *vcm = events->scratch + dim, mTot = 0.L;
+
+    for (int k = 0; k < dim; k++)
+    {
+        xcm[k] = 0.L;
+        vcm[k] = 0.L;
+    }
+
+    for (int j = 0; j < events->nMassive; j++)
+    {
+        mTot += masses[j];
+
+        for (int k = 0; k < dim; k++)
+        {
+            xcm[k] += masses[j] * x[k + j * dim];
+            vcm[k] += masses[j] * v[k + j * dim];
+        }
+    }
+
+    long double r2 = 0.L, v2 = 0.L, phi = 0.L;
+
+    for (int k = 0; k < dim; k++)
+    {
+        xcm[k] /= mTot;
+        vcm[k] /= mTot;
+        r2 += (x[k + a * dim] - xcm[k]) * (x[k + a * dim] - xcm[k]);
+        v2 += (v[k + a * dim] - vcm[k]) * (v[k + a * dim] - vcm[k]);
+    }
+
+    for (int j = 0; j < events->nMassive; j++)
+    {
+        if (j != a)
+        {
+            phi -= G * masses[j] / pair_distance(dim, x + a * dim, x + j * dim);
+        }
+    }
+
+    long double gDist = sqrtl(r2) - events->escapeRadius, gEnergy = 0.5L * v2 + phi;
+
+    return gDist < gEnergy ? gDist : gEnergy;
+}
+
+static long double escape_g(EventDetector *events, const int a, const int b, const long double s, const long double *coord,
+                            const long double *vel, const long double *masses, const long double G, const long double h)
+{
+    (void)b;
+    int dim = events->spatialDim;
+    long double *x = events->work, *v = events->work + events->nBodies * dim;
+
+    for (int j = 0; j < events->nBodies; j++)
+    {
+        hermite_interpolate(dim, s, h, events->prevCoord + j * dim, events->prevVel + j * dim, coord + j * dim, vel + j * dim,
+                            x + j * dim, v + j * dim);
+    }
+
+    return escape_g_state(events, a, x, v, masses, G);
+}
+
+/**
+ * Funzione che trova lo zero di g nel passo con il metodo regula falsi nella variante di Illinois (che dimezza il valore dell'estremo
+ * rimasto fermo per due iterazioni, evitando la convergenza lenta del metodo classico). g0 e g1 devono avere segno opposto.
+ *
+ * @return Frazione del passo in cui g si annulla.
+ */
+static long double locate_root(EventFunction g, EventDetector *events, const int a, const int b, long double g0, long double g1,
+                               const long double *coord, const long double *vel, const long double *masses, const long double G,
+                               const long double h)
+{
+    long double s0 = 0.L, s1 = 1.L, s = 1.L;
+    int side = 0;
+
+    for (int it = 0; it < EVENT_MAX_ITER && s1 - s0 > EVENT_TOL; it++)
+    {
+        s = (s0 * g1 - s1 * g0) / (g1 - g0);
+        long double gs = g(events, a, b, s, coord, vel, masses, G, h);
+
+        if (gs == 0.L)
+        {
+            break;
+        }
+
+        if ((gs > 0.L) == (g1 > 0.L))
+        {
+            s1 = s;
+            g1 = gs;
+            if (side == -1)
+                g0 /= 2.L;
+            side = -1;
+        }
+        else
+        {
+            s0 = s;
+            g0 = gs;
+            if (side == 1)
+                g1 /= 2.L;
+            side = 1;
+        }
+    }
+
+    return s;
+}
+
+/**
+ * Funzione che calcola alla frazione s del passo la velocità relativa del corpo a rispetto al corpo b, o rispetto al centro di massa
+ * dei corpi massivi se b è negativo.
+ */
+static long double relative_speed(EventDetector *events, const int a, const int b, const long double s, const long double *coord,
+                                  const long double *vel, const long double *masses, const long double h)
+{
+    int dim = events->spatialDim;
+    long double *x = events->work, *v = events->work + events->nBodies * dim;
+    long double *vRef = events->scratch, mTot = 0.L, v2 = 0.L;
+
+    for (int k = 0; k < dim; k++)
+    {
+        vRef[k] = 0.L;
+    }
+
+    for (int j = 0; j < events->nBodies; j++)
+    {
+        if (j != a && j != b && (b >= 0 || j >= events->nMassive))
+        {
+            continue;
+        }
+
+        hermite_interpolate(dim, s, h, events->prevCoord + j * dim, events->prevVel + j * dim, coord + j * dim, vel + j * dim,
+                            x + j * dim, v + j * dim);
+
+        if (b < 0 && j < events->nMassive)
+        {
+            mTot += masses[j];
+            for (int k = 0; k < dim; k++)
+            {
+                vRef[k] += masses[j] * v[k + j * dim];
+            }
+        }
+    }
+
+    for (int k = 0; k < dim; k++)
+    {
+        long double vk = v[k + a * dim] - (b >= 0 ? v[k + b * dim] : vRef[k] / mTot);
+        v2 += vk * vk;
+    }
+
+    return sqrtl(v2);
+}
+
+static void log_event(EventDetector *events, const int type, const long double time, const int a, const int b, const long double value)
+{
+    fprintf(events->log, "%.12Lf %s %d %d %.9Le\n", time, EVENT_NAMES[type], a >= 0 ? a + 1 : -1, b >= 0 ? b + 1 : -1, value);
+    events->nEvents++;
+}
+
+static long double energy_g(const EventDetector *events, const long double energy)
+{
+    long double err = fabsl(energy - events->energy0);
+
+    if (events->energy0 != 0.L)
+    {
+        err /= fabsl(events->energy0);
+    }
+
+    return err - events->energyTol;
+}
+
+static int n_pairs(const int nBodies, const int nMassive)
+{
+    // coppie (i, j) con i < j e i < nMassive
+    return nMassive * (nBodies - 1) - nMassive * (nMassive - 1) / 2;
+}
+
+EventDetector *events_create(const char *path, const long double closeRadius, const long double escapeRadius, const long double energyTol,
+                             const int stop, const int nBodies, const int nMassive, const int spatialDim, const long double time,
+                             const long double *coord, const long double *vel, const long double *masses, const long double G, const long double energy)
+{
+    int nValues = nBodies * spatialDim;
+
+    EventDetector *events = (EventDetector *)calloc(1, sizeof(EventDetector));
+    if (!events)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return NULL;
+    }
+
+    events->closeRadius = closeRadius;
+    events->escapeRadius = escapeRadius;
+    events->energyTol = energyTol;
+    events->stop = stop;
+    events->nBodies = nBodies;
+    events->nMassive = nMassive;
+    events->spatialDim = spatialDim;
+    events->energy0 = energy;
+    events->prevTime = time;
+
+    events->prevCoord = (long double *)malloc(nValues * sizeof(long double));
+    events->prevVel = (long double *)malloc(nValues * sizeof(long double));
+    events->prevPairG = (long double *)malloc((n_pairs(nBodies, nMassive) + 1) * sizeof(long double));
+    events->prevEscapeG = (long double *)malloc(nBodies * sizeof(long double));
+    events->work = (long double *)malloc(2 * nValues * sizeof(long double));
+    events->scratch = (long double *)malloc(2 * spatialDim * sizeof(long double));
+
+    if (!events->prevCoord || !events->prevVel || !events->prevPairG || !events->prevEscapeG || !events->work || !events->scratch)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        events_free(events);
+        return NULL;
+    }
+
+    events->log = fopen(path, "w");
+    if (!events->log)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", path);
+        events_free(events);
+        return NULL;
+    }
+
+    fprintf(events->log, "# time event body1 body2 value\n");
+
+    for (int i = 0; i < nValues; i++)
+    {
+        events->prevCoord[i] = coord[i];
+        events->prevVel[i] = vel[i];
+    }
+
+    // valori iniziali delle funzioni evento: le condizioni già vere all'istante iniziale non generano eventi
+    int p = 0;
+    for (int i = 0; i < nMassive && closeRadius > 0.L; i++)
+    {
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            events->prevPairG[p++] = pair_distance(spatialDim, coord + i * spatialDim, coord + j * spatialDim) - closeRadius;
+        }
+    }
+
+    for (int i = 0; i < nBodies && escapeRadius > 0.L; i++)
+    {
+        events->prevEscapeG[i] = escape_g_state(events, i, coord, vel, masses, G);
+    }
+
+    events->prevEnergyG = energy_g(events, energy);
+
+    return events;
+}
+
+int events_need_energy(const EventDetector *events)
+{
+    return events->energyTol > 0.L;
+}
+
+int events_step(EventDetector *events, const long double time, const long double *coord, const long double *vel, const long double *masses,
+                const long double G, const long double energy)
+{
+    int dim = events->spatialDim, found = 0;
+    long double h = time - events->prevTime;
+
+    // avvicinamenti: la distanza della coppia scende sotto il raggio
+    if (events->closeRadius > 0.L)
+    {
+        int p = 0;
+        for (int i = 0; i < events->nMassive; i++)
+        {
+            for (int j = i + 1; j < events->nBodies; j++, p++)
+            {
+                long double g1 = pair_distance(dim, coord + i * dim, coord + j * dim) - events->closeRadius, g0 = events->prevPairG[p];
+
+                if (g0 > 0.L && g1 <= 0.L)
+                {
+                    long double s = locate_root(&close_g, events, i, j, g0, g1, coord, vel, masses, G, h);
+                    log_event(events, EVENT_CLOSE, events->prevTime + s * h, i, j, relative_speed(events, i, j, s, coord, vel, masses, h));
+                    found = 1;
+                }
+
+                events->prevPairG[p] = g1;
+            }
+        }
+    }
+
+    // fughe: il corpo supera la distanza dal centro di massa con energia positiva
+    if (events->escapeRadius > 0.L)
+    {
+        for (int i = 0; i < events->nBodies; i++)
+        {
+            long double g1 = escape_g_state(events, i, coord, vel, masses, G), g0 = events->prevEscapeG[i];
+
+            if (g0 < 0.L && g1 >= 0.L)
+            {
+                long double s = locate_root(&escape_g, events, i, -1, g0, g1, coord, vel, masses, G, h);
+                log_event(events, EVENT_ESCAPE, events->prevTime + s * h, i, -1, relative_speed(events, i, -1, s, coord, vel, masses, h));
+                found = 1;
+            }
+
+            events->prevEscapeG[i] = g1;
+        }
+    }
+
+    // errore sull'energia: l'energia è nota solo agli estremi del passo, quindi si interpola linearmente
+    if (events->energyTol > 0.L)
+    {
+        long double g1 = energy_g(events, energy), g0 = events->prevEnergyG;
+
+        if (g0 < 0.L && g1 >= 0.L)
+        {
+            long double s = g0 / (g0 - g1);
+            log_event(events, EVENT_ENERGY, events->prevTime + s * h, -1, -1, g1 + events->energyTol);
+            found = 1;
+        }
+
+        events->prevEnergyG = g1;
+    }
+
+    for (int i = 0; i < events->nBodies * dim; i++)
+    {
+        events->prevCoord[i] = coord[i];
+        events->prevVel[i] = vel[i];
+    }
+    events->prevTime = time;
+
+    return found && events->stop;
+}
+
+void events_free(EventDetector *events)
+{
+    if (!events)
+    {
+        return;
+    }
+
+    if (events->log)
+    {
+        fclose(events->log);
+    }
+
+    free(events->prevCoord);
+    free(events->prevVel);
+    free(events->prevPairG);
+    free(events->prevEscapeG);
+    free(events->work);
+    free(events->scratch);
+    free(events);
+}
@@ -0,0 +1,106 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdio.h>
+
+// tipi di evento registrati nel file degli eventi
+#define EVENT_CLOSE 0
+#define EVENT_ESCAPE 1
+#define EVENT_ENERGY 2
+
+/**
+ * Struct che contiene la configurazione e lo stato del rilevamento degli eventi:
+ * - closeRadius : un evento "close" avviene quando la distanza tra due corpi (di cui almeno uno massivo) scende sotto closeRadius
+ * (disattivato se <= 0);
+ * - escapeRadius : un evento "escape" avviene quando un corpo con energia positiva (rispetto al resto del sistema) si allontana dal centro
+ * di massa oltre escapeRadius (disattivato se <= 0);
+ * - energyTol : un evento "energy" avviene quando l'errore relativo sull'energia totale supera energyTol (disattivato se <= 0);
+ * - stop : se diverso da 0 il primo evento interrompe la simulazione;
+ * - nMassive : numero di corpi massivi (i primi nMassive), gli unici che contano per il centro di massa e per l'energia di legame;
+ * - il resto sono lo stato del passo precedente (posizioni, velocità e valori delle funzioni evento), la memoria di lavoro (work per lo
+ * stato interpolato, scratch per 2 * spatialDim valori ausiliari) e il file degli eventi.
+ *
+ * Ogni evento corrisponde al cambio di segno di una funzione g dello stato tra due passi. L'istante in cui g si annulla viene trovato
+ * con il metodo regula falsi (variante di Illinois) sullo stato interpolato con polinomi cubici di Hermite, che usano posizioni e
+ * velocità agli estremi del passo. Per l'errore sull'energia si interpola linearmente g tra i due passi.
+ *
+ * Ogni riga del file degli eventi contiene: tempo dell'evento, tipo ("close", "escape" o "energy"), i due corpi coinvolti (numerati da
+ * 1 come nel file di input, -1 se assenti) e un valore: la velocità relativa della coppia per "close", la velocità rispetto al centro di massa per "escape" e
+ * l'errore relativo sull'energia a fine passo per "energy".
+ */
+typedef struct
+{
+    long double closeRadius;
+    long double escapeRadius;
+    long double energyTol;
+    int stop;
+    int nBodies;
+    int nMassive;
+    int spatialDim;
+    long double energy0;
+    long double prevTime;
+    long double prevEnergyG;
+    long double *prevCoord;
+    long double *prevVel;
+    long double *prevPairG;
+    long double *prevEscapeG;
+    long double *work;
+    long double *scratch;
+    FILE *log;
+    long int nEvents;
+} EventDetector;
+
+/**
+ * Funzione che crea il rilevatore di eventi a partire dallo stato iniziale e apre il file degli eventi.
+ *
+ * @param path Percorso del file in cui registrare gli eventi.
+ * @param closeRadius Raggio per gli eventi "close" (<= 0 per disattivarli).
+ * @param escapeRadius Distanza dal centro di massa per gli eventi "escape" (<= 0 per disattivarli).
+ * @param energyTol Soglia sull'errore relativo dell'energia per gli eventi "energy" (<= 0 per disattivarli).
+ * @param stop Se diverso da 0 il primo evento interrompe la simulazione.
+ * @param nBodies Numero di corpi del sistema.
+ * @param nMassive Numero di corpi massivi (nBodies se non ci sono traccianti).
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param time Tempo fisico iniziale.
+ * @param coord Puntatore al vettore delle posizioni iniziali.
+ * @param vel Puntatore al vettore delle velocità iniziali.
+ * @param masses Puntatore al vettore delle masse.
+ * @param G Costante di gravitazione.
+ * @param energy Energia totale iniziale (usata come riferimento per gli eventi "energy").
+ *
+ * @return Puntatore alla struct allocata, NULL in caso di errore. Va liberata con events_free().
+ */
+EventDetector *events_create(const char *path, const long double closeRadius, const long double escapeRadius, const long double energyTol,
+                             const int stop, const int nBodies, const int nMassive, const int spatialDim, const long double time,
+                             const long double *coord, const long double *vel, const long double *masses, const long double G, const long double energy);
+
+/**
+ * Funzione che indica se il rilevatore ha bisogno dell'energia totale ad ogni passo (solo per gli eventi "energy").
+ */
+int events_need_energy(const EventDetector *events);
+
+/**
+ * Funzione da chiamare dopo ogni passo di integrazione: controlla i cambi di segno delle funzioni evento rispetto al passo precedente,
+ * localizza gli eventi trovati e li registra nel file.
+ *
+ * @param events Puntatore alla struct creata con events_create.
+ * @param time Tempo fisico alla fine del passo.
+ * @param coord Puntatore al vettore delle posizioni alla fine del passo.
+ * @param vel Puntatore al vettore delle velocità alla fine del passo.
+ * @param masses Puntatore al vettore delle masse.
+ * @param G Costante di gravitazione.
+ * @param energy Energia totale alla fine del passo (ignorata se events_need_energy restituisce 0).
+ *
+ * @return 1 se è avvenuto un evento e la simulazione va interrotta, 0 di default.
+ */
+int events_step(EventDetector *events, const long double time, const long double *coord, const long double *vel, const long double *masses,
+                const long double G, const long double energy);
+
+/**
+ * Funzione che chiude il file degli eventi e libera la struct.
+ *
+ * @param events Puntatore alla struct (può essere NULL).
+ */
+void events_free(EventDetector *events);
+
+#endif
@@ -0,0 +1,1026 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fmm.h"
+
+#define FMM_DIM 3
+// numero di termini di un'espansione di ordine FMM_MAX_ORDER
+#define FMM_MAX_TERMS ((FMM_MAX_ORDER + 1) * (FMM_MAX_ORDER + 2) * (FMM_MAX_ORDER + 3) / 6)
+// numero massimo di corpi in una foglia dell'albero
+#define FMM_LEAF 16
+// oltre questa profondità le celle non vengono più divise (corpi quasi coincidenti)
+#define FMM_MAX_DEPTH 48
+
+/**
+ * Cella dell'octree. I corpi della cella sono quelli tra first e first + count - 1 nell'ordine dell'albero, i figli sono nChild celle
+ * consecutive a partire da child (-1 per le foglie). Le espansioni sono centrate nel centro di massa z; rmax è il raggio di una sfera
+ * centrata in z che contiene tutti i corpi della cella.
+ */
+typedef struct
+{
+    double center[FMM_DIM];
+    double half;
+    double z[FMM_DIM];
+    double rmax;
+    double mass;
+    int first;
+    int count;
+    int child;
+    int nChild;
+    int parent;
+} FmmCell;
+
+/**
+ * Termine di una traslazione tra espansioni: out += coef * potenza (o derivata) di indice shift * in.
+ */
+typedef struct
+{
+    int out;
+    int in;
+    int shift;
+    double coef;
+} FmmTerm;
+
+/**
+ * Lista di interazioni (cella bersaglio, cella sorgente), riordinata per bersaglio in formato compresso: le sorgenti del bersaglio c
+ * sono sorted[start[c]], ..., sorted[start[c + 1] - 1], nell'ordine in cui le ha trovate l'attraversamento.
+ */
+typedef struct
+{
+    int *target;
+    int *source;
+    long int n;
+    long int cap;
+    long int *start;
+    int *sorted;
+    int capStart;
+    long int capSorted;
+} FmmList;
+
+// Multi-indici k = (kx, ky, kz) con |k| <= order, ordinati per grado: termIndex li converte in posizione nei vettori delle espansioni.
+static int fmmOrder = 0;
+static int nTerms = 0;
+static double fmmTheta = 0.;
+static int nB = 0;
+static int *multi = NULL;     // componenti dei multi-indici, 3 per termine
+static int *degree = NULL;    // |k|
+static int *termIndex = NULL; // posizione del multi-indice (a, b, c), -1 se |k| > order
+static int *lower = NULL;     // posizione di k - e_j (-1 se k_j = 0), 3 per termine
+static int *lower2 = NULL;    // posizione di k - 2 e_j (-1 se k_j < 2), 3 per termine
+static int *powDir = NULL;    // direzione usata per calcolare d^k = d^(k - e_j) * d_j
+
+static FmmTerm *m2l = NULL, *m2m = NULL, *l2l = NULL;
+static int nM2L = 0, nM2M = 0, nL2L = 0;
+
+// albero, ricostruito ad ogni chiamata; i livelli sono consecutivi perché l'albero viene costruito in ampiezza
+static FmmCell *cells = NULL;
+static int nCells = 0, capCells = 0;
+static double *mult = NULL; // espansioni multipolari, nTerms per cella
+static double *loc = NULL;  // espansioni locali, nTerms per cella
+static int levelStart[FMM_MAX_DEPTH + 2];
+static int nLevels = 0;
+
+// corpi nell'ordine dell'albero
+static int *perm = NULL;
+static int *permTmp = NULL;
+static long double *pos = NULL;
+static long double *mass = NULL;
+static long double *grad = NULL; // gradiente di sum m_j / |x - x_j|
+static long double *phi = NULL;  // sum m_j / |x - x_j|
+
+static FmmList m2lList = {NULL, NULL, 0, 0, NULL, NULL, 0, 0};
+static FmmList p2pList = {NULL, NULL, 0, 0, NULL, NULL, 0, 0};
+
+static double binomial(const int n, const int k)
+{
+    double b = 1.;
+
+    for (int i = 1; i <= k; i++)
+    {
+        b = b * (n - k + i) / i;
+    }
+
+    return b;
+}
+
+static int term_index(const int a, const int b, const int c)
+{
+    if (a < 0 || b < 0 || c < 0 || a + b + c > fmmOrder)
+    {
+        return -1;
+    }
+
+    return termIndex[(a * (fmmOrder + 1) + b) * (fmmOrder + 1) + c];
+}
+
+/**
+ * Funzione che aggiunge a table i termini (out, in, shift, coef) di una traslazione. Per ogni coppia di multi-indici (i, j):
+ * - mode 0 (M2L): out = i, in = j, shift = i + j se |i| + |j| <= order, coef = (-1)^|j| prod binom(i + j, i);
+ * - mode 1 (M2M): out = i, in = j, shift = i - j se j <= i, coef = prod binom(i, j);
+ * - mode 2 (L2L): out = i, in = j, shift = j - i se i <= j, coef = prod binom(j, i).
+ *
+ * @return Numero di termini (table può essere NULL per contarli soltanto).
+ */
+static int translation_table(const int mode, FmmTerm *table)
+{
+    int n = 0;
+
+    for (int i = 0; i < nTerms; i++)
+    {
+        for (int j = 0; j < nTerms; j++)
+        {
+            const int *a = multi + 3 * i, *b = multi + 3 * j;
+            int shift;
+            double coef = 1.;
+
+            if (mode == 0)
+            {
+                shift = term_index(a[0] + b[0], a[1] + b[1], a[2] + b[2]);
+                for (int k = 0; k < FMM_DIM; k++)
+                {
+                    coef *= binomial(a[k] + b[k], a[k]);
+                }
+                coef *= degree[j] % 2 ? -1. : 1.;
+            }
+            else if (mode == 1)
+            {
+                shift = term_index(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+                for (int k = 0; k < FMM_DIM && shift >= 0; k++)
+                {
+                    coef *= binomial(a[k], b[k]);
+                }
+            }
+            else
+            {
+                shift = term_index(b[0] - a[0], b[1] - a[1], b[2] - a[2]);
+                for (int k = 0; k < FMM_DIM && shift >= 0; k++)
+                {
+                    coef *= binomial(b[k], a[k]);
+                }
+            }
+
+            if (shift < 0)
+            {
+                continue;
+            }
+
+            if (table)
+            {
+                table[n].out = i;
+                table[n].in = j;
+                table[n].shift = shift;
+                table[n].coef = coef;
+            }
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * Funzione che calcola le potenze d^k = dx^kx dy^ky dz^kz per tutti i multi-indici.
+ */
+static void powers(const double *d, double *pw)
+{
+    pw[0] = 1.;
+
+    for (int t = 1; t < nTerms; t++)
+    {
+        pw[t] = pw[lower[3 * t + powDir[t]]] * d[powDir[t]];
+    }
+}
+
+/**
+ * Funzione che calcola i coefficienti di Taylor a_k = D^k (1 / |R|) / k! per |k| <= order con la ricorrenza
+ * |k| R^2 a_k = -(2 |k| - 1) sum_j R_j a_(k - e_j) - (|k| - 1) sum_j a_(k - 2 e_j).
+ */
+static void derivatives(const double *R, double *a)
+{
+    double r2 = R[0] * R[0] + R[1] * R[1] + R[2] * R[2];
+
+    a[0] = 1. / sqrt(r2);
+
+    for (int t = 1; t < nTerms; t++)
+    {
+        double s1 = 0., s2 = 0.;
+        int m = degree[t];
+
+        for (int j = 0; j < FMM_DIM; j++)
+        {
+            if (lower[3 * t + j] >= 0)
+            {
+                s1 += R[j] * a[lower[3 * t + j]];
+            }
+            if (lower2[3 * t + j] >= 0)
+            {
+                s2 += a[lower2[3 * t + j]];
+            }
+        }
+
+        a[t] = -((2 * m - 1) * s1 + (m - 1) * s2) / (m * r2);
+    }
+}
+
+static int list_add(FmmList *list, const int target, const int source)
+{
+    if (list->n == list->cap)
+    {
+        long int cap = list->cap ? 2 * list->cap : 4096;
+        int *t = (int *)realloc(list->target, cap * sizeof(int));
+        if (t)
+        {
+            list->target = t;
+        }
+        int *s = (int *)realloc(list->source, cap * sizeof(int));
+        if (s)
+        {
+            list->source = s;
+        }
+
+        if (!t || !s)
+        {
+            return -1;
+        }
+        list->cap = cap;
+    }
+
+    list->target[list->n] = target;
+    list->source[list->n] = source;
+    list->n++;
+
+    return 0;
+}
+
+/**
+ * Funzione che riordina la lista per cella bersaglio (ordinamento per conteggio, che mantiene l'ordine dell'attraversamento).
+ */
+static int list_sort(FmmList *list)
+{
+    if (list->capStart < nCells + 1)
+    {
+        long int *start = (long int *)realloc(list->start, (nCells + 1) * sizeof(long int));
+        if (!start)
+        {
+            return -1;
+        }
+        list->start = start;
+        list->capStart = nCells + 1;
+    }
+
+    if (list->capSorted < list->n)
+    {
+        int *sorted = (int *)realloc(list->sorted, list->n * sizeof(int));
+        if (!sorted)
+        {
+            return -1;
+        }
+        list->sorted = sorted;
+        list->capSorted = list->n;
+    }
+
+    for (int c = 0; c <= nCells; c++)
+    {
+        list->start[c] = 0;
+    }
+    for (long int i = 0; i < list->n; i++)
+    {
+        list->start[list->target[i] + 1]++;
+    }
+    for (int c = 0; c < nCells; c++)
+    {
+        list->start[c + 1] += list->start[c];
+    }
+
+    // start[c] avanza fino all'inizio del bersaglio successivo e viene poi riportato indietro di un bersaglio
+    for (long int i = 0; i < list->n; i++)
+    {
+        list->sorted[list->start[list->target[i]]++] = list->source[i];
+    }
+    for (int c = nCells; c > 0; c--)
+    {
+        list->start[c] = list->start[c - 1];
+    }
+    list->start[0] = 0;
+
+    return 0;
+}
+
+static int ensure_cells(const int n)
+{
+    if (n <= capCells)
+    {
+        return 0;
+    }
+
+    int cap = capCells ? 2 * capCells : 1024;
+    while (cap < n)
+    {
+        cap *= 2;
+    }
+
+    FmmCell *newCells = (FmmCell *)realloc(cells, cap * sizeof(FmmCell));
+    if (newCells)
+    {
+        cells = newCells;
+    }
+    double *newMult = (double *)realloc(mult, (long int)cap * nTerms * sizeof(double));
+    if (newMult)
+    {
+        mult = newMult;
+    }
+    double *newLoc = (double *)realloc(loc, (long int)cap * nTerms * sizeof(double));
+    if (newLoc)
+    {
+        loc = newLoc;
+    }
+
+    if (!newCells || !newMult || !newLoc)
+    {
+        return -1;
+    }
+
+    capCells = cap;
+    return 0;
+}
+
+/**
+ * Funzione che divide la cella c negli ottanti non vuoti, riordinando i suoi corpi in perm.
+ */
+static int split_cell(const long double *coord, const int c, const int depth)
+{
+    FmmCell cell = cells[c];
+    int counts[8] = {0}, offsets[8];
+
+    cells[c].child = -1;
+    cells[c].nChild = 0;
+
+    if (cell.count <= FMM_LEAF || depth >= FMM_MAX_DEPTH)
+    {
+        return 0;
+    }
+
+    for (int i = cell.first; i < cell.first + cell.count; i++)
+    {
+        const long double *x = coord + FMM_DIM * perm[i];
+        int oct = (x[0] > cell.center[0]) | (x[1] > cell.center[1]) << 1 | (x[2] > cell.center[2]) << 2;
+        counts[oct]++;
+        permTmp[i] = oct;
+    }
+
+    offsets[0] = cell.first;
+    for (int o = 1; o < 8; o++)
+    {
+        offsets[o] = offsets[o - 1] + counts[o - 1];
+    }
+
+    // permTmp contiene l'ottante di ogni corpo: la distribuzione avviene in un buffer temporaneo a partire dalla fine del vettore
+    int *dest = permTmp + nB;
+    for (int i = cell.first; i < cell.first + cell.count; i++)
+    {
+        dest[offsets[permTmp[i]]++ - cell.first] = perm[i];
+    }
+    memcpy(perm + cell.first, dest, cell.count * sizeof(int));
+
+    if (ensure_cells(nCells + 8) == -1)
+    {
+        return -1;
+    }
+
+    cells[c].child = nCells;
+    for (int o = 0, first = cell.first; o < 8; first += counts[o], o++)
+    {
+        if (counts[o] == 0)
+        {
+            continue;
+        }
+
+        FmmCell *child = cells + nCells++;
+        child->half = cell.half / 2.;
+        for (int k = 0; k < FMM_DIM; k++)
+        {
+            child->center[k] = cell.center[k] + ((o >> k) & 1 ? child->half : -child->half);
+        }
+        child->first = first;
+        child->count = counts[o];
+        child->parent = c;
+        cells[c].nChild++;
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che costruisce l'octree in ampiezza (i livelli risultano consecutivi) e copia i corpi nell'ordine dell'albero.
+ */
+static int build_tree(const long double *coord, const long double *masses, const int n)
+{
+    double lo[FMM_DIM], hi[FMM_DIM], extent = 0.;
+
+    for (int k = 0; k < FMM_DIM; k++)
+    {
+        lo[k] = hi[k] = (double)coord[k];
+    }
+    for (int i = 0; i < n; i++)
+    {
+        perm[i] = i;
+        for (int k = 0; k < FMM_DIM; k++)
+        {
+            double x = (double)coord[k + FMM_DIM * i];
+            lo[k] = x < lo[k] ? x : lo[k];
+            hi[k] = x > hi[k] ? x : hi[k];
+        }
+    }
+
+    if (ensure_cells(1) == -1)
+    {
+        return -1;
+    }
+
+    for (int k = 0; k < FMM_DIM; k++)
+    {
+        cells[0].center[k] = 0.5 * (lo[k] + hi[k]);
+        extent = hi[k] - lo[k] > extent ? hi[k] - lo[k] : extent;
+    }
+    cells[0].half = extent > 0. ? 0.5 * extent * (1. + 1e-12) : 1.;
+    cells[0].first = 0;
+    cells[0].count = n;
+    cells[0].parent = -1;
+    nCells = 1;
+    nLevels = 0;
+
+    for (int begin = 0, end = 1; begin < end; begin = end, end = nCells)
+    {
+        levelStart[nLevels] = begin;
+        for (int c = begin; c < end; c++)
+        {
+            if (split_cell(coord, c, nLevels) == -1)
+            {
+                return -1;
+            }
+        }
+        nLevels++;
+    }
+    levelStart[nLevels] = nCells;
+
+    for (int i = 0; i < n; i++)
+    {
+        mass[i] = masses[perm[i]];
+        for (int k = 0; k < FMM_DIM; k++)
+        {
+            pos[k + FMM_DIM * i] = coord[k + FMM_DIM * perm[i]];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che calcola centro di massa, raggio ed espansione multipolare di ogni cella, dalle foglie alla radice: nelle foglie
+ * M_k = sum m (x - z)^k, nelle altre celle le espansioni dei figli vengono traslate nel centro della cella (M2M).
+ */
+static void upward_pass(void)
+{
+    for (int lvl = nLevels - 1; lvl >= 0; lvl--)
+    {
+#pragma omp parallel for schedule(dynamic, 16)
+        for (int c = levelStart[lvl]; c < levelStart[lvl + 1]; c++)
+        {
+            FmmCell *cell = cells + c;
+            double *M = mult + (long int)c * nTerms, pw[FMM_MAX_TERMS], z[FMM_DIM] = {0., 0., 0.};
+
+            for (int t = 0; t < nTerms; t++)
+            {
+                M[t] = 0.;
+            }
+
+            cell->mass = 0.;
+            if (cell->child < 0)
+            {
+                for (int i = cell->first; i < cell->first + cell->count; i++)
+                {
+                    cell->mass += (double)mass[i];
+                    for (int k = 0; k < FMM_DIM; k++)
+                    {
+                        z[k] += (double)(mass[i] * pos[k + FMM_DIM * i]);
+                    }
+                }
+            }
+            else
+            {
+                for (int ch = cell->child; ch < cell->child + cell->nChild; ch++)
+                {
+                    cell->mass += cells[ch].mass;
+                    for (int k = 0; k < FMM_DIM; k++)
+                    {
+                        z[k] += cells[ch].mass * cells[ch].z[k];
+                    }
+                }
+            }
+
+            // con massa totale nulla si usa il centro geometrico
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                cell->z[k] = cell->mass != 0. ? z[k] / cell->mass : cell->center[k];
+            }
+
+            // il raggio non supera la distanza dal vertice più lontano del cubo
+            double corner = 0.;
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                double dk = fabs(cell->z[k] - cell->center[k]) + cell->half;
+                corner += dk * dk;
+            }
+            cell->rmax = 0.;
+
+            if (cell->child < 0)
+            {
+                for (int i = cell->first; i < cell->first + cell->count; i++)
+                {
+                    double d[FMM_DIM], r2 = 0.;
+                    for (int k = 0; k < FMM_DIM; k++)
+                    {
+                        d[k] = (double)pos[k + FMM_DIM * i] - cell->z[k];
+                        r2 += d[k] * d[k];
+                    }
+                    cell->rmax = r2 > cell->rmax ? r2 : cell->rmax;
+
+                    powers(d, pw);
+                    for (int t = 0; t < nTerms; t++)
+                    {
+                        M[t] += (double)mass[i] * pw[t];
+                    }
+                }
+                cell->rmax = sqrt(cell->rmax);
+            }
+            else
+            {
+                for (int ch = cell->child; ch < cell->child + cell->nChild; ch++)
+                {
+                    const double *Mc = mult + (long int)ch * nTerms;
+                    double s[FMM_DIM], r2 = 0.;
+                    for (int k = 0; k < FMM_DIM; k++)
+                    {
+                        s[k] = cells[ch].z[k] - cell->z[k];
+                        r2 += s[k] * s[k];
+                    }
+                    cell->rmax = sqrt(r2) + cells[ch].rmax > cell->rmax ? sqrt(r2) + cells[ch].rmax : cell->rmax;
+
+                    powers(s, pw);
+                    for (int t = 0; t < nM2M; t++)
+                    {
+                        M[m2m[t].out] += m2m[t].coef * pw[m2m[t].shift] * Mc[m2m[t].in];
+                    }
+                }
+            }
+
+            cell->rmax = sqrt(corner) < cell->rmax ? sqrt(corner) : cell->rmax;
+        }
+    }
+}
+
+/**
+ * Funzione che attraversa l'albero in modo duale e registra le interazioni tra le celle a e b: tramite le espansioni se sono ben
+ * separate, dirette tra foglie vicine, altrimenti dividendo la cella più grande. Ogni interazione viene registrata in entrambe le
+ * direzioni.
+ */
+static int traverse(const int a, const int b)
+{
+    const FmmCell *A = cells + a, *B = cells + b;
+
+    if (a == b)
+    {
+        if (A->child < 0)
+        {
+            return list_add(&p2pList, a, a);
+        }
+
+        for (int i = A->child; i < A->child + A->nChild; i++)
+        {
+            for (int j = i; j < A->child + A->nChild; j++)
+            {
+                if (traverse(i, j) == -1)
+                {
+                    return -1;
+                }
+            }
+        }
+        return 0;
+    }
+
+    double d2 = 0.;
+    for (int k = 0; k < FMM_DIM; k++)
+    {
+        d2 += (A->z[k] - B->z[k]) * (A->z[k] - B->z[k]);
+    }
+
+    if ((A->rmax + B->rmax) * (A->rmax + B->rmax) < fmmTheta * fmmTheta * d2)
+    {
+        return (list_add(&m2lList, a, b) == -1 || list_add(&m2lList, b, a) == -1) ? -1 : 0;
+    }
+
+    if (A->child < 0 && B->child < 0)
+    {
+        return (list_add(&p2pList, a, b) == -1 || list_add(&p2pList, b, a) == -1) ? -1 : 0;
+    }
+
+    if (B->child < 0 || (A->child >= 0 && A->rmax >= B->rmax))
+    {
+        for (int i = A->child; i < A->child + A->nChild; i++)
+        {
+            if (traverse(i, b) == -1)
+            {
+                return -1;
+            }
+        }
+    }
+    else
+    {
+        for (int j = B->child; j < B->child + B->nChild; j++)
+        {
+            if (traverse(a, j) == -1)
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che calcola le espansioni locali: prima i contributi delle celle ben separate (M2L), poi dalla radice alle foglie
+ * l'espansione del genitore viene traslata nel centro di ogni figlio (L2L).
+ */
+static void downward_pass(void)
+{
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int c = 0; c < nCells; c++)
+    {
+        double *L = loc + (long int)c * nTerms, a[FMM_MAX_TERMS];
+
+        for (int t = 0; t < nTerms; t++)
+        {
+            L[t] = 0.;
+        }
+
+        for (long int s = m2lList.start[c]; s < m2lList.start[c + 1]; s++)
+        {
+            int src = m2lList.sorted[s];
+            const double *M = mult + (long int)src * nTerms;
+            double R[FMM_DIM];
+
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                R[k] = cells[c].z[k] - cells[src].z[k];
+            }
+
+            derivatives(R, a);
+            for (int t = 0; t < nM2L; t++)
+            {
+                L[m2l[t].out] += m2l[t].coef * a[m2l[t].shift] * M[m2l[t].in];
+            }
+        }
+    }
+
+    for (int lvl = 1; lvl < nLevels; lvl++)
+    {
+#pragma omp parallel for schedule(static)
+        for (int c = levelStart[lvl]; c < levelStart[lvl + 1]; c++)
+        {
+            int p = cells[c].parent;
+            double *L = loc + (long int)c * nTerms, pw[FMM_MAX_TERMS], e[FMM_DIM];
+
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                e[k] = cells[c].z[k] - cells[p].z[k];
+            }
+
+            powers(e, pw);
+            for (int t = 0; t < nL2L; t++)
+            {
+                L[l2l[t].out] += l2l[t].coef * pw[l2l[t].shift] * loc[(long int)p * nTerms + l2l[t].in];
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che calcola potenziale e gradiente sui corpi di ogni foglia: valutazione dell'espansione locale (L2P) più la somma diretta
+ * sui corpi delle foglie vicine (P2P).
+ */
+static void evaluate_leaves(void)
+{
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int c = 0; c < nCells; c++)
+    {
+        const FmmCell *cell = cells + c;
+        const double *L = loc + (long int)c * nTerms;
+        double pw[FMM_MAX_TERMS];
+
+        if (cell->child >= 0)
+        {
+            continue;
+        }
+
+        for (int i = cell->first; i < cell->first + cell->count; i++)
+        {
+            long double *gi = grad + FMM_DIM * i;
+            double e[FMM_DIM], pot = 0., g[FMM_DIM] = {0., 0., 0.};
+
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                e[k] = (double)pos[k + FMM_DIM * i] - cell->z[k];
+            }
+
+            powers(e, pw);
+            for (int t = 0; t < nTerms; t++)
+            {
+                pot += L[t] * pw[t];
+                for (int k = 0; k < FMM_DIM; k++)
+                {
+                    if (lower[3 * t + k] >= 0)
+                    {
+                        g[k] += multi[3 * t + k] * L[t] * pw[lower[3 * t + k]];
+                    }
+                }
+            }
+
+            phi[i] = pot;
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                gi[k] = g[k];
+            }
+
+            for (long int s = p2pList.start[c]; s < p2pList.start[c + 1]; s++)
+            {
+                const FmmCell *src = cells + p2pList.sorted[s];
+
+                for (int j = src->first; j < src->first + src->count; j++)
+                {
+                    if (j == i)
+                    {
+                        continue;
+                    }
+
+                    long double d[FMM_DIM], d2 = 0.L;
+                    for (int k = 0; k < FMM_DIM; k++)
+                    {
+                        d[k] = pos[k + FMM_DIM * i] - pos[k + FMM_DIM * j];
+                        d2 += d[k] * d[k];
+                    }
+
+                    long double inv = 1.L / sqrtl(d2);
+                    phi[i] += mass[j] * inv;
+                    for (int k = 0; k < FMM_DIM; k++)
+                    {
+                        gi[k] -= mass[j] * inv * inv * inv * d[k];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che calcola potenziale e gradiente di sum m_j / |x - x_j| su tutti i corpi (nell'ordine dell'albero).
+ *
+ * @return -1 in caso di errore di allocazione, 0 di default.
+ */
+static int fmm_compute(const long double *coord, const long double *masses, const int n)
+{
+    if (build_tree(coord, masses, n) == -1)
+    {
+        return -1;
+    }
+
+    upward_pass();
+
+    m2lList.n = 0;
+    p2pList.n = 0;
+    if (traverse(0, 0) == -1 || list_sort(&m2lList) == -1 || list_sort(&p2pList) == -1)
+    {
+        return -1;
+    }
+
+    downward_pass();
+    evaluate_leaves();
+
+    return 0;
+}
+
+int fmm_setup(const int nBodies, const int spatialDim, const int order, const long double theta)
+{
+    if (spatialDim != FMM_DIM)
+    {
+        fprintf(stderr, "\nL'FMM è implementato solo per %d dimensioni.\n\n", FMM_DIM);
+        return -1;
+    }
+
+    if (order < 1 || order > FMM_MAX_ORDER || theta <= 0.L || theta >= 1.L)
+    {
+        fprintf(stderr, "\nL'FMM richiede un ordine tra 1 e %d e theta compreso tra 0 e 1.\n\n", FMM_MAX_ORDER);
+        return -1;
+    }
+
+    fmmOrder = order;
+    fmmTheta = (double)theta;
+    nB = nBodies;
+    nTerms = (fmmOrder + 1) * (fmmOrder + 2) * (fmmOrder + 3) / 6;
+
+    multi = (int *)malloc(3 * nTerms * sizeof(int));
+    degree = (int *)malloc(nTerms * sizeof(int));
+    termIndex = (int *)malloc((fmmOrder + 1) * (fmmOrder + 1) * (fmmOrder + 1) * sizeof(int));
+    lower = (int *)malloc(3 * nTerms * sizeof(int));
+    lower2 = (int *)malloc(3 * nTerms * sizeof(int));
+    powDir = (int *)malloc(nTerms * sizeof(int));
+    perm = (int *)malloc(nBodies * sizeof(int));
+    permTmp = (int *)malloc(2 * nBodies * sizeof(int));
+    pos = (long double *)malloc(FMM_DIM * nBodies * sizeof(long double));
+    mass = (long double *)malloc(nBodies * sizeof(long double));
+    grad = (long double *)malloc(FMM_DIM * nBodies * sizeof(long double));
+    phi = (long double *)malloc(nBodies * sizeof(long double));
+
+    if (!multi || !degree || !termIndex || !lower || !lower2 || !powDir || !perm || !permTmp || !pos || !mass || !grad || !phi)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        fmm_free();
+        return -1;
+    }
+
+    for (int t = 0, deg = 0; deg <= fmmOrder; deg++)
+    {
+        for (int a = deg; a >= 0; a--)
+        {
+            for (int b = deg - a; b >= 0; b--, t++)
+            {
+                multi[3 * t] = a;
+                multi[3 * t + 1] = b;
+                multi[3 * t + 2] = deg - a - b;
+                degree[t] = deg;
+                termIndex[(a * (fmmOrder + 1) + b) * (fmmOrder + 1) + deg - a - b] = t;
+            }
+        }
+    }
+
+    for (int t = 0; t < nTerms; t++)
+    {
+        const int *k = multi + 3 * t;
+        powDir[t] = -1;
+
+        for (int j = 0; j < FMM_DIM; j++)
+        {
+            int e[FMM_DIM] = {0, 0, 0};
+            e[j] = 1;
+
+            lower[3 * t + j] = term_index(k[0] - e[0], k[1] - e[1], k[2] - e[2]);
+            lower2[3 * t + j] = term_index(k[0] - 2 * e[0], k[1] - 2 * e[1], k[2] - 2 * e[2]);
+
+            if (powDir[t] < 0 && k[j] > 0)
+            {
+                powDir[t] = j;
+            }
+        }
+    }
+
+    nM2L = translation_table(0, NULL);
+    nM2M = translation_table(1, NULL);
+    nL2L = translation_table(2, NULL);
+    m2l = (FmmTerm *)malloc(nM2L * sizeof(FmmTerm));
+    m2m = (FmmTerm *)malloc(nM2M * sizeof(FmmTerm));
+    l2l = (FmmTerm *)malloc(nL2L * sizeof(FmmTerm));
+
+    if (!m2l || !m2m || !l2l)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        fmm_free();
+        return -1;
+    }
+
+    translation_table(0, m2l);
+    translation_table(1, m2m);
+    translation_table(2, l2l);
+
+    return 0;
+}
+
+/**
+ * Funzione che calcola potenziale e gradiente con la somma diretta, usata solo se l'FMM non riesce ad allocare l'albero.
+ */
+static void direct_fallback(const long double *coord, const long double *masses, const int n)
+{
+    fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria: le forze FMM vengono calcolate con la somma diretta.\n\n");
+
+    for (int i = 0; i < n; i++)
+    {
+        perm[i] = i;
+        mass[i] = masses[i];
+        phi[i] = 0.L;
+        for (int k = 0; k < FMM_DIM; k++)
+        {
+            grad[k + FMM_DIM * i] = 0.L;
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = i + 1; j < n; j++)
+        {
+            long double d[FMM_DIM], d2 = 0.L;
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                d[k] = coord[k + FMM_DIM * i] - coord[k + FMM_DIM * j];
+                d2 += d[k] * d[k];
+            }
+
+            long double inv = 1.L / sqrtl(d2);
+            phi[i] += masses[j] * inv;
+            phi[j] += masses[i] * inv;
+            for (int k = 0; k < FMM_DIM; k++)
+            {
+                grad[k + FMM_DIM * i] -= masses[j] * inv * inv * inv * d[k];
+                grad[k + FMM_DIM * j] += masses[i] * inv * inv * inv * d[k];
+            }
+        }
+    }
+}
+
+void fmm_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+    if (fmm_compute(coord, masses, nBodies) == -1)
+    {
+        direct_fallback(coord, masses, nBodies);
+    }
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        for (int k = 0; k < FMM_DIM; k++)
+        {
+            force[k + FMM_DIM * perm[i]] = G * mass[i] * grad[k + FMM_DIM * i];
+        }
+    }
+}
+
+long double fmm_epot(const long double *coord, const long double *masses, const long double G, const int nBodies)
+{
+    long double potEnergy = 0.L;
+
+    if (fmm_compute(coord, masses, nBodies) == -1)
+    {
+        direct_fallback(coord, masses, nBodies);
+    }
+
+    // ogni coppia compare due volte nella somma sui corpi
+    for (int i = 0; i < nBodies; i++)
+    {
+        potEnergy += mass[i] * phi[i];
+    }
+
+    return -0.5L * G * potEnergy;
+}
+
+static void list_free(FmmList *list)
+{
+    free(list->target);
+    free(list->source);
+    free(list->start);
+    free(list->sorted);
+
+    list->target = list->source = list->sorted = NULL;
+    list->start = NULL;
+    list->n = list->cap = list->capSorted = 0;
+    list->capStart = 0;
+}
+
+void fmm_free(void)
+{
+    free(multi);
+    free(degree);
+    free(termIndex);
+    free(lower);
+    free(lower2);
+    free(powDir);
+    free(m2l);
+    free(m2m);
+    free(l2l);
+    free(cells);
+    free(mult);
+    free(loc);
+    free(perm);
+    free(permTmp);
+    free(pos);
+    free(mass);
+    free(grad);
+    free(phi);
+    list_free(&m2lList);
+    list_free(&p2pList);
+
+    multi = degree = termIndex = lower = lower2 = powDir = perm = permTmp = NULL;
+    m2l = m2m = l2l = NULL;
+    cells = NULL;
+    mult = loc = NULL;
+    pos = mass = grad = phi = NULL;
+    nCells = capCells = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef FMM_H
+#define FMM_H
+
+// valori di default dell'ordine delle espansioni e del parametro di apertura
+#define FMM_DEFAULT_ORDER 4
+#define FMM_DEFAULT_THETA 0.5L
+// ordine massimo delle espansioni: i vettori di appoggio delle traslazioni hanno dimensione fissa
+#define FMM_MAX_ORDER 12
+
+/**
+ * Funzione che prepara il motore di forza fast multipole method (FMM) in 3 dimensioni.
+ * Ad ogni chiamata di fmm_force i corpi vengono divisi in un octree (al più FMM_LEAF corpi per foglia). Ogni cella ha espansioni
+ * multipolari e locali cartesiane centrate nel suo centro di massa, troncate all'ordine complessivo order. Le interazioni tra celle
+ * vengono trovate con un attraversamento duale dell'albero: due celle A e B interagiscono tramite le espansioni se
+ * rA + rB < theta * |zA - zB|, dove z è il centro e r il raggio della cella, altrimenti si scende nella cella più grande. Tra foglie
+ * vicine si usa la somma diretta. Il costo è O(N) e l'errore diminuisce aumentando order o diminuendo theta.
+ *
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema (l'FMM è implementato solo per 3 dimensioni).
+ * @param order Ordine delle espansioni (tra 1 e FMM_MAX_ORDER).
+ * @param theta Parametro di apertura, compreso tra 0 e 1.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ *
+ * @note Le risorse allocate vanno liberate con fmm_free().
+ */
+int fmm_setup(const int nBodies, const int spatialDim, const int order, const long double theta);
+
+/**
+ * Funzione che calcola le forze gravitazionali con l'FMM. Ogni interazione tra due celle viene valutata in entrambe le direzioni con
+ * gli stessi coefficienti e la stessa troncatura, e ogni coppia di corpi vicini dà forze opposte, quindi come in grav_force la quantità
+ * di moto totale si conserva a meno degli arrotondamenti (terza legge di Newton). L'attraversamento è seriale e produce per ogni cella
+ * la lista delle celle con cui interagisce; espansioni, traslazioni e somme dirette vengono poi calcolate in parallelo con un thread
+ * per cella, così il risultato non dipende dal numero di thread.
+ * Rispetta l'interfaccia del puntatore a funzione richiesto da velverlet_ndim_npart.
+ */
+void fmm_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
+
+/**
+ * Funzione che calcola l'energia potenziale con le stesse espansioni di fmm_force (stessa accuratezza delle forze).
+ */
+long double fmm_epot(const long double *coord, const long double *masses, const long double G, const int nBodies);
+
+/**
+ * Funzione che libera la memoria allocata da fmm_setup e dalle chiamate successive. Non fa nulla se fmm_setup non è stata chiamata.
+ */
+void fmm_free(void);
+
+#endif
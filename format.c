@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+
+#include "format.h"
+
+// parole da 32 bit usate per la parte frazionaria: 6 parole permettono di rappresentare esattamente una mantissa da 64 bit
+// il cui bit più significativo si trova fino a 128 bit dopo la virgola
+#define FRAC_WORDS 6
+
+int format_fixed(char *buf, const long double x, const int width, const int precision)
+{
+    // la mantissa viene letta come intero a 64 bit: con long double più precisi (ad esempio a 113 bit su aarch64) i bit in più
+    // andrebbero persi, quindi si lascia la conversione a printf
+    if (LDBL_MANT_DIG > 64 || !isfinite(x) || precision < 0 || precision > FORMAT_MAX_PRECISION || width >= FORMAT_MAX_LEN)
+    {
+        return -1;
+    }
+
+    int negative = signbit(x) != 0;
+    long double absX = fabsl(x);
+
+    // 18446744073709551616 = 2^64, oltre la parte intera non sta in un uint64_t
+    if (absX >= 18446744073709551616.L)
+    {
+        return -1;
+    }
+
+    // absX = mantissa * 2^(exponent - 64), con la mantissa intera a 64 bit
+    int exponent;
+    uint64_t mantissa = (uint64_t)ldexpl(frexpl(absX, &exponent), 64);
+    int shift = 64 - exponent;
+
+    uint64_t intPart = 0;
+    uint32_t frac[FRAC_WORDS] = {0};
+
+    // Il valore della parte frazionaria è sum frac[i] * 2^(-32 (i + 1)). offset è la posizione dopo la virgola del bit più
+    // significativo di fracBits.
+    uint64_t fracBits;
+    int offset;
+
+    if (mantissa == 0)
+    {
+        fracBits = 0;
+        offset = 0;
+    }
+    else if (shift < 64)
+    {
+        intPart = mantissa >> shift;
+        fracBits = shift == 0 ? 0 : mantissa << (64 - shift);
+        offset = 0;
+    }
+    else
+    {
+        fracBits = mantissa;
+        offset = shift - 64;
+    }
+
+    int q = offset / 32, r = offset % 32;
+    if (q + 2 >= FRAC_WORDS)
+    {
+        return -1;
+    }
+
+    frac[q] = (uint32_t)(fracBits >> (32 + r));
+    frac[q + 1] = (uint32_t)(fracBits >> r);
+    frac[q + 2] = r == 0 ? 0 : (uint32_t)(fracBits << (32 - r));
+
+    // Cifre decimali: moltiplicando la parte frazionaria per 10^k dalla parola più significativa escono le k cifre successive.
+    // Si usano blocchi fino a 9 cifre, dato che una parola da 32 bit per 10^9 sta ancora in un uint64_t.
+    static const uint32_t powersOfTen[10] = {1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u};
+    char digits[FORMAT_MAX_PRECISION];
+    int lastWord = q + 2;
+
+    for (int p = 0; p < precision;)
+    {
+        int k = precision - p < 9 ? precision - p : 9;
+        uint64_t carry = 0;
+
+        for (int i = lastWord; i >= 0; i--)
+        {
+            uint64_t t = (uint64_t)frac[i] * powersOfTen[k] + carry;
+            frac[i] = (uint32_t)t;
+            carry = t >> 32;
+        }
+
+        for (int j = k - 1; j >= 0; j--)
+        {
+            digits[p + j] = (char)(carry % 10);
+            carry /= 10;
+        }
+        p += k;
+    }
+
+    // il resto è maggiore o uguale a 1/2 se il suo bit più significativo vale 1, uguale a 1/2 se è l'unico bit a 1
+    int half = (frac[0] & 0x80000000u) != 0;
+    int exactHalf = half && frac[0] == 0x80000000u;
+    for (int i = 1; i <= lastWord && exactHalf; i++)
+    {
+        exactHalf = frac[i] == 0;
+    }
+
+    int lastDigitOdd = precision > 0 ? digits[precision - 1] & 1 : (int)(intPart & 1);
+    if (half && (!exactHalf || lastDigitOdd))
+    {
+        int p = precision - 1;
+        while (p >= 0 && digits[p] == 9)
+        {
+            digits[p--] = 0;
+        }
+
+        if (p >= 0)
+        {
+            digits[p]++;
+        }
+        else
+        {
+            if (intPart == UINT64_MAX)
+            {
+                return -1;
+            }
+            intPart++;
+        }
+    }
+
+    // la parte intera viene scritta al contrario in un buffer temporaneo
+    char intDigits[20];
+    int nInt = 0;
+    do
+    {
+        intDigits[nInt++] = (char)('0' + intPart % 10);
+        intPart /= 10;
+    } while (intPart > 0);
+
+    int length = negative + nInt + (precision > 0 ? 1 + precision : 0);
+    int n = 0;
+
+    for (int i = length; i < width; i++)
+    {
+        buf[n++] = ' ';
+    }
+    if (negative)
+    {
+        buf[n++] = '-';
+    }
+    while (nInt > 0)
+    {
+        buf[n++] = intDigits[--nInt];
+    }
+    if (precision > 0)
+    {
+        buf[n++] = '.';
+        for (int p = 0; p < precision; p++)
+        {
+            buf[n++] = (char)('0' + digits[p]);
+        }
+    }
+    buf[n] = '\0';
+
+    return n;
+}
@@ -0,0 +1,28 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+// massima precisione gestita da format_fixed
+#define FORMAT_MAX_PRECISION 30
+
+// Numero massimo di caratteri scritti da format_fixed (terminatore compreso): segno, 20 cifre intere, punto e cifre decimali.
+// Vale per una larghezza minima richiesta non superiore a questo valore meno 1.
+#define FORMAT_MAX_LEN (1 + 20 + 1 + FORMAT_MAX_PRECISION + 1)
+
+/**
+ * Funzione che scrive in buf il numero x in notazione decimale a virgola fissa, con lo stesso risultato di
+ * sprintf(buf, "%*.*Lf", width, precision, x) ma senza passare per printf.
+ * La conversione è esatta: le cifre vengono generate moltiplicando per 10 la parte frazionaria della mantissa binaria, rappresentata
+ * come intero a più parole, e l'arrotondamento è al più vicino con i casi di parità verso la cifra pari, come fa printf.
+ *
+ * @param buf Puntatore al buffer di almeno FORMAT_MAX_LEN caratteri in cui scrivere il numero (terminato da '\0').
+ * @param x Numero long double da scrivere.
+ * @param width Larghezza minima del campo: se il numero è più corto viene completato con spazi a sinistra.
+ * @param precision Numero di cifre decimali, al massimo FORMAT_MAX_PRECISION.
+ *
+ * @return Numero di caratteri scritti (senza il terminatore), -1 se x non è gestito (infinito, NaN, modulo non inferiore a 2^64
+ * o, se diverso da 0, inferiore a 2^-128), se la mantissa dei long double ha più di 64 bit o se precision o width sono fuori dai limiti.
+ * In quel caso va utilizzato printf.
+ */
+int format_fixed(char *buf, const long double x, const int width, const int precision);
+
+#endif
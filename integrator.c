@@ -1,5 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+
+// sotto questo numero di corpi il costo di avvio dei thread supera quello degli aggiornamenti di posizioni e velocità
+#define PARALLEL_MIN_BODIES 1024
+
+// stato del passo compensato, allocato da compensated_setup: parti principali (in double) e termini di compensazione di posizioni e
+// velocità, il cui valore è la somma delle due, forze a inizio e fine passo e masse in double
+static double *coordHi = NULL, *coordLo = NULL, *velHi = NULL, *velLo = NULL, *forceOld = NULL, *forceNew = NULL, *massesD = NULL;
+static int compNBodies = 0, compSpatialDim = 0;
+static void (*compForce)(const double *, const double *, const double, const int, double *) = NULL;
 
 int velverlet_ndim_npart(const long double dt, const long double forceConst, const int nBodies, const int spatialDim, const long double *masses,
                          long double *coord, long double *vel, long double *force, long double **f_o, void (*F)(const long double *, const long double *, const long double, const int, long double *))
@@ -19,6 +29,9 @@ int velverlet_ndim_npart(const long double dt, const long double forceConst, con
         F(coord, masses, forceConst, nBodies, *f_o);
     }
 
+    // ogni corpo viene aggiornato indipendentemente dagli altri, quindi con molti corpi (ad esempio nuvole di traccianti)
+    // gli aggiornamenti vengono divisi tra i thread
+#pragma omp parallel for if (nBodies >= PARALLEL_MIN_BODIES) schedule(static)
     for (int j = 0; j < nBodies; j++)
     {
         for (int i = 0; i < spatialDim; i++)
@@ -29,6 +42,7 @@ int velverlet_ndim_npart(const long double dt, const long double forceConst, con
 
     F(coord, masses, forceConst, nBodies, force);
 
+#pragma omp parallel for if (nBodies >= PARALLEL_MIN_BODIES) schedule(static)
     for (int j = 0; j < nBodies; j++)
     {
         for (int i = 0; i < spatialDim; i++)
@@ -44,3 +58,182 @@ int velverlet_ndim_npart(const long double dt, const long double forceConst, con
 
     return 0;
 }
+
+int compensated_setup(const int nBodies, const int spatialDim, const long double *coord, const long double *vel,
+                      void (*F)(const double *, const double *, const double, const int, double *))
+{
+    int n = nBodies * spatialDim;
+
+    coordHi = (double *)malloc((6 * n + nBodies) * sizeof(double));
+    if (!coordHi)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return -1;
+    }
+    coordLo = coordHi + n;
+    velHi = coordHi + 2 * n;
+    velLo = coordHi + 3 * n;
+    forceOld = coordHi + 4 * n;
+    forceNew = coordHi + 5 * n;
+    massesD = coordHi + 6 * n;
+
+    compNBodies = nBodies;
+    compSpatialDim = spatialDim;
+    compForce = F;
+
+    for (int i = 0; i < n; i++)
+    {
+        coordHi[i] = (double)coord[i];
+        coordLo[i] = (double)(coord[i] - coordHi[i]);
+        velHi[i] = (double)vel[i];
+        velLo[i] = (double)(vel[i] - velHi[i]);
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che somma y al valore hi + lo. La somma hi + y viene calcolata esattamente come somma arrotondata più errore (algoritmo
+ * two-sum di Knuth, senza salti condizionati), l'errore viene accumulato in lo e infine hi e lo vengono rinormalizzati, così lo resta
+ * più piccolo di mezza unità dell'ultima cifra di hi e l'arrotondamento non si accumula da un passo all'altro.
+ */
+static inline void compensated_add(double *hi, double *lo, const double y)
+{
+    double s = *hi + y, b = s - *hi;
+    double err = (*hi - (s - b)) + (y - b) + *lo;
+
+    *hi = s + err;
+    *lo = err - (*hi - s);
+}
+
+/**
+ * Funzione che esegue nSteps passi compensati sullo stato interno, con il passo diviso in hHi + hLo. I cicli sui corpi sono divisi tra
+ * i thread della regione parallela da cui viene chiamata (se chiamata fuori da una regione parallela li esegue tutti).
+ */
+static void compensated_run(const long int nSteps, const double hHi, const double hLo, const double g)
+{
+    int nBodies = compNBodies, spatialDim = compSpatialDim;
+
+    for (long int s = 0; s < nSteps; s++)
+    {
+        // gli incrementi sono piccoli rispetto allo stato, quindi basta calcolarli in double: l'arrotondamento che conta è quello della
+        // somma, che viene compensato
+#pragma omp for schedule(static)
+        for (int j = 0; j < nBodies; j++)
+        {
+            double halfInvMass = 0.5 / massesD[j];
+
+            for (int i = j * spatialDim; i < (j + 1) * spatialDim; i++)
+            {
+                double a = halfInvMass * hHi * forceOld[i];
+
+                compensated_add(coordHi + i, coordLo + i, hHi * velHi[i] + (hHi * velLo[i] + hLo * velHi[i] + hHi * a));
+            }
+        }
+
+#pragma omp single
+        compForce(coordHi, massesD, g, nBodies, forceNew);
+
+#pragma omp for schedule(static)
+        for (int j = 0; j < nBodies; j++)
+        {
+            double halfInvMass = 0.5 / massesD[j];
+
+            for (int i = j * spatialDim; i < (j + 1) * spatialDim; i++)
+            {
+                double f = forceOld[i] + forceNew[i];
+
+                compensated_add(velHi + i, velLo + i, halfInvMass * hHi * f + halfInvMass * hLo * f);
+            }
+        }
+
+        // la barriera alla fine del ciclo precedente garantisce che nessun thread stia ancora leggendo le forze scambiate
+#pragma omp single
+        {
+            double *tmp = forceOld;
+            forceOld = forceNew;
+            forceNew = tmp;
+        }
+    }
+}
+
+void compensated_steps(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                       long double *force, const long int nSteps)
+{
+    int nBodies = compNBodies, spatialDim = compSpatialDim, n = nBodies * spatialDim;
+
+    // dt viene diviso in due double (hHi + hLo) come lo stato, così il passo dura dt come il tempo contato da chi chiama
+    double hHi = (double)dt, hLo = (double)(dt - hHi), g = (double)G;
+
+    for (int j = 0; j < nBodies; j++)
+    {
+        massesD[j] = (double)masses[j];
+    }
+
+    // in ingresso force contiene le forze nelle posizioni coord (calcolate in long double al primo blocco, in double ai successivi)
+    for (int i = 0; i < n; i++)
+    {
+        forceOld[i] = (double)force[i];
+    }
+
+    // Con molti corpi i passi vengono eseguiti da tutti i thread, che si dividono gli aggiornamenti; con pochi corpi la regione
+    // parallela non viene aperta, perché le barriere a ogni passo costerebbero più del passo stesso.
+    if (nBodies >= PARALLEL_MIN_BODIES)
+    {
+#pragma omp parallel
+        compensated_run(nSteps, hHi, hLo, g);
+    }
+    else
+    {
+        compensated_run(nSteps, hHi, hLo, g);
+    }
+
+    // lo stato in long double serve solo a chi chiama (output, energie, eventi), quindi viene scritto una volta per blocco
+    for (int i = 0; i < n; i++)
+    {
+        coord[i] = (long double)coordHi[i] + coordLo[i];
+        vel[i] = (long double)velHi[i] + velLo[i];
+        force[i] = forceOld[i];
+    }
+}
+
+void compensated_free(void)
+{
+    free(coordHi);
+    coordHi = coordLo = velHi = velLo = forceOld = forceNew = massesD = NULL;
+}
+
+int yoshida4_ndim_npart(const long double dt, const long double forceConst, const int nBodies, const int spatialDim,
+                        const long double *masses, long double *coord, long double *vel, long double *force, long double **f_o,
+                        void (*F)(const long double *, const long double *, const long double, const int, long double *))
+{
+    long double w1 = 1.L / (2.L - cbrtl(2.L)), w[3] = {w1, 1.L - 2.L * w1, w1};
+
+    for (int s = 0; s < 3; s++)
+    {
+        if (velverlet_ndim_npart(w[s] * dt, forceConst, nBodies, spatialDim, masses, coord, vel, force, f_o, F) == -1)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void hermite_interpolate(const int spatialDim, const long double s, const long double h, const long double *x0, const long double *v0,
+                         const long double *x1, const long double *v1, long double *x, long double *v)
+{
+    long double s2 = s * s, s3 = s2 * s;
+    long double h00 = 2.L * s3 - 3.L * s2 + 1.L, h10 = s3 - 2.L * s2 + s, h01 = -2.L * s3 + 3.L * s2, h11 = s3 - s2;
+    long double d00 = 6.L * s2 - 6.L * s, d10 = 3.L * s2 - 4.L * s + 1.L, d01 = -d00, d11 = 3.L * s2 - 2.L * s;
+
+    for (int k = 0; k < spatialDim; k++)
+    {
+        x[k] = h00 * x0[k] + h10 * h * v0[k] + h01 * x1[k] + h11 * h * v1[k];
+
+        if (v)
+        {
+            v[k] = (d00 * x0[k] + d01 * x1[k]) / h + d10 * v0[k] + d11 * v1[k];
+        }
+    }
+}
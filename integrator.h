@@ -1,6 +1,10 @@
 #ifndef INTEGRATOR_H
 #define INTEGRATOR_H
 
+// integratori selezionabili con l'header opzionale "integrator"
+#define INTEGRATOR_VERLET 0
+#define INTEGRATOR_YOSHIDA4 1
+
 /**
  * Funzione che utilizza l'algoritmo Velocity Verlet a spatialDim dimensioni (numero specificato in argomento alla funzione) per
  * calcolare posizioni e velocità di un sistema nBodies particelle soggette a forza specificata.
@@ -37,4 +41,68 @@
 int velverlet_ndim_npart(const long double dt, const long double forceConst, const int nBodies, const int spatialDim, const long double *masses,
                          long double *coord, long double *vel, long double *force, long double **f_o, void (*F)(const long double *, const long double *, const long double, const int, long double *));
 
+/**
+ * Funzione che esegue un passo dell'integratore simplettico del quarto ordine di Yoshida, composto da tre passi di Velocity Verlet di
+ * durata w1 * dt, w0 * dt e w1 * dt con w1 = 1 / (2 - 2^(1/3)) e w0 = 1 - 2 w1 (negativo). Ogni passo costa tre valutazioni della
+ * forza invece di una, ma l'errore decresce come dt^4: a parità di accuratezza permette passi molto più lunghi.
+ * Parametri e valore restituito sono gli stessi di velverlet_ndim_npart, che viene usata per i tre sotto-passi (f_o compreso).
+ */
+int yoshida4_ndim_npart(const long double dt, const long double forceConst, const int nBodies, const int spatialDim,
+                        const long double *masses, long double *coord, long double *vel, long double *force, long double **f_o,
+                        void (*F)(const long double *, const long double *, const long double, const int, long double *));
+
+/**
+ * Funzione che prepara il passo compensato compensated_steps, copiando posizioni e velocità nel suo stato interno.
+ *
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param coord Puntatore alle posizioni iniziali dei corpi.
+ * @param vel Puntatore alle velocità iniziali dei corpi.
+ * @param F Funzione che calcola le forze in double, con gli stessi parametri delle funzioni della forza in long double.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ *
+ * @note Le risorse allocate vanno liberate con compensated_free().
+ */
+int compensated_setup(const int nBodies, const int spatialDim, const long double *coord, const long double *vel,
+                      void (*F)(const double *, const double *, const double, const int, double *));
+
+/**
+ * Funzione che esegue nSteps passi di Velocity Verlet con somma compensata. Lo stato è tenuto in coppie di double (valore arrotondato
+ * più termine di compensazione, circa 106 bit di mantissa contro i 64 dei long double) che passano da un passo all'altro: la forza
+ * viene calcolata in double sulle parti principali delle posizioni, gli incrementi coord += dt * vel + ... e vel += ... vengono
+ * calcolati in double e sommati senza perdere cifre, quindi l'errore di arrotondamento non cresce con il numero di passi pur
+ * eseguendo tutti i cicli in double. Anche dt viene diviso in due double, così il passo dura esattamente dt.
+ * coord, vel e force vengono scritti in long double solo alla fine dei nSteps passi, per l'output, le energie e gli eventi.
+ * Ha la stessa interfaccia dei passi specializzati di smalln.h (force svolge il ruolo di f_o).
+ *
+ * @note Va chiamata dopo compensated_setup() e solo su un sistema (lo stato è unico). Posizioni e velocità vengono lette solo da
+ * compensated_setup: modificarle tra due chiamate non ha effetto.
+ */
+void compensated_steps(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                       long double *force, const long int nSteps);
+
+/**
+ * Funzione che libera la memoria allocata da compensated_setup. Non fa nulla se compensated_setup non è stata chiamata.
+ */
+void compensated_free(void);
+
+/**
+ * Funzione che interpola con un polinomio cubico di Hermite posizione e velocità di un corpo alla frazione s del passo di durata h,
+ * a partire da posizioni e velocità a inizio passo (x0, v0) e a fine passo (x1, v1). L'errore sulle posizioni è O(h^4), più piccolo di
+ * quello di Velocity Verlet, quindi l'interpolazione non peggiora l'accuratezza dell'integrazione.
+ *
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param s Frazione del passo, tra 0 e 1 (con s = 0 e s = 1 restituisce esattamente lo stato agli estremi).
+ * @param h Durata del passo.
+ * @param x0 Puntatore alla posizione a inizio passo.
+ * @param v0 Puntatore alla velocità a inizio passo.
+ * @param x1 Puntatore alla posizione a fine passo.
+ * @param v1 Puntatore alla velocità a fine passo.
+ * @param x Puntatore in cui salvare la posizione interpolata.
+ * @param v Puntatore in cui salvare la velocità interpolata (NULL se non serve).
+ */
+void hermite_interpolate(const int spatialDim, const long double s, const long double h, const long double *x0, const long double *v0,
+                         const long double *x1, const long double *v1, long double *x, long double *v);
+
 #endif
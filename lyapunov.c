@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "lyapunov.h"
+
+// Stato del calcolo, impostato da lyapunov_setup. Ogni vettore tangente occupa un blocco di 3 * nValues componenti: variazioni delle
+// posizioni, delle velocità e della forza (J dx nelle posizioni attuali, che svolge il ruolo di f_o per i vettori tangenti).
+static FILE *outFile = NULL;
+static int nVec = 0;
+static int cadence = 0;
+static int nB = 0;
+static int dim = 0;
+static int nValues = 0;
+static long int stepCount = 0;
+static long double *tangents = NULL;
+static long double *dForceNew = NULL;
+static long double *fNew = NULL;
+static long double *logSums = NULL;
+
+void lyapunov_force_tangent(const int nBodies, const int spatialDim, const long double *coord, const long double *masses, const long double G,
+                            long double *force, const int nVectors, const long double *dCoord, const int dCoordStride, long double *dForce,
+                            const int dForceStride)
+{
+    int n = nBodies * spatialDim;
+
+    for (int i = 0; i < n; i++)
+    {
+        force[i] = 0.L;
+    }
+
+    for (int v = 0; v < nVectors; v++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            dForce[i + v * dForceStride] = 0.L;
+        }
+    }
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            long double d[LYAPUNOV_MAX_DIM], d2 = 0.L;
+
+            for (int k = 0; k < spatialDim; k++)
+            {
+                d[k] = coord[k + i * spatialDim] - coord[k + j * spatialDim];
+                d2 += d[k] * d[k];
+            }
+
+            long double factor = -G * masses[i] * masses[j] / (d2 * sqrtl(d2));
+
+            for (int k = 0; k < spatialDim; k++)
+            {
+                force[k + i * spatialDim] += factor * d[k];
+                force[k + j * spatialDim] -= factor * d[k];
+            }
+
+            for (int v = 0; v < nVectors; v++)
+            {
+                const long double *dx = dCoord + v * dCoordStride;
+                long double *df = dForce + v * dForceStride;
+                long double dd[LYAPUNOV_MAX_DIM], dot = 0.L;
+
+                for (int k = 0; k < spatialDim; k++)
+                {
+                    dd[k] = dx[k + i * spatialDim] - dx[k + j * spatialDim];
+                    dot += d[k] * dd[k];
+                }
+
+                for (int k = 0; k < spatialDim; k++)
+                {
+                    long double dfComp = factor * (dd[k] - 3.L * d[k] * dot / d2);
+                    df[k + i * spatialDim] += dfComp;
+                    df[k + j * spatialDim] -= dfComp;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che ortonormalizza i vettori tangenti con il metodo di Gram-Schmidt modificato. Norma e prodotti scalari usano le sole
+ * componenti (dx, dv); le stesse combinazioni lineari vengono applicate a dF, che resta così uguale a J dx.
+ *
+ * @param accumulate Se diverso da 0 i logaritmi delle norme vengono sommati in logSums.
+ */
+static void orthonormalize(const int accumulate)
+{
+    int len = 2 * nValues;
+
+    for (int v = 0; v < nVec; v++)
+    {
+        long double *a = tangents + v * 3 * nValues;
+
+        for (int u = 0; u < v; u++)
+        {
+            const long double *b = tangents + u * 3 * nValues;
+            long double proj = 0.L;
+
+            for (int i = 0; i < len; i++)
+            {
+                proj += a[i] * b[i];
+            }
+
+            for (int i = 0; i < 3 * nValues; i++)
+            {
+                a[i] -= proj * b[i];
+            }
+        }
+
+        long double norm = 0.L;
+        for (int i = 0; i < len; i++)
+        {
+            norm += a[i] * a[i];
+        }
+        norm = sqrtl(norm);
+
+        for (int i = 0; i < 3 * nValues; i++)
+        {
+            a[i] /= norm;
+        }
+
+        if (accumulate)
+        {
+            logSums[v] += logl(norm);
+        }
+    }
+}
+
+int lyapunov_setup(const char *path, const int nVectors, const int cadenceSteps, const int nBodies, const int spatialDim, const long double *coord,
+                   const long double *masses, const long double G)
+{
+    if (nVectors <= 0 || nVectors > 2 * nBodies * spatialDim || cadenceSteps <= 0)
+    {
+        fprintf(stderr, "\nIl numero di esponenti di Lyapunov deve essere compreso tra 1 e 2 * N * dimensione.\n\n");
+        return -1;
+    }
+
+    if (spatialDim > LYAPUNOV_MAX_DIM)
+    {
+        fprintf(stderr, "\nGli esponenti di Lyapunov richiedono una dimensione spaziale al più %d.\n\n", LYAPUNOV_MAX_DIM);
+        return -1;
+    }
+
+    nVec = nVectors;
+    cadence = cadenceSteps;
+    nB = nBodies;
+    dim = spatialDim;
+    nValues = nBodies * spatialDim;
+    stepCount = 0;
+
+    tangents = (long double *)malloc(nVec * 3 * nValues * sizeof(long double));
+    dForceNew = (long double *)malloc(nVec * nValues * sizeof(long double));
+    fNew = (long double *)malloc(nValues * sizeof(long double));
+    logSums = (long double *)calloc(nVec, sizeof(long double));
+
+    if (!tangents || !dForceNew || !fNew || !logSums)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        lyapunov_free();
+        return -1;
+    }
+
+    outFile = fopen(path, "w");
+    if (!outFile)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", path);
+        lyapunov_free();
+        return -1;
+    }
+
+    // Vettori iniziali da un generatore congruenziale lineare con seme fisso: rand() non va usato perché viene inizializzato con
+    // l'orario per le citazioni, e i risultati devono essere riproducibili.
+    unsigned long long seed = 88172645463325252ULL;
+    for (int v = 0; v < nVec; v++)
+    {
+        for (int i = 0; i < 2 * nValues; i++)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            tangents[i + v * 3 * nValues] = (long double)(seed >> 11) / (long double)(1ULL << 53) - 0.5L;
+        }
+    }
+
+    // dF parte da 0 per essere combinato linearmente durante l'ortonormalizzazione, poi viene calcolato da zero come J dx
+    for (int v = 0; v < nVec; v++)
+    {
+        for (int i = 2 * nValues; i < 3 * nValues; i++)
+        {
+            tangents[i + v * 3 * nValues] = 0.L;
+        }
+    }
+
+    orthonormalize(0);
+    lyapunov_force_tangent(nB, dim, coord, masses, G, fNew, nVec, tangents, 3 * nValues, dForceNew, nValues);
+    for (int v = 0; v < nVec; v++)
+    {
+        for (int i = 0; i < nValues; i++)
+        {
+            tangents[2 * nValues + i + v * 3 * nValues] = dForceNew[i + v * nValues];
+        }
+    }
+
+    fprintf(outFile, "#format:\t time\t lyapunov exponents: (");
+    for (int v = 0; v < nVec; v++)
+    {
+        fprintf(outFile, " l%d", v + 1);
+    }
+    fprintf(outFile, ")\n");
+
+    return 0;
+}
+
+void lyapunov_steps(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                    long double *force, const long int nSteps)
+{
+    for (long int s = 0; s < nSteps; s++)
+    {
+        for (int j = 0; j < nB; j++)
+        {
+            long double c = 1.L / (2.L * masses[j]) * dt * dt;
+
+            for (int k = 0; k < dim; k++)
+            {
+                coord[k + j * dim] = coord[k + j * dim] + dt * vel[k + j * dim] + c * force[k + j * dim];
+            }
+
+            for (int v = 0; v < nVec; v++)
+            {
+                long double *t = tangents + v * 3 * nValues;
+
+                for (int k = 0; k < dim; k++)
+                {
+                    t[k + j * dim] += dt * t[nValues + k + j * dim] + c * t[2 * nValues + k + j * dim];
+                }
+            }
+        }
+
+        lyapunov_force_tangent(nB, dim, coord, masses, G, fNew, nVec, tangents, 3 * nValues, dForceNew, nValues);
+
+        for (int j = 0; j < nB; j++)
+        {
+            long double c = 1.L / (2.L * masses[j]) * dt;
+
+            for (int k = 0; k < dim; k++)
+            {
+                vel[k + j * dim] = vel[k + j * dim] + c * (force[k + j * dim] + fNew[k + j * dim]);
+                force[k + j * dim] = fNew[k + j * dim];
+            }
+
+            for (int v = 0; v < nVec; v++)
+            {
+                long double *t = tangents + v * 3 * nValues;
+                const long double *dfNew = dForceNew + v * nValues;
+
+                for (int k = 0; k < dim; k++)
+                {
+                    t[nValues + k + j * dim] += c * (t[2 * nValues + k + j * dim] + dfNew[k + j * dim]);
+                    t[2 * nValues + k + j * dim] = dfNew[k + j * dim];
+                }
+            }
+        }
+
+        stepCount++;
+
+        if (stepCount % cadence == 0)
+        {
+            long double time = stepCount * dt;
+
+            orthonormalize(1);
+
+            fprintf(outFile, "%.9Lf", time);
+            for (int v = 0; v < nVec; v++)
+            {
+                fprintf(outFile, " %.12Le", logSums[v] / time);
+            }
+            fprintf(outFile, "\n");
+        }
+    }
+}
+
+void lyapunov_free(void)
+{
+    if (outFile)
+    {
+        fclose(outFile);
+    }
+
+    free(tangents);
+    free(dForceNew);
+    free(fNew);
+    free(logSums);
+
+    outFile = NULL;
+    tangents = NULL;
+    dForceNew = NULL;
+    fNew = NULL;
+    logSums = NULL;
+    nVec = 0;
+}
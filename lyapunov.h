@@ -0,0 +1,67 @@
+#ifndef LYAPUNOV_H
+#define LYAPUNOV_H
+
+// numero di passi di default tra due rinormalizzazioni dei vettori tangenti
+#define LYAPUNOV_DEFAULT_CADENCE 100
+
+// dimensione spaziale massima, usata per i vettori di appoggio di lyapunov_force_tangent
+#define LYAPUNOV_MAX_DIM 3
+
+/**
+ * Funzione che prepara il calcolo degli esponenti di Lyapunov: alloca nVectors vettori tangenti (dx, dv) di 2 * nBodies * spatialDim
+ * componenti, li inizializza ortonormali (con una sequenza pseudo-casuale fissata, quindi riproducibile) e apre il file di output.
+ *
+ * @param path Percorso del file in cui scrivere gli esponenti dopo ogni rinormalizzazione.
+ * @param nVectors Numero di esponenti da calcolare: 1 per il massimo, fino a 2 * nBodies * spatialDim per lo spettro completo.
+ * @param cadenceSteps Numero di passi tra due rinormalizzazioni.
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param coord Puntatore al vettore delle posizioni iniziali (per le variazioni iniziali della forza).
+ * @param masses Puntatore al vettore delle masse.
+ * @param G Costante di gravitazione.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int lyapunov_setup(const char *path, const int nVectors, const int cadenceSteps, const int nBodies, const int spatialDim, const long double *coord,
+                   const long double *masses, const long double G);
+
+/**
+ * Funzione che esegue nSteps passi di Velocity Verlet con la forza gravitazionale diretta propagando insieme allo stato i vettori
+ * tangenti con la mappa tangente del passo (le equazioni variazionali discretizzate con lo stesso schema):
+ * dx' = dx + dt dv + dt^2 / (2m) J(x) dx, dv' = dv + dt / (2m) (J(x) dx + J(x') dx'),
+ * dove J è lo jacobiano della forza, applicato ai vettori tangenti nello stesso ciclo sulle coppie che calcola la forza.
+ * Ogni cadenceSteps passi i vettori vengono ortonormalizzati (Gram-Schmidt modificato), i logaritmi delle norme sono accumulati e gli
+ * esponenti (somma dei logaritmi diviso il tempo) vengono scritti nel file.
+ * Ha la stessa interfaccia dei passi specializzati di smalln.h (force svolge il ruolo di f_o).
+ */
+void lyapunov_steps(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                    long double *force, const long int nSteps);
+
+/**
+ * Funzione che calcola nello stesso ciclo sulle coppie la forza gravitazionale diretta e, per nVectors vettori tangenti, la variazione
+ * della forza J dx. Per la coppia (i, j) con d = x_i - x_j la forza su i è F = -G m_i m_j d / r^3 e la sua variazione è
+ * dF = -G m_i m_j (dd - 3 d (d . dd) / r^2) / r^3 con dd = dx_i - dx_j; su j agiscono -F e -dF. Non usa lo stato del modulo, quindi può
+ * essere chiamata da più thread su sistemi diversi. Richiede spatialDim <= LYAPUNOV_MAX_DIM.
+ *
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param coord Puntatore alle posizioni dei corpi.
+ * @param masses Puntatore alle masse dei corpi.
+ * @param G Costante di gravitazione.
+ * @param force Puntatore al vettore in cui salvare la forza su ciascun corpo.
+ * @param nVectors Numero di vettori tangenti.
+ * @param dCoord Puntatore alle variazioni delle posizioni, nBodies * spatialDim componenti per vettore tangente.
+ * @param dCoordStride Distanza tra l'inizio di due vettori tangenti consecutivi in dCoord.
+ * @param dForce Puntatore al vettore in cui salvare le variazioni della forza.
+ * @param dForceStride Distanza tra l'inizio di due vettori consecutivi in dForce.
+ */
+void lyapunov_force_tangent(const int nBodies, const int spatialDim, const long double *coord, const long double *masses, const long double G,
+                            long double *force, const int nVectors, const long double *dCoord, const int dCoordStride, long double *dForce,
+                            const int dForceStride);
+
+/**
+ * Funzione che chiude il file degli esponenti e libera i vettori tangenti. Non fa nulla se lyapunov_setup non è stata chiamata.
+ */
+void lyapunov_free(void);
+
+#endif
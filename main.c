@@ -1,20 +1,104 @@
-// gcc -std=c99 -Wall -Wpedantic -O3 main.c integrator.c geom.c -o main.exe -lm
+// gcc -std=c99 -Wall -Wpedantic -O3 -fopenmp main.c integrator.c geom.c pm.c smalln.c restricted.c format.c trajstore.c shmstream.c events.c diagnostics.c watchdog.c lyapunov.c parareal.c repro.c collisions.c softening.c fmm.c metrics.c branch.c shooting.c sfc.c autotune.c -o main.exe -lm
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "geom.h"
 #include "integrator.h"
+#include "pm.h"
+#include "smalln.h"
+#include "restricted.h"
+#include "format.h"
+#include "trajstore.h"
+#include "shmstream.h"
+#include "events.h"
+#include "diagnostics.h"
+#include "watchdog.h"
+#include "lyapunov.h"
+#include "parareal.h"
+#include "repro.h"
+#include "collisions.h"
+#include "softening.h"
+#include "fmm.h"
+#include "metrics.h"
+#include "branch.h"
+#include "shooting.h"
+#include "sfc.h"
+#include "autotune.h"
 
 #define MAX_LEN 1024
+// lunghezza massima dei nomi letti dagli header (ad esempio quello del segmento di memoria condivisa)
+#define MAX_NAME_LEN 256
 #define SPATIAL_DIM 3
+
+// M_PI non fa parte dello standard C99
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 #define N_HEADERS 5
 
+// motori di forza selezionabili con l'header opzionale "engine"
+#define ENGINE_DIRECT 0
+#define ENGINE_PM 1
+#define ENGINE_P3M 2
+#define ENGINE_TILED 3
+#define ENGINE_FMM 4
+
+// numero di corpi per blocco nel calcolo a blocchi della forza: due blocchi di coordinate, masse e forze parziali
+// (64 corpi * 3 componenti * 16 byte ciascuno per vettore) stanno insieme nella cache L1
+#define TILE_BODIES 64
+// numero di varianti del calcolo della forza provate dall'autotuning (vedere run_autotune)
+#define AUTOTUNE_VARIANTS 6
+
+// valori di default degli header opzionali del motore particle-mesh
+#define DEFAULT_MESH 64
+// rsplit di default in unità di lato di cella della griglia
+#define DEFAULT_RSPLIT_CELLS 1.25L
+
 // per rendere più facile il mantenimento del programma poniamo i nomi dei file di output come macro
 #define OUTPUT_SYSTEM "traj.dat"
 #define OUTPUT_ENERGIES "energies.dat"
+#define OUTPUT_SYSTEM_CHUNKED "traj.bin"
+#define OUTPUT_EVENTS "events.dat"
+#define OUTPUT_DIAGNOSTICS "diagnostics.dat"
+#define OUTPUT_CHECKPOINT "checkpoint.dat"
+#define OUTPUT_LYAPUNOV "lyapunov.dat"
+#define OUTPUT_COLLISIONS "collisions.dat"
+#define OUTPUT_METRICS "metrics.dat"
+#define OUTPUT_SNAPSHOT "snapshot.dat"
+#define OUTPUT_PERIODIC "periodic.dat"
+
+// formati del file delle traiettorie selezionabili con l'header opzionale "trajformat"
+#define TRAJ_TEXT 0
+#define TRAJ_CHUNKED 1
+#define TRAJ_NONE 2
+
+// passo di quantizzazione di default dei valori nel formato a blocchi
+#define DEFAULT_QUANTUM 1e-12L
+
+// campi del file delle traiettorie selezionabili con l'header opzionale "fields" (maschera di bit, nell'ordine di scrittura)
+#define FIELD_COORDS 1
+#define FIELD_VEL 2
+#define FIELD_ACC 4
+#define FIELD_ALL (FIELD_COORDS | FIELD_VEL | FIELD_ACC)
+
+// numero di dt provati dal banco di prova (in progressione geometrica tra dtmax e dtmin) e di controlli dell'energia per ogni prova
+#define BENCH_POINTS 8
+#define BENCH_CHECKS 1000
+
+// le sfere di Plummer generate con --plummer vengono troncate a questo raggio (in unità della scala del modello)
+#define PLUMMER_MAX_RADIUS 10.L
+
+// Dimensione dei buffer dei file di output: le righe si accumulano in memoria e vengono scritte su disco in blocchi di questa dimensione.
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+// dimensione del blocco locale in cui print_system e print_energies formattano i valori prima di passarli al file
+#define OUTPUT_CHUNK 4096
 
 // Rimuovere la riga qui sotto per evitare le citazioni all'inizio dei file di output
 #define FUNNY
@@ -35,7 +119,62 @@
  * - masses : puntatore a cui assegnare le masse dei corpi del sistema;
  * - coord : puntatore a cui assegnare le coordinate in SPATIAL_DIM dimensioni dei corpi del sistema in un dato istante;
  * - vel : puntatore a cui assegnare le velocità in SPATIAL_DIM dimensioni dei corpi del sistema in un dato istante;
- * - acc : puntatore a cui assegnare le accelerazioni in SPATIAL_DIM dimensioni dei corpi del sistema in un dato istante.
+ * - acc : puntatore a cui assegnare le accelerazioni in SPATIAL_DIM dimensioni dei corpi del sistema in un dato istante;
+ * - engine : motore utilizzato per il calcolo della forza (ENGINE_DIRECT, ENGINE_TILED, ENGINE_PM, ENGINE_P3M o ENGINE_FMM);
+ * - box : lato della scatola periodica (solo per i motori particle-mesh);
+ * - mesh : numero di celle per lato della griglia (solo per i motori particle-mesh);
+ * - rsplit : scala di separazione tra forza a lungo e a corto raggio (solo per ENGINE_P3M);
+ * - unroll : se diverso da 0 con ENGINE_DIRECT e pochi corpi si usa il passo specializzato di smalln.c;
+ * - nMassive : numero di corpi massivi (i primi nMassive), gli altri sono traccianti senza massa gravitazionale (problema ristretto);
+ * - trajFormat : formato del file delle traiettorie (TRAJ_TEXT per traj.dat, TRAJ_CHUNKED per traj.bin, vedere trajstore.h, o TRAJ_NONE
+ * per non salvare le traiettorie);
+ * - chunkFrames : numero di frame per blocco nel formato TRAJ_CHUNKED;
+ * - quantum : passo di quantizzazione dei valori nel formato TRAJ_CHUNKED;
+ * - shmName : nome del segmento di memoria condivisa in cui pubblicare i frame (stringa vuota se non richiesto);
+ * - shmSlots : numero di frame mantenuti nel buffer circolare in memoria condivisa;
+ * - closeRadius, escapeRadius, energyTol : soglie degli eventi registrati in events.dat (disattivati se <= 0, vedere events.h);
+ * - stopOnEvent : se diverso da 0 la simulazione si interrompe al primo evento;
+ * - diagCadence : numero di passi di integrazione tra due righe di diagnostics.dat (0 se non richiesto, vedere diagnostics.h);
+ * - watchdogTol : errore relativo sull'energia oltre il quale la simulazione viene interrotta salvando un checkpoint (disattivato se <= 0);
+ * - lyapVectors : numero di esponenti di Lyapunov da calcolare con le equazioni variazionali (0 se non richiesto, vedere lyapunov.h);
+ * - lyapCadence : numero di passi tra due rinormalizzazioni dei vettori tangenti;
+ * - pararealSlices : numero di intervalli dell'integrazione parareal (0 se non richiesta, vedere parareal.h);
+ * - pararealRatio : rapporto tra il passo del propagatore grossolano e dt;
+ * - pararealTol : tolleranza sulla convergenza delle iterazioni parareal;
+ * - reproducible : se diverso da 0 forze ed energie dei motori direct e tiled sono calcolate in parallelo con somme di forma fissa,
+ * identiche bit per bit con qualsiasi numero di thread (vedere repro.h);
+ * - collisions : risposta alle collisioni tra corpi di raggio finito (COLLISIONS_NONE, COLLISIONS_MERGE o COLLISIONS_BOUNCE, vedere
+ * collisions.h);
+ * - density : densità da cui ricavare il raggio dei corpi senza la colonna del raggio nel file di input (disattivata se <= 0);
+ * - radii : puntatore al vettore dei raggi dei corpi (0 se non specificati);
+ * - softening : nucleo di softening della forza e dell'energia potenziale (SOFTENING_NONE, SOFTENING_PLUMMER o SOFTENING_SPLINE, vedere
+ * softening.h);
+ * - softLength : lunghezza di softening;
+ * - fmmOrder, fmmTheta : ordine delle espansioni e parametro di apertura del motore ENGINE_FMM (vedere fmm.h);
+ * - dumpDt : intervallo di tempo fisico tra due stampe dell'output denso (disattivato se <= 0);
+ * - dumpTimes : puntatore ai tempi fisici crescenti a cui stampare con l'output denso, letti dal file dell'header dumptimes (NULL se
+ * non richiesti);
+ * - nDumpTimes : numero di tempi in dumpTimes;
+ * - integrator : integratore usato per i passi (INTEGRATOR_VERLET o INTEGRATOR_YOSHIDA4, vedere integrator.h);
+ * - metricsInterval : intervallo in secondi tra due riscritture del file delle metriche (disattivato se <= 0, vedere metrics.h);
+ * - outBodies : puntatore agli indici (da 0, crescenti) dei corpi scritti nel file delle traiettorie (NULL per scriverli tutti);
+ * - nOutBodies : numero di indici in outBodies;
+ * - outFields : campi scritti nel file delle traiettorie (combinazione di FIELD_COORDS, FIELD_VEL e FIELD_ACC);
+ * - trajEvery, energiesEvery : le traiettorie e le energie vengono scritte una stampa ogni trajEvery ed energiesEvery;
+ * - compensated : se diverso da 0 i passi vengono eseguiti in double con la somma compensata (vedere compensated_steps);
+ * - branches : numero di rami dell'insieme generato al passo branchStep (0 se la simulazione non si ramifica);
+ * - branchStep : passo, multiplo di tdump, a cui la simulazione si ferma e si divide nei rami;
+ * - branchCoord, branchVel : ampiezze delle perturbazioni uniformi di ogni componente di posizioni e velocità dei rami;
+ * - branchSeed : seme del generatore delle perturbazioni (il ramo k usa branchSeed + k);
+ * - branchJobs : numero massimo di rami eseguiti contemporaneamente (0 per il numero di processori);
+ * - tStart : tempo fisico dello stato iniziale, da cui parte il tempo scritto nei file di output (diverso da 0 per le simulazioni riprese
+ * da un checkpoint, come i rami);
+ * - reorderEvery : numero di passi tra due riordinamenti dei corpi lungo la curva di Morton (0 se non richiesti, vedere sfc.h);
+ * - bodySlot : puntatore alla posizione attuale nei vettori di ogni corpo, indicizzato con l'indice del file di input (NULL senza
+ * riordinamenti, vedere body_slot);
+ * - bodyOrder : puntatore all'indice del file di input del corpo in ogni posizione dei vettori (NULL senza riordinamenti);
+ * - autotune : se diverso da 0 la variante del calcolo della forza e il numero di thread vengono scelti all'avvio (vedere run_autotune);
+ * - autotuneCache : percorso della cache dell'autotuning (stringa vuota per quello di default, vedere autotune_cache_path).
  *
  * NOTA : le accelerazioni sono calcolate solo prima di stampare nei file di output.
  */
@@ -50,16 +189,126 @@ typedef struct
     long double *coord;
     long double *vel;
     long double *acc;
+    int engine;
+    long double box;
+    int mesh;
+    long double rsplit;
+    int unroll;
+    int nMassive;
+    int trajFormat;
+    int chunkFrames;
+    long double quantum;
+    char shmName[MAX_NAME_LEN];
+    int shmSlots;
+    long double closeRadius;
+    long double escapeRadius;
+    long double energyTol;
+    int stopOnEvent;
+    int diagCadence;
+    long double watchdogTol;
+    int lyapVectors;
+    int lyapCadence;
+    int pararealSlices;
+    int pararealRatio;
+    long double pararealTol;
+    int reproducible;
+    int collisions;
+    long double density;
+    long double *radii;
+    int softening;
+    long double softLength;
+    int fmmOrder;
+    long double fmmTheta;
+    long double dumpDt;
+    long double *dumpTimes;
+    long int nDumpTimes;
+    int integrator;
+    long double metricsInterval;
+    int *outBodies;
+    int nOutBodies;
+    int outFields;
+    int trajEvery;
+    int energiesEvery;
+    int compensated;
+    int branches;
+    long int branchStep;
+    long double branchCoord;
+    long double branchVel;
+    unsigned long long branchSeed;
+    int branchJobs;
+    long double tStart;
+    int reorderEvery;
+    int *bodySlot;
+    int *bodyOrder;
+    int autotune;
+    char autotuneCache[MAX_NAME_LEN];
 } PhysicalSystem;
 
+/**
+ * Creazione della struct OutputFiles che raccoglie le destinazioni dell'output (quelle non utilizzate sono NULL):
+ * - system : file delle traiettorie in formato testo (traj.dat);
+ * - trajStore : file delle traiettorie a blocchi (traj.bin);
+ * - energies : file delle energie (energies.dat);
+ * - shm : buffer circolare in memoria condivisa per i lettori in tempo reale;
+ * - events : rilevatore degli eventi, che li registra in events.dat;
+ * - diagnostics : file delle grandezze conservate (diagnostics.dat);
+ * - trajBuffer : vettore in cui raccogliere corpi e campi selezionati prima di scriverli nel formato a blocchi (NULL se non serve).
+ */
+typedef struct
+{
+    FILE *system;
+    TrajStore *trajStore;
+    FILE *energies;
+    ShmStream *shm;
+    EventDetector *events;
+    Diagnostics *diagnostics;
+    long double *trajBuffer;
+} OutputFiles;
+
+// numero di corpi per blocco usato da grav_force_tiled: al più TILE_BODIES, può essere ridotto dall'autotuning
+static int tileBodies = TILE_BODIES;
+
 int read_input(FILE *inFile, PhysicalSystem *system);
+int read_dump_times(const char *path, PhysicalSystem *system);
+int parse_body_list(const char *list, PhysicalSystem *system);
 void grav_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
+void grav_force_double(const double *coord, const double *masses, const double G, const int nBodies, double *force);
+void grav_force_tiled(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
+void grav_force_full(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
 long double Ekin(const long double *vel, const long double *masses, const int nBodies);
 long double Epot(const long double *coord, const long double *masses, const long double G, const int nBodies);
 void print_header(FILE *outFile, const PhysicalSystem *system, char *format);
-void print_system(FILE *outFile, const PhysicalSystem *system);
-void print_energies(FILE *outFile, const PhysicalSystem *system);
+void write_value(FILE *outFile, char *chunk, int *used, const long double x, const int width, const int precision, const char sep);
+void print_system(FILE *outFile, const PhysicalSystem *system, const long double time);
+void system_energies(const PhysicalSystem *system, long double *kEnergy, long double *potEnergy);
+void print_energies(FILE *outFile, const long double kEnergy, const long double potEnergy);
+int write_dump(OutputFiles *outputs, const PhysicalSystem *system, const long double time, const long int dumpIndex,
+               long double *energies);
+long double dump_time(const PhysicalSystem *system, const long int k);
+long double dump_position(const PhysicalSystem *system, const long int k);
+long int output_bytes(const OutputFiles *outputs);
+long double pairs_per_step(const PhysicalSystem *system);
 void free_struct_pointers(PhysicalSystem *system);
+int close_outputs(OutputFiles *outputs);
+int print_stored_frame(const char *option, const char *path, const char *value);
+int write_checkpoint(const char *path, const PhysicalSystem *system, const long int stepsDone, const long double suggestedDt,
+                     const char *headersFrom);
+int write_branches(PhysicalSystem *system, const char *inPath);
+int run_benchmark(PhysicalSystem *system, const char *name,
+                  void (*forceFunction)(const long double *, const long double *, const long double, const int, long double *),
+                  SmallNStep smallStep, const long double dtMin, const long double dtMax, const long double target);
+long double uniform_random(unsigned long long *state);
+int print_plummer(const int nBodies, const unsigned long long seed);
+int run_periodic_search(PhysicalSystem *system, const char *name, const long double period, const int nCandidates,
+                        const long double spread, const unsigned long long seed);
+int body_slot(const PhysicalSystem *system, const int body);
+void reorder_bodies(PhysicalSystem *system, long double *force, long double *f_o);
+int run_autotune(const PhysicalSystem *system,
+                 void (**forceFunction)(const long double *, const long double *, const long double, const int, long double *),
+                 SmallNStep *smallStep,
+                 int (*stepFunction)(const long double, const long double, const int, const int, const long double *, long double *,
+                                     long double *, long double *, long double **,
+                                     void (*)(const long double *, const long double *, const long double, const int, long double *)));
 
 int main(int argc, char const *argv[])
 {
@@ -75,11 +324,119 @@ int main(int argc, char const *argv[])
     system->masses = NULL;
     system->coord = NULL;
     system->vel = NULL;
+    system->acc = NULL;
+    system->engine = ENGINE_DIRECT;
+    system->box = -1.L;
+    system->mesh = DEFAULT_MESH;
+    system->rsplit = -1.L;
+    system->unroll = 1;
+    system->nMassive = -1;
+    system->trajFormat = TRAJ_TEXT;
+    system->chunkFrames = TRAJSTORE_DEFAULT_CHUNK;
+    system->quantum = DEFAULT_QUANTUM;
+    system->shmName[0] = '\0';
+    system->shmSlots = SHMSTREAM_DEFAULT_SLOTS;
+    system->closeRadius = -1.L;
+    system->escapeRadius = -1.L;
+    system->energyTol = -1.L;
+    system->stopOnEvent = 0;
+    system->diagCadence = 0;
+    system->watchdogTol = -1.L;
+    system->lyapVectors = 0;
+    system->lyapCadence = LYAPUNOV_DEFAULT_CADENCE;
+    system->pararealSlices = 0;
+    system->pararealRatio = PARAREAL_DEFAULT_RATIO;
+    system->pararealTol = PARAREAL_DEFAULT_TOL;
+    system->reproducible = 0;
+    system->collisions = COLLISIONS_NONE;
+    system->density = -1.L;
+    system->radii = NULL;
+    system->softening = SOFTENING_NONE;
+    system->softLength = -1.L;
+    system->fmmOrder = FMM_DEFAULT_ORDER;
+    system->fmmTheta = FMM_DEFAULT_THETA;
+    system->dumpDt = -1.L;
+    system->dumpTimes = NULL;
+    system->nDumpTimes = 0;
+    system->integrator = INTEGRATOR_VERLET;
+    system->metricsInterval = -1.L;
+    system->outBodies = NULL;
+    system->nOutBodies = 0;
+    system->outFields = FIELD_ALL;
+    system->trajEvery = 1;
+    system->energiesEvery = 1;
+    system->compensated = 0;
+    system->branches = 0;
+    system->branchStep = -1;
+    system->branchCoord = 0.L;
+    system->branchVel = 0.L;
+    system->branchSeed = 1;
+    system->branchJobs = 0;
+    system->tStart = 0.L;
+    system->reorderEvery = 0;
+    system->bodySlot = NULL;
+    system->bodyOrder = NULL;
+    system->autotune = 0;
+    system->autotuneCache[0] = '\0';
 
 #ifdef FUNNY
     srand(time(NULL));
 #endif
 
+    // lettura di un singolo frame da un file di traiettoria a blocchi: ./main.exe --frame traj.bin k oppure --time traj.bin t
+    if (argc == 4 && (strcmp(argv[1], "--frame") == 0 || strcmp(argv[1], "--time") == 0))
+    {
+        free_struct_pointers(system);
+        return print_stored_frame(argv[1], argv[2], argv[3]) == -1 ? 1 : 0;
+    }
+
+    // generazione di un file di input con una sfera di Plummer: ./main.exe --plummer N seed > plummer.dat
+    if (argc == 4 && strcmp(argv[1], "--plummer") == 0)
+    {
+        int nPlummer;
+        unsigned long long seed;
+        free_struct_pointers(system);
+
+        if (sscanf(argv[2], "%d", &nPlummer) != 1 || sscanf(argv[3], "%llu", &seed) != 1)
+        {
+            fprintf(stderr, "\nUso: %s --plummer N seed\n\n", argv[0]);
+            return 1;
+        }
+        return print_plummer(nPlummer, seed) == -1 ? 1 : 0;
+    }
+
+    // Banco di prova: ./main.exe --bench input.dat dtmin dtmax [target] integra il sistema del file di input con diversi dt e
+    // integratori e stampa la tabella lavoro-precisione (vedere run_benchmark) invece di scrivere i file di output.
+    int bench = argc >= 5 && argc <= 6 && strcmp(argv[1], "--bench") == 0;
+    long double dtMin = -1.L, dtMax = -1.L, target = -1.L;
+
+    if (bench && (sscanf(argv[3], "%Lf", &dtMin) != 1 || sscanf(argv[4], "%Lf", &dtMax) != 1 ||
+                  (argc == 6 && sscanf(argv[5], "%Lf", &target) != 1) || dtMin <= 0 || dtMax < dtMin))
+    {
+        fprintf(stderr, "\nUso: %s --bench input.dat dtmin dtmax [target], con 0 < dtmin <= dtmax.\n\n", argv[0]);
+        free_struct_pointers(system);
+        return 1;
+    }
+
+    // Ricerca di orbite periodiche: ./main.exe --periodic input.dat period [candidates spread seed] usa lo stato del file di input e il
+    // periodo come prima stima e la raffina con il metodo di shooting (vedere run_periodic_search), insieme ad altre candidates - 1
+    // stime ottenute perturbandola.
+    int periodic = (argc == 4 || argc == 7) && strcmp(argv[1], "--periodic") == 0;
+    long double period = -1.L, spread = 0.L;
+    int nCandidates = 1;
+    unsigned long long periodicSeed = 1;
+
+    if (periodic && (sscanf(argv[3], "%Lf", &period) != 1 || period <= 0 ||
+                     (argc == 7 && (sscanf(argv[4], "%d", &nCandidates) != 1 || sscanf(argv[5], "%Lf", &spread) != 1 ||
+                                    sscanf(argv[6], "%llu", &periodicSeed) != 1 || nCandidates <= 0 || spread < 0))))
+    {
+        fprintf(stderr, "\nUso: %s --periodic input.dat period [candidates spread seed], con period > 0 e candidates > 0.\n\n", argv[0]);
+        free_struct_pointers(system);
+        return 1;
+    }
+
+    const char *inPath = bench || periodic ? argv[2] : argv[1];
+
     // errore in caso non sia stato letto alcun file in input
     if (argc < 2)
     {
@@ -88,12 +445,12 @@ int main(int argc, char const *argv[])
         return 1;
     }
 
-    inFile = fopen(argv[1], "r");
+    inFile = fopen(inPath, "r");
 
     // errore in caso ci siano stati problemi nell'apertura del file
     if (!inFile)
     {
-        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", argv[1]);
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", inPath);
         free_struct_pointers(system);
         return 1;
     }
@@ -114,442 +471,2837 @@ int main(int argc, char const *argv[])
 
     fclose(inFile);
 
-    FILE *outSystem;
-    FILE *outEnergies;
-    outSystem = fopen(OUTPUT_SYSTEM, "w");
-    outEnergies = fopen(OUTPUT_ENERGIES, "w");
-
-    if (!outSystem || !outEnergies)
+    // se l'header Nmassive è assente tutti i corpi sono massivi
+    if (system->nMassive < 0)
     {
-        fprintf(stderr, "\nErrore nell'apertura dei file di output\n\n");
-
-        // "Chiudere" un puntatore null è undefined behaviour, per questo c'è questo controllo
-        if (outSystem)
-        {
-            fclose(outSystem);
-        }
-        if (outEnergies)
-        {
-            fclose(outEnergies);
-        }
+        system->nMassive = system->nBodies;
+    }
 
+    if (system->nMassive > system->nBodies ||
+        (system->nMassive < system->nBodies && system->engine != ENGINE_DIRECT && system->engine != ENGINE_TILED))
+    {
+        fprintf(stderr, "\nNmassive deve essere al massimo N e i traccianti sono supportati solo dai motori direct e tiled.\n\n");
         free_struct_pointers(system);
         return 1;
     }
 
-    system->acc = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
-    long double *force, *f_o = NULL;
-    force = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
-
-    if (!system->acc || !force)
+    // con le fusioni i corpi cambiano indice, quindi la selezione non avrebbe più senso
+    if (system->outBodies && (system->outBodies[system->nOutBodies - 1] >= system->nBodies || system->collisions == COLLISIONS_MERGE))
     {
-        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        fprintf(stderr, "\nL'header bodies deve indicare corpi tra 1 e N e non è compatibile con le fusioni.\n\n");
+        free_struct_pointers(system);
+        return 1;
+    }
 
-        fclose(outSystem);
-        fclose(outEnergies);
+    if (system->dumpDt > 0 && system->dumpTimes)
+    {
+        fprintf(stderr, "\nGli header dumpdt e dumptimes non possono essere usati insieme.\n\n");
+        free_struct_pointers(system);
+        return 1;
+    }
 
+    // I rami ripartono da un file di input nella loro cartella, che eredita gli header opzionali: il percorso di dumptimes non sarebbe
+    // più valido e più processi non possono scrivere nella stessa memoria condivisa.
+    if (system->branches > 0 && (system->branchStep <= 0 || system->branchStep % system->tdump != 0 ||
+                                 system->branchStep >= system->T / system->tdump * system->tdump || system->dumpTimes ||
+                                 system->shmName[0] != '\0'))
+    {
+        fprintf(stderr, "\nI rami richiedono branchstep multiplo di tdump e minore di T e non sono compatibili con dumptimes e shm.\n\n");
         free_struct_pointers(system);
-        free(force); // Liberato in caso l'allocazione fallita sia quella di system->acc
         return 1;
     }
 
-    // calcolo la forza iniziale per ottenere l'accelerazione da stampare nell'istante iniziale
-    grav_force(system->coord, system->masses, system->G, system->nBodies, force);
+    if (periodic)
+    {
+        int periodicCode = run_periodic_search(system, inPath, period, nCandidates, spread, periodicSeed);
+        free_struct_pointers(system);
+        return periodicCode == -1 ? 1 : 0;
+    }
 
-    // stampa dell'header nei due file di output
-    print_header(outSystem, system, "system");
-    print_header(outEnergies, system, "energies");
+    // scelta del motore di forza: la funzione selezionata rispetta l'interfaccia richiesta da velverlet_ndim_npart
+    void (*forceFunction)(const long double *, const long double *, const long double, const int, long double *) = &grav_force;
 
-    // ciclo generale che stampa nei file di output ogni "system.tdump" integrazioni
-    // NOTA: non serve verificare l'overflow perché questa divisione ritorna un numero minore di system->T, non maggiore.
-    long int totPrint = (long int)(system->T / system->tdump);
-    for (long int i = 0; i < totPrint; i++)
+    if (system->engine == ENGINE_TILED)
     {
-        for (int j = 0; j < system->nBodies; j++)
+        forceFunction = &grav_force_tiled;
+    }
+    else if (system->engine == ENGINE_PM || system->engine == ENGINE_P3M)
+    {
+        if (system->rsplit < 0)
         {
-            for (int k = 0; k < SPATIAL_DIM; k++)
-            {
-                system->acc[k + SPATIAL_DIM * j] = force[k + SPATIAL_DIM * j] / system->masses[j];
-            }
+            system->rsplit = DEFAULT_RSPLIT_CELLS * system->box / system->mesh;
         }
 
-        print_system(outSystem, system);
-        print_energies(outEnergies, system);
-
-        for (int j = 0; j < system->tdump; j++)
+        if (pm_setup(system->nBodies, SPATIAL_DIM, system->mesh, system->box, system->rsplit, system->engine == ENGINE_P3M) == -1)
         {
-            int resultCode = velverlet_ndim_npart(system->dt, system->G, system->nBodies, SPATIAL_DIM, system->masses, system->coord,
-                                                  system->vel, force, &f_o, &grav_force);
-            if (resultCode == -1)
-            {
-                fclose(outSystem);
-                fclose(outEnergies);
-
-                free_struct_pointers(system);
-                free(force);
-                free(f_o);
-                return 1;
-            }
+            free_struct_pointers(system);
+            return 1;
         }
-    }
-
-    fclose(outSystem);
-    fclose(outEnergies);
-
-    free_struct_pointers(system);
-    free(force);
-    free(f_o);
-
-    return 0;
-}
-
-/**
- * Funzione che legge i dati di input a partire dal file fornito in esecuzione (ogni volta che viene chiamata legge una riga).
- *
- * @param inFile Puntatore al file fornito in esecuzione.
- * @param system Puntatore alla struct contenente i dati relativi al sistema fisico considerato.
- *
- * @return -1 per End of File; -2 in caso di errore; 0 di default.
- */
-int read_input(FILE *inFile, PhysicalSystem *system)
-{
-    char line[MAX_LEN], str[5], var[6];
 
-    if (!fgets(line, MAX_LEN, inFile))
-    {
-        return -1;
+        forceFunction = &pm_force;
     }
-
-    static int readHeadersCounter = 0;
-
-    /*
-    Serie di controlli che cerca nBodies, G, dt, tdump e T nell'header e che esclude eventuali commenti.
-
-    Abbiamo optato per questa versione non molto elegante perché, anche utilizzando un vettore contenente i nomi degli header
-    e un vettore in cui inserire i valori letti nelle posizioni corrispondenti, ad un certo punto si sarebbe dovuto assegnare
-    i valori ricavati alla struct con un codice simile. La nostra versione è inoltre più facilmente mantenibile: aggiungendo un header
-    basterebbe aggiungere un if qui e aggiornare la macro N_HEADERS, mentre, nel caso alternativo spiegato sopra, oltre alla macro
-    bisognerebbe anche modificare il vettore con i nomi degli header e la funzione che assegna le variabili alla struct.
-    Quell'approccio alternativo avrebbe potuto creare problemi anche nel casting da long double a integer delle variabili intere lette,
-    con il rischio di troncamenti sconvenienti.
-    */
-    if (line[0] == '#')
+    else if (system->engine == ENGINE_FMM)
     {
-        sscanf(line, "%4s", str);
-        if (strncmp(str, "#HDR", 4) == 0)
+        if (fmm_setup(system->nBodies, SPATIAL_DIM, system->fmmOrder, system->fmmTheta) == -1)
         {
-            long int intRead = -1;
-            long double doubleRead = -1.L;
-            sscanf(line, "%*s %s", var);
-
-            sscanf(line, "%*s %*s %Lf", &doubleRead);
-            if (doubleRead <= 0)
-                return -2;
-
-            if (strncmp(var, "G", 1) == 0 && system->G < 0)
-            {
-                system->G = doubleRead;
-                readHeadersCounter++;
-                return 0;
-            }
-            else if (strncmp(var, "dt", 2) == 0 && system->dt < 0)
-            {
-                system->dt = doubleRead;
-                readHeadersCounter++;
-                return 0;
-            }
+            free_struct_pointers(system);
+            return 1;
+        }
 
-            // Se si arriva qui allora il valore atteso è un numero intero, quindi si può controllare che sia maggiore di 0
-            // se si fosse fatto prima allora sarebbe potuto essere 0 in caso fosse un double minore di 1 per via di troncamento
-            sscanf(line, "%*s %*s %ld", &intRead);
+        forceFunction = &fmm_force;
+    }
 
-            if (intRead <= 0)
-                return -2;
+    if (system->nMassive < system->nBodies)
+    {
+        // I traccianti non esercitano gravità: la loro massa serve solo come massa inerziale nell'integratore e non influenza
+        // la traiettoria, quindi la si pone a 1 (così nel file di input si può scrivere anche 0).
+        for (int j = system->nMassive; j < system->nBodies; j++)
+        {
+            system->masses[j] = 1.L;
+        }
 
-            if (strncmp(var, "N", 1) == 0 && system->nBodies < 0)
-            {
-                system->nBodies = intRead;
-                readHeadersCounter++;
-            }
-            else if (strncmp(var, "tdump", 5) == 0 && system->tdump < 0)
-            {
-                system->tdump = intRead;
-                readHeadersCounter++;
-            }
-            else if (strncmp(var, "T", 1) == 0 && system->T < 0)
-            {
-                system->T = intRead;
-                readHeadersCounter++;
-            }
+        if (restricted_setup(system->nMassive, SPATIAL_DIM) == -1)
+        {
+            free_struct_pointers(system);
+            return 1;
         }
-        return 0;
+        forceFunction = &restricted_force;
     }
 
-    // controllo che siano stati letti i dati necessari per l'esecuzione del programma
-    if (readHeadersCounter != N_HEADERS)
+    // Il softening sostituisce la somma diretta sulle coppie con quella ammorbidita. Lo jacobiano degli esponenti di Lyapunov, la somma
+    // riproducibile e l'energia delle fusioni usano invece il potenziale newtoniano, quindi non possono essere combinati con il softening.
+    if (system->softening != SOFTENING_NONE)
     {
-        return -2;
-    }
-
-    int nChar, nTotChar, bodyNumber;
+        if (system->softLength <= 0 || (system->engine != ENGINE_DIRECT && system->engine != ENGINE_TILED) ||
+            system->nMassive < system->nBodies || system->lyapVectors > 0 || system->reproducible || system->collisions != COLLISIONS_NONE)
+        {
+            fprintf(stderr, "\nIl softening richiede softlength e il motore direct o tiled senza traccianti, Lyapunov, reproducible e "
+                            "collisioni.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
 
-    // I puntatori nella struct sono inizializzati soltanto quando sono NULL, quindi una volta per esecuzione del programma.
-    if (!system->masses)
-    {
-        system->masses = (long double *)malloc(system->nBodies * sizeof(long double));
+        if (softening_setup(system->softening, system->softLength, SPATIAL_DIM) == -1)
+        {
+            free_struct_pointers(system);
+            return 1;
+        }
+        forceFunction = &softening_force;
     }
 
-    if (!system->coord)
+    // In modalità riproducibile la forza diretta viene calcolata in parallelo corpo per corpo (restricted_force ha già un ordine fisso)
+    // e le energie con somme a blocchi: il risultato non dipende dal numero di thread.
+    if (system->reproducible && (system->engine == ENGINE_DIRECT || system->engine == ENGINE_TILED))
     {
-        system->coord = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
+        if (repro_setup(system->nBodies, SPATIAL_DIM) == -1)
+        {
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        if (system->nMassive == system->nBodies)
+        {
+            forceFunction = &repro_force;
+        }
     }
 
-    if (!system->vel)
+    // Per il caso più comune (pochi corpi con la forza diretta) si sceglie, se esiste, il passo con cicli srotolati per quel
+    // numero di corpi, che esegue tutti i tdump passi tra due stampe con una sola chiamata.
+    SmallNStep smallStep = NULL;
+    if (system->engine == ENGINE_DIRECT && system->unroll && system->nMassive == system->nBodies && !system->reproducible &&
+        system->collisions == COLLISIONS_NONE && system->softening == SOFTENING_NONE && !system->compensated)
     {
-        system->vel = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
+        smallStep = velverlet_smalln_select(system->nBodies, SPATIAL_DIM);
     }
 
-    if (!system->masses || !system->coord || !system->vel)
+    if (bench)
     {
-        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
-        return -2;
+        int benchCode = run_benchmark(system, inPath, forceFunction, smallStep, dtMin, dtMax, target);
+        free_struct_pointers(system);
+        return benchCode == -1 ? 1 : 0;
     }
 
-    // lettura del numero di corpo di cui si stanno leggendo posizioni e velocità di partenza
-    sscanf(line, "%d %n", &bodyNumber, &nTotChar);
-
-    // lettura della massa del corpo specificato da bodyNumber
-    sscanf(line + nTotChar, "%Lf %n", system->masses + (bodyNumber - 1), &nChar);
-    nTotChar += nChar;
+    // L'integratore di Yoshida compone tre passi di Velocity Verlet generici, quindi sostituisce i passi specializzati.
+    int (*stepFunction)(const long double, const long double, const int, const int, const long double *, long double *, long double *,
+                        long double *, long double **,
+                        void (*)(const long double *, const long double *, const long double, const int, long double *)) =
+        &velverlet_ndim_npart;
 
-    // ciclo per la lettura della posizione di partenza del corpo specificato da bodyNumber
-    for (int i = 0; i < SPATIAL_DIM; i++)
+    if (system->integrator == INTEGRATOR_YOSHIDA4)
     {
-        sscanf(line + nTotChar, "%Lf %n", system->coord + i + SPATIAL_DIM * (bodyNumber - 1), &nChar);
-        nTotChar += nChar;
+        if (system->lyapVectors > 0 || system->pararealSlices > 0)
+        {
+            fprintf(stderr, "\nL'integratore yoshida4 non è supportato con gli esponenti di Lyapunov e il parareal.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        smallStep = NULL;
+        stepFunction = &yoshida4_ndim_npart;
     }
 
-    // ciclo per la lettura della velocità di partenza del corpo specificato da bodyNumber
-    for (int i = 0; i < SPATIAL_DIM; i++)
+    // Anche il passo compensato sostituisce i passi specializzati: ha la loro interfaccia e calcola la forza diretta in double, quindi
+    // non è compatibile con gli altri motori e con ciò che cambia la forza o lo stato tra i passi.
+    if (system->compensated)
     {
-        sscanf(line + nTotChar, "%Lf %n", system->vel + i + SPATIAL_DIM * (bodyNumber - 1), &nChar);
-        nTotChar += nChar;
-    }
+        if (system->integrator != INTEGRATOR_VERLET || system->engine != ENGINE_DIRECT || system->nMassive < system->nBodies ||
+            system->softening != SOFTENING_NONE || system->collisions != COLLISIONS_NONE || system->reproducible || system->autotune ||
+            system->lyapVectors > 0 || system->pararealSlices > 0)
+        {
+            fprintf(stderr, "\nLa somma compensata è supportata solo da Velocity Verlet con il motore direct, senza traccianti, softening, "
+                            "collisioni, reproducible, autotuning, Lyapunov e parareal.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
 
-    return 0;
-}
+        if (compensated_setup(system->nBodies, SPATIAL_DIM, system->coord, system->vel, &grav_force_double) == -1)
+        {
+            free_struct_pointers(system);
+            return 1;
+        }
 
-/**
- * Funzione che, date le posizioni di un numero di corpi specificato in un dato istante, calcola le forze gravitazionali
- * agenti tra questi nel dato istante.
- *
- * @param coord Puntatore al vettore di long double contenente le posizioni dei corpi un corpo alla volta: x11, x12, ..., x21, ...
- * @param masses Puntatore al vettore di long double contenente le masse dei corpi nel sistema.
- * @param G Costante di gravitazione considerata per il calcolo della forza gravitazionale.
- * @param nBodies Numero di corpi che compongono il sistema considerato.
- * @param force Puntatore al vettore di long double in cui salvare la risultante delle forze su ciascun corpo.
- */
-void grav_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
-{
-    long double forceComp, d;
-    long double vec_d[SPATIAL_DIM];
+        smallStep = &compensated_steps;
+    }
 
-    for (int i = 0; i < SPATIAL_DIM * nBodies; i++)
+    // L'autotuning misura le varianti della somma diretta con il passo scelto fin qui e sostituisce forza, passo specializzato e numero
+    // di thread con la combinazione più veloce.
+    if (system->autotune && run_autotune(system, &forceFunction, &smallStep, stepFunction) == -1)
     {
-        force[i] = 0.L;
+        free_struct_pointers(system);
+        return 1;
     }
 
-    for (int i = 0; i < nBodies; i++)
+    // Gli esponenti di Lyapunov richiedono lo jacobiano della forza diretta: il passo che propaga anche i vettori tangenti ha la stessa
+    // interfaccia dei passi specializzati e li sostituisce.
+    if (system->lyapVectors > 0)
     {
-        for (int j = i + 1; j < nBodies; j++)
+        if (system->engine != ENGINE_DIRECT || system->nMassive < system->nBodies)
         {
-            vec_diff((coord + i * SPATIAL_DIM), (coord + j * SPATIAL_DIM), vec_d, SPATIAL_DIM);
+            fprintf(stderr, "\nGli esponenti di Lyapunov sono supportati solo dal motore direct senza traccianti.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        if (lyapunov_setup(OUTPUT_LYAPUNOV, system->lyapVectors, system->lyapCadence, system->nBodies, SPATIAL_DIM, system->coord,
+                           system->masses, system->G) == -1)
+        {
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        smallStep = &lyapunov_steps;
+    }
+
+    // Il parareal divide ogni blocco di passi tra i thread usando come propagatore fine il passo scelto fin qui. Le forze
+    // particle-mesh e FMM usano memoria statica condivisa e non possono essere calcolate da più thread insieme.
+    if (system->pararealSlices > 0)
+    {
+        if (system->engine == ENGINE_PM || system->engine == ENGINE_P3M || system->engine == ENGINE_FMM || system->lyapVectors > 0)
+        {
+            fprintf(stderr, "\nL'integrazione parareal non è supportata dai motori particle-mesh e FMM e con gli esponenti di "
+                            "Lyapunov.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        if (parareal_setup(system->nBodies, SPATIAL_DIM, system->pararealSlices, system->pararealRatio, system->pararealTol, forceFunction,
+                           smallStep) == -1)
+        {
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        smallStep = &parareal_steps;
+    }
+
+    // Le collisioni vengono controllate dopo ogni passo di Velocity Verlet. Le fusioni riducono il numero di corpi, quindi non sono
+    // compatibili con le destinazioni dell'output e con i controlli che assumono N costante.
+    if (system->collisions != COLLISIONS_NONE)
+    {
+        if ((system->engine != ENGINE_DIRECT && system->engine != ENGINE_TILED) || system->nMassive < system->nBodies ||
+            system->lyapVectors > 0 || system->pararealSlices > 0)
+        {
+            fprintf(stderr, "\nLe collisioni sono supportate solo dai motori direct e tiled senza traccianti, Lyapunov e parareal.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        if (system->collisions == COLLISIONS_MERGE && (system->trajFormat == TRAJ_CHUNKED || system->shmName[0] != '\0' ||
+                                                       system->closeRadius > 0 || system->escapeRadius > 0 || system->energyTol > 0))
+        {
+            fprintf(stderr, "\nLe fusioni non sono compatibili con trajformat chunked, memoria condivisa ed eventi.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        // raggio di una sfera di massa m e densità density
+        for (int j = 0; j < system->nBodies && system->density > 0; j++)
+        {
+            if (system->radii[j] == 0.L)
+            {
+                system->radii[j] = cbrtl(3.L * system->masses[j] / (4.L * M_PI * system->density));
+            }
+        }
+
+        if (collisions_setup(OUTPUT_COLLISIONS, system->collisions, system->nBodies, SPATIAL_DIM, system->coord, system->radii) == -1)
+        {
+            free_struct_pointers(system);
+            return 1;
+        }
+    }
+
+    // I riordinamenti spostano i corpi nei vettori, quindi non sono compatibili con chi conserva o pubblica gli indici delle posizioni
+    // (eventi, collisioni, memoria condivisa), con lo stato per corpo di Lyapunov, parareal e passo compensato. Il primo riordinamento
+    // avviene qui, prima del calcolo della forza iniziale.
+    if (system->reorderEvery > 0)
+    {
+        if (system->shmName[0] != '\0' || system->closeRadius > 0 || system->escapeRadius > 0 || system->energyTol > 0 ||
+            system->collisions != COLLISIONS_NONE || system->lyapVectors > 0 || system->pararealSlices > 0 || system->compensated)
+        {
+            fprintf(stderr, "\nI riordinamenti non sono compatibili con memoria condivisa, eventi, collisioni, Lyapunov, parareal e somma "
+                            "compensata.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        system->bodySlot = (int *)malloc(system->nBodies * sizeof(int));
+        system->bodyOrder = (int *)malloc(system->nBodies * sizeof(int));
+        if (!system->bodySlot || !system->bodyOrder || sfc_setup(system->nBodies, SPATIAL_DIM) == -1)
+        {
+            fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+            free_struct_pointers(system);
+            return 1;
+        }
+
+        for (int j = 0; j < system->nBodies; j++)
+        {
+            system->bodyOrder[j] = j;
+        }
+        reorder_bodies(system, NULL, NULL);
+    }
+
+    // le traiettorie vanno in traj.dat (testo) oppure in traj.bin (formato a blocchi), mai in entrambi, o da nessuna parte
+    OutputFiles outputs = {NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    int nOut = system->outBodies ? system->nOutBodies : system->nBodies;
+
+    // Nel formato a blocchi ogni frame contiene tutti i campi: i corpi selezionati vengono raccolti in trajBuffer (usato prima per
+    // le loro masse) e i campi non selezionati sono scritti come zeri, che dopo la codifica differenziale occupano un byte per valore.
+    // Con i riordinamenti trajBuffer riporta anche i corpi nell'ordine del file di input.
+    int selected = system->outBodies || system->outFields != FIELD_ALL || system->bodySlot;
+    if (system->trajFormat == TRAJ_CHUNKED && selected)
+    {
+        outputs.trajBuffer = (long double *)malloc(3 * nOut * SPATIAL_DIM * sizeof(long double));
+        for (int b = 0; b < nOut && outputs.trajBuffer; b++)
+        {
+            outputs.trajBuffer[b] = system->masses[body_slot(system, system->outBodies ? system->outBodies[b] : b)];
+        }
+    }
+
+    if (system->trajFormat == TRAJ_CHUNKED && (!selected || outputs.trajBuffer))
+    {
+        outputs.trajStore = trajstore_create(OUTPUT_SYSTEM_CHUNKED, nOut, SPATIAL_DIM, system->chunkFrames, (double)system->quantum,
+                                             selected ? outputs.trajBuffer : system->masses);
+    }
+    else if (system->trajFormat == TRAJ_TEXT)
+    {
+        outputs.system = fopen(OUTPUT_SYSTEM, "w");
+    }
+    outputs.energies = fopen(OUTPUT_ENERGIES, "w");
+
+    if (system->shmName[0] != '\0')
+    {
+        outputs.shm = shmstream_create(system->shmName, system->nBodies, SPATIAL_DIM, system->shmSlots);
+    }
+
+    if ((system->trajFormat != TRAJ_NONE && !outputs.system && !outputs.trajStore) || !outputs.energies || (system->shmName[0] != '\0' && !outputs.shm))
+    {
+        fprintf(stderr, "\nErrore nell'apertura dei file di output\n\n");
+
+        close_outputs(&outputs);
+
+        free_struct_pointers(system);
+        return 1;
+    }
+
+    // buffer statici (non nello stack, data la dimensione) che restano validi fino alla chiusura dei file
+    static char systemBuffer[OUTPUT_BUFFER_SIZE], energiesBuffer[OUTPUT_BUFFER_SIZE];
+    if (outputs.system)
+    {
+        setvbuf(outputs.system, systemBuffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+    }
+    setvbuf(outputs.energies, energiesBuffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    system->acc = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
+    long double *force, *f_o = NULL;
+    force = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
+
+    // Con l'output denso servono lo stato all'inizio del passo che contiene un tempo di stampa (posizioni, velocità e forze) e lo stato
+    // interpolato (posizioni, velocità e accelerazioni): sei vettori in un solo blocco.
+    int dense = system->dumpDt > 0 || system->dumpTimes;
+    long double *denseBuf = NULL;
+    if (dense)
+    {
+        denseBuf = (long double *)malloc(6 * system->nBodies * SPATIAL_DIM * sizeof(long double));
+    }
+
+    if (!system->acc || !force || (dense && !denseBuf))
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+
+        close_outputs(&outputs);
+
+        free_struct_pointers(system);
+        free(force); // Liberato in caso l'allocazione fallita sia quella di system->acc
+        free(denseBuf);
+        return 1;
+    }
+
+    // calcolo la forza iniziale per ottenere l'accelerazione da stampare nell'istante iniziale
+    forceFunction(system->coord, system->masses, system->G, system->nBodies, force);
+
+    // eventi, diagnostica e controllo della deriva partono dallo stato iniziale, la cui energia è il riferimento per l'errore relativo
+    long double kEnergy0, potEnergy0;
+    system_energies(system, &kEnergy0, &potEnergy0);
+
+    Watchdog watchdog;
+    watchdog_init(&watchdog, system->watchdogTol, kEnergy0 + potEnergy0);
+
+    if (system->diagCadence > 0)
+    {
+        outputs.diagnostics = diagnostics_create(OUTPUT_DIAGNOSTICS, system->diagCadence, system->nMassive, SPATIAL_DIM, system->masses,
+                                                 system->coord, system->vel, system->tStart, kEnergy0 + potEnergy0);
+        if (!outputs.diagnostics)
+        {
+            close_outputs(&outputs);
+
+            free_struct_pointers(system);
+            free(force);
+            free(denseBuf);
+            return 1;
+        }
+
+        diagnostics_write(outputs.diagnostics, system->tStart, system->masses, system->coord, system->vel, kEnergy0, potEnergy0);
+    }
+
+    if (system->closeRadius > 0 || system->escapeRadius > 0 || system->energyTol > 0)
+    {
+        outputs.events = events_create(OUTPUT_EVENTS, system->closeRadius, system->escapeRadius, system->energyTol, system->stopOnEvent,
+                                       system->nBodies, system->nMassive, SPATIAL_DIM, system->tStart, system->coord, system->vel,
+                                       system->masses, system->G, kEnergy0 + potEnergy0);
+        if (!outputs.events)
+        {
+            close_outputs(&outputs);
+
+            free_struct_pointers(system);
+            free(force);
+            free(denseBuf);
+            return 1;
+        }
+    }
+
+    // stampa dell'header nei due file di output
+    if (outputs.system)
+    {
+        print_header(outputs.system, system, "system");
+    }
+    print_header(outputs.energies, system, "energies");
+
+    // ciclo generale che stampa nei file di output ogni "system.tdump" integrazioni
+    // NOTA: non serve verificare l'overflow perché questa divisione ritorna un numero minore di system->T, non maggiore.
+    long int totPrint = (long int)(system->T / system->tdump);
+    // stopped diventa 1 per un evento con stoponevent e per il controllo della deriva, che imposta anche abortStep
+    int stopped = 0;
+    long int abortStep = -1;
+    // passo dell'ultimo riordinamento dei corpi
+    long int lastReorder = 0;
+
+    // Il file delle metriche e gli snapshot su SIGUSR1 permettono di seguire le simulazioni lunghe senza interromperle. Il gestore del
+    // segnale viene installato anche senza l'header metrics, così SIGUSR1 non termina il programma ma salva uno snapshot.
+    if (metrics_setup(OUTPUT_METRICS, (double)system->metricsInterval, totPrint * system->tdump, system->dt) == -1)
+    {
+        close_outputs(&outputs);
+
+        free_struct_pointers(system);
+        free(force);
+        free(denseBuf);
+        return 1;
+    }
+    // ultimo errore relativo sull'energia calcolato e passi eseguiti, riportati nelle metriche
+    long double energyError = 0.L;
+    long int stepsDone = 0;
+    // diventa 1 quando la simulazione si ferma per dividersi nei rami
+    int branched = 0;
+
+    // Con l'output denso le stampe avvengono ai tempi dump_time(system, nextDump), la cui posizione in passi è dumpPos. Lo stato
+    // all'inizio del passo che contiene un tempo di stampa viene salvato in prevCoord, prevVel e prevForce.
+    long int nextDump = 0;
+    long double dumpPos = dense ? dump_position(system, 0) : -1.L;
+    long double *prevCoord = NULL, *prevVel = NULL, *prevForce = NULL, *dumpCoord = NULL, *dumpVel = NULL, *dumpAcc = NULL;
+    if (dense)
+    {
+        int n = system->nBodies * SPATIAL_DIM;
+        prevCoord = denseBuf;
+        prevVel = denseBuf + n;
+        prevForce = denseBuf + 2 * n;
+        dumpCoord = denseBuf + 3 * n;
+        dumpVel = denseBuf + 4 * n;
+        dumpAcc = denseBuf + 5 * n;
+    }
+
+    for (long int i = 0; i < totPrint && !stopped; i++)
+    {
+        // Le accelerazioni servono solo a chi le scrive: per tutti i corpi alla memoria condivisa, per i corpi selezionati al file
+        // delle traiettorie se l'header fields le include e se in questa stampa le traiettorie vanno scritte.
+        int accTraj = i % system->trajEvery == 0 && (outputs.system || outputs.trajStore) && (system->outFields & FIELD_ACC);
+        int nAcc = dense ? 0 : outputs.shm ? system->nBodies : accTraj ? nOut : 0;
+        for (int b = 0; b < nAcc; b++)
+        {
+            int j = body_slot(system, system->outBodies && !outputs.shm ? system->outBodies[b] : b);
+
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+                system->acc[k + SPATIAL_DIM * j] = force[k + SPATIAL_DIM * j] / system->masses[j];
+            }
+        }
+
+        long double time = (long double)i * system->tdump * system->dt;
+        long double energies[SHMSTREAM_ENERGIES];
+
+        // le energie vengono calcolate una sola volta per stampa e usate da tutte le destinazioni dell'output
+        int dumpCode = dense ? 0 : write_dump(&outputs, system, system->tStart + time, i, energies);
+        if (dumpCode == -1)
+        {
+            close_outputs(&outputs);
+
+            free_struct_pointers(system);
+            free(force);
+            free(denseBuf);
+            free(f_o);
+            return 1;
+        }
+
+        if (dumpCode == 1)
+        {
+            energyError = fabsl((energies[2] - watchdog.energy0) / watchdog.energyScale);
+        }
+
+        // il controllo della deriva usa le energie già calcolate per le stampe (e per la diagnostica, qui sotto)
+        if (!dense && system->watchdogTol > 0 && i > 0 && watchdog_check(&watchdog, time, energies[2]))
+        {
+            stopped = 1;
+            abortStep = i * system->tdump;
+            break;
+        }
+
+        // il prefisso comune ai rami termina con la stampa dello stato al passo branchStep, da cui i rami ripartono
+        if (system->branches > 0 && i * system->tdump == system->branchStep)
+        {
+            branched = 1;
+            stepsDone = system->branchStep;
+            break;
+        }
+
+        // I passi tra due stampe vengono eseguiti a blocchi che terminano dove serve un controllo: ogni passo se ci sono eventi da
+        // rilevare, ogni diagCadence passi per la diagnostica. Senza controlli il blocco è l'intero intervallo di tdump passi.
+        for (int j = 0; j < system->tdump && !stopped;)
+        {
+            int batch = system->tdump - j;
+            long int step = i * system->tdump + j;
+
+            if (outputs.events || system->collisions != COLLISIONS_NONE)
+            {
+                batch = 1;
+            }
+            else if (outputs.diagnostics && system->diagCadence - step % system->diagCadence < batch)
+            {
+                batch = (int)(system->diagCadence - step % system->diagCadence);
+            }
+
+            // i blocchi durano al più METRICS_LATENCY secondi, così le richieste di snapshot vengono servite subito (il parareal divide
+            // ogni blocco tra i thread, quindi i suoi blocchi non vengono accorciati per non cambiarne il risultato)
+            long int maxBatch = metrics_max_batch(step);
+            if (smallStep != &parareal_steps && maxBatch < batch)
+            {
+                batch = (int)maxBatch;
+            }
+
+            // con l'output denso il passo che contiene il prossimo tempo di stampa viene eseguito da solo, salvandone lo stato iniziale
+            if (dumpPos >= 0)
+            {
+                long double stepsToDump = ceill(dumpPos) - step;
+
+                if (stepsToDump <= 1)
+                {
+                    batch = 1;
+                    memcpy(prevCoord, system->coord, system->nBodies * SPATIAL_DIM * sizeof(long double));
+                    memcpy(prevVel, system->vel, system->nBodies * SPATIAL_DIM * sizeof(long double));
+                    memcpy(prevForce, force, system->nBodies * SPATIAL_DIM * sizeof(long double));
+                }
+                else if (stepsToDump - 1 < batch)
+                {
+                    batch = (int)(stepsToDump - 1);
+                }
+            }
+
+            if (smallStep)
+            {
+                smallStep(system->dt, system->G, system->masses, system->coord, system->vel, force, batch);
+            }
+            else
+            {
+                for (int b = 0; b < batch; b++)
+                {
+                    int resultCode = stepFunction(system->dt, system->G, system->nBodies, SPATIAL_DIM, system->masses, system->coord,
+                                                  system->vel, force, &f_o, forceFunction);
+                    if (resultCode == -1)
+                    {
+                        close_outputs(&outputs);
+
+                        free_struct_pointers(system);
+                        free(force);
+                        free(denseBuf);
+                        free(f_o);
+                        return 1;
+                    }
+                }
+            }
+
+            j += batch;
+            step += batch;
+
+            // Stampe dell'output denso che cadono nel passo appena eseguito: posizioni e velocità vengono interpolate con Hermite tra
+            // gli estremi del passo (errore O(dt^4), minore di quello dell'integratore), le accelerazioni linearmente dalle forze.
+            // Un tempo che coincide con la fine del passo dà esattamente lo stato integrato.
+            while (dumpPos >= 0 && dumpPos <= step)
+            {
+                long double s = dumpPos - (step - 1), dumpT = dump_time(system, nextDump);
+
+                for (int b = 0; b < system->nBodies; b++)
+                {
+                    int o = b * SPATIAL_DIM;
+                    hermite_interpolate(SPATIAL_DIM, s, system->dt, prevCoord + o, prevVel + o, system->coord + o, system->vel + o,
+                                        dumpCoord + o, dumpVel + o);
+
+                    for (int k = 0; k < SPATIAL_DIM; k++)
+                    {
+                        dumpAcc[o + k] = ((1.L - s) * prevForce[o + k] + s * force[o + k]) / system->masses[b];
+                    }
+                }
+
+                // copia della struct che punta allo stato interpolato, così le energie usano le stesse funzioni delle stampe regolari
+                PhysicalSystem dumpSystem = *system;
+                dumpSystem.coord = dumpCoord;
+                dumpSystem.vel = dumpVel;
+                dumpSystem.acc = dumpAcc;
+
+                long double dumpEnergies[SHMSTREAM_ENERGIES];
+                int dumpCode = write_dump(&outputs, &dumpSystem, system->tStart + dumpT, nextDump, dumpEnergies);
+                if (dumpCode == -1)
+                {
+                    close_outputs(&outputs);
+
+                    free_struct_pointers(system);
+                    free(force);
+                    free(denseBuf);
+                    free(f_o);
+                    return 1;
+                }
+
+                dumpPos = dump_position(system, ++nextDump);
+                if (dumpCode == 1)
+                {
+                    energyError = fabsl((dumpEnergies[2] - watchdog.energy0) / watchdog.energyScale);
+                }
+
+                if (system->watchdogTol > 0 && dumpT > 0 && watchdog_check(&watchdog, dumpT, dumpEnergies[2]))
+                {
+                    stopped = 1;
+                    abortStep = step;
+                    break;
+                }
+            }
+
+            if (stopped)
+            {
+                break;
+            }
+
+            // Dopo una fusione le forze vanno ricalcolate (anche quelle del passo precedente usate da velverlet_ndim_npart) e la
+            // variazione dell'energia viene tolta dai riferimenti, così diagnostica e controllo della deriva misurano solo l'errore
+            // di integrazione; l'errore resta relativo all'energia iniziale (energyScale), non a quella spostata.
+            long double energyJump;
+            if (system->collisions != COLLISIONS_NONE &&
+                collisions_step(system->tStart + step * system->dt, system->G, &system->nBodies, system->masses, system->coord, system->vel,
+                                system->radii, &energyJump) > 0)
+            {
+                system->nMassive = system->nBodies;
+                forceFunction(system->coord, system->masses, system->G, system->nBodies, force);
+                memcpy(f_o, force, system->nBodies * SPATIAL_DIM * sizeof(long double));
+
+                watchdog.energy0 += energyJump;
+                if (outputs.diagnostics)
+                {
+                    outputs.diagnostics->nMassive = system->nBodies;
+                    outputs.diagnostics->energy0 += energyJump;
+                }
+            }
+
+            // anche i riordinamenti avvengono tra due blocchi, dopo almeno reorderEvery passi dal precedente
+            if (system->reorderEvery > 0 && step - lastReorder >= system->reorderEvery)
+            {
+                reorder_bodies(system, force, f_o);
+                lastReorder = step;
+            }
+
+            // punto sicuro per le metriche: con SIGUSR1 lo stato dopo step passi viene salvato come checkpoint, da cui si può ripartire
+            stepsDone = step;
+            if (metrics_due() && metrics_poll(step, pairs_per_step(system), energyError, output_bytes(&outputs)) &&
+                write_checkpoint(OUTPUT_SNAPSHOT, system, step, -1.L, NULL) == 0)
+            {
+                fprintf(stderr, "Snapshot al tempo %Lf salvato in %s.\n", system->tStart + step * system->dt, OUTPUT_SNAPSHOT);
+            }
+
+            int diagDue = outputs.diagnostics && step % system->diagCadence == 0;
+            if (!outputs.events && !diagDue)
+            {
+                continue;
+            }
+
+            // l'energia totale fuori dalle stampe serve solo alla diagnostica e all'evento sull'errore relativo, dato che costa quanto
+            // una forza
+            long double stepTime = (long double)step * system->dt;
+            long double stepEnergies[2] = {0.L, 0.L};
+            if (diagDue || (outputs.events && events_need_energy(outputs.events)))
+            {
+                system_energies(system, stepEnergies, stepEnergies + 1);
+            }
+
+            if (diagDue)
+            {
+                diagnostics_write(outputs.diagnostics, system->tStart + stepTime, system->masses, system->coord, system->vel,
+                                  stepEnergies[0], stepEnergies[1]);
+                energyError = fabsl((stepEnergies[0] + stepEnergies[1] - watchdog.energy0) / watchdog.energyScale);
+
+                if (system->watchdogTol > 0 && watchdog_check(&watchdog, stepTime, stepEnergies[0] + stepEnergies[1]))
+                {
+                    stopped = 1;
+                    abortStep = step;
+                    break;
+                }
+            }
+
+            if (outputs.events)
+            {
+                stopped = events_step(outputs.events, system->tStart + stepTime, system->coord, system->vel, system->masses, system->G,
+                                      stepEnergies[0] + stepEnergies[1]);
+            }
+        }
+    }
+
+    metrics_poll(stepsDone, pairs_per_step(system), energyError, output_bytes(&outputs));
+
+    if (abortStep >= 0)
+    {
+        // l'errore sull'energia scala come dt^2 con Velocity Verlet (anche compensato) e come dt^4 con Yoshida
+        int order = system->integrator == INTEGRATOR_YOSHIDA4 ? 4 : 2;
+        long double beta, suggestedDt = watchdog_suggest_dt(&watchdog, system->dt, order, system->T * system->dt, &beta);
+
+        fprintf(stderr, "\nErrore relativo sull'energia %Le oltre la tolleranza %Le al tempo %Lf: simulazione interrotta.\n"
+                        "Crescita stimata dell'errore ~ t^%.2Lf, dt suggerito: %Le (attuale %Le).\n",
+                watchdog.maxErr, system->watchdogTol, system->tStart + abortStep * system->dt, beta, suggestedDt, system->dt);
+
+        if (write_checkpoint(OUTPUT_CHECKPOINT, system, abortStep, suggestedDt, NULL) == 0)
+        {
+            fprintf(stderr, "Stato finale salvato in %s.\n\n", OUTPUT_CHECKPOINT);
+        }
+    }
+    else if (stopped)
+    {
+        fprintf(stderr, "\nSimulazione interrotta da un evento (vedere %s).\n\n", OUTPUT_EVENTS);
+    }
+
+    // il formato a blocchi scrive l'indice dei frame alla chiusura, quindi anche la chiusura può fallire
+    int closeCode = close_outputs(&outputs);
+
+    // I rami vengono eseguiti da processi separati, avviati solo dopo la chiusura dei file del prefisso: ognuno ha i suoi motori di
+    // forza e i suoi file di output, e nessuno ripete l'integrazione del prefisso.
+    int branchCode = 0;
+    if (branched)
+    {
+        branchCode = write_branches(system, inPath);
+        if (branchCode == 0)
+        {
+            int jobs = system->branchJobs > 0 ? system->branchJobs : branch_procs();
+            branchCode = branch_run(argv[0], system->branches, jobs < system->branches ? jobs : system->branches);
+        }
+    }
+
+    free_struct_pointers(system);
+    free(force);
+    free(f_o);
+    free(denseBuf);
+
+    return (closeCode == -1 || abortStep >= 0 || branchCode != 0) ? 1 : 0;
+}
+
+/**
+ * Funzione che legge i dati di input a partire dal file fornito in esecuzione (ogni volta che viene chiamata legge una riga).
+ *
+ * @param inFile Puntatore al file fornito in esecuzione.
+ * @param system Puntatore alla struct contenente i dati relativi al sistema fisico considerato.
+ *
+ * @return -1 per End of File; -2 in caso di errore; 0 di default.
+ */
+int read_input(FILE *inFile, PhysicalSystem *system)
+{
+    char line[MAX_LEN], str[5], var[MAX_LEN], value[MAX_LEN];
+
+    if (!fgets(line, MAX_LEN, inFile))
+    {
+        return -1;
+    }
+
+    static int readHeadersCounter = 0;
+
+    /*
+    Serie di controlli che cerca nBodies, G, dt, tdump e T nell'header e che esclude eventuali commenti.
+
+    Abbiamo optato per questa versione non molto elegante perché, anche utilizzando un vettore contenente i nomi degli header
+    e un vettore in cui inserire i valori letti nelle posizioni corrispondenti, ad un certo punto si sarebbe dovuto assegnare
+    i valori ricavati alla struct con un codice simile. La nostra versione è inoltre più facilmente mantenibile: aggiungendo un header
+    basterebbe aggiungere un if qui e aggiornare la macro N_HEADERS, mentre, nel caso alternativo spiegato sopra, oltre alla macro
+    bisognerebbe anche modificare il vettore con i nomi degli header e la funzione che assegna le variabili alla struct.
+    Quell'approccio alternativo avrebbe potuto creare problemi anche nel casting da long double a integer delle variabili intere lette,
+    con il rischio di troncamenti sconvenienti.
+    */
+    if (line[0] == '#')
+    {
+        sscanf(line, "%4s", str);
+        if (strncmp(str, "#HDR", 4) == 0)
+        {
+            long int intRead = -1;
+            long double doubleRead = -1.L;
+            sscanf(line, "%*s %s", var);
+
+            // Header opzionali: non vengono conteggiati in readHeadersCounter e se assenti restano ai valori di default.
+            // Vanno controllati per primi con strcmp, altrimenti i confronti per prefisso qui sotto li scambierebbero per N, G o T.
+            if (strcmp(var, "engine") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1)
+                    return -2;
+
+                if (strcmp(value, "direct") == 0)
+                    system->engine = ENGINE_DIRECT;
+                else if (strcmp(value, "tiled") == 0)
+                    system->engine = ENGINE_TILED;
+                else if (strcmp(value, "pm") == 0)
+                    system->engine = ENGINE_PM;
+                else if (strcmp(value, "p3m") == 0)
+                    system->engine = ENGINE_P3M;
+                else if (strcmp(value, "fmm") == 0)
+                    system->engine = ENGINE_FMM;
+                else
+                    return -2;
+
+                return 0;
+            }
+            else if (strcmp(var, "box") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->box) == 1 && system->box > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "mesh") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->mesh) == 1 && system->mesh > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "rsplit") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->rsplit) == 1 && system->rsplit > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "Nmassive") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->nMassive) == 1 && system->nMassive > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "trajformat") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1)
+                    return -2;
+
+                if (strcmp(value, "text") == 0)
+                    system->trajFormat = TRAJ_TEXT;
+                else if (strcmp(value, "chunked") == 0)
+                    system->trajFormat = TRAJ_CHUNKED;
+                else if (strcmp(value, "none") == 0)
+                    system->trajFormat = TRAJ_NONE;
+                else
+                    return -2;
+
+                return 0;
+            }
+            else if (strcmp(var, "chunkframes") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->chunkFrames) == 1 && system->chunkFrames > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "quantum") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->quantum) == 1 && system->quantum > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "shm") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1 || strlen(value) >= MAX_NAME_LEN)
+                    return -2;
+
+                strcpy(system->shmName, value);
+                return 0;
+            }
+            else if (strcmp(var, "shmslots") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->shmSlots) == 1 && system->shmSlots > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "closeradius") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->closeRadius) == 1 && system->closeRadius > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "escaperadius") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->escapeRadius) == 1 && system->escapeRadius > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "energytol") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->energyTol) == 1 && system->energyTol > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "stoponevent") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->stopOnEvent) == 1 && system->stopOnEvent >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "diagcadence") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->diagCadence) == 1 && system->diagCadence >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "watchdogtol") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->watchdogTol) == 1 && system->watchdogTol > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "lyapunov") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->lyapVectors) == 1 && system->lyapVectors >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "lyapcadence") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->lyapCadence) == 1 && system->lyapCadence > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "parareal") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->pararealSlices) == 1 && system->pararealSlices >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "pararealratio") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->pararealRatio) == 1 && system->pararealRatio > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "pararealtol") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->pararealTol) == 1 && system->pararealTol >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "reproducible") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->reproducible) == 1 && system->reproducible >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "collisions") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1)
+                    return -2;
+
+                if (strcmp(value, "none") == 0)
+                    system->collisions = COLLISIONS_NONE;
+                else if (strcmp(value, "merge") == 0)
+                    system->collisions = COLLISIONS_MERGE;
+                else if (strcmp(value, "bounce") == 0)
+                    system->collisions = COLLISIONS_BOUNCE;
+                else
+                    return -2;
+
+                return 0;
+            }
+            else if (strcmp(var, "density") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->density) == 1 && system->density > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "softening") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1)
+                    return -2;
+
+                if (strcmp(value, "none") == 0)
+                    system->softening = SOFTENING_NONE;
+                else if (strcmp(value, "plummer") == 0)
+                    system->softening = SOFTENING_PLUMMER;
+                else if (strcmp(value, "spline") == 0)
+                    system->softening = SOFTENING_SPLINE;
+                else
+                    return -2;
+
+                return 0;
+            }
+            else if (strcmp(var, "softlength") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->softLength) == 1 && system->softLength > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "fmmorder") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->fmmOrder) == 1 && system->fmmOrder > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "fmmtheta") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->fmmTheta) == 1 && system->fmmTheta > 0 && system->fmmTheta < 1) ? 0 : -2;
+            }
+            else if (strcmp(var, "dumpdt") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->dumpDt) == 1 && system->dumpDt > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "dumptimes") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1 || system->dumpTimes)
+                    return -2;
+
+                return read_dump_times(value, system);
+            }
+            else if (strcmp(var, "integrator") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1)
+                    return -2;
+
+                if (strcmp(value, "verlet") == 0)
+                    system->integrator = INTEGRATOR_VERLET;
+                else if (strcmp(value, "yoshida4") == 0)
+                    system->integrator = INTEGRATOR_YOSHIDA4;
+                else
+                    return -2;
+
+                return 0;
+            }
+            else if (strcmp(var, "metrics") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->metricsInterval) == 1 && system->metricsInterval > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "bodies") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1 || system->outBodies)
+                    return -2;
+
+                return parse_body_list(value, system);
+            }
+            else if (strcmp(var, "fields") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1)
+                    return -2;
+
+                system->outFields = 0;
+                for (char *field = strtok(value, ","); field; field = strtok(NULL, ","))
+                {
+                    if (strcmp(field, "coords") == 0)
+                        system->outFields |= FIELD_COORDS;
+                    else if (strcmp(field, "vel") == 0)
+                        system->outFields |= FIELD_VEL;
+                    else if (strcmp(field, "acc") == 0)
+                        system->outFields |= FIELD_ACC;
+                    else
+                        return -2;
+                }
+
+                return system->outFields ? 0 : -2;
+            }
+            else if (strcmp(var, "trajevery") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->trajEvery) == 1 && system->trajEvery > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "energiesevery") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->energiesEvery) == 1 && system->energiesEvery > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "branches") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->branches) == 1 && system->branches > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "branchstep") == 0)
+            {
+                return (sscanf(line, "%*s %*s %ld", &system->branchStep) == 1 && system->branchStep > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "branchcoord") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->branchCoord) == 1 && system->branchCoord >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "branchvel") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->branchVel) == 1 && system->branchVel >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "branchseed") == 0)
+            {
+                return sscanf(line, "%*s %*s %llu", &system->branchSeed) == 1 ? 0 : -2;
+            }
+            else if (strcmp(var, "branchjobs") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->branchJobs) == 1 && system->branchJobs > 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "tstart") == 0)
+            {
+                return (sscanf(line, "%*s %*s %Lf", &system->tStart) == 1 && isfinite(system->tStart)) ? 0 : -2;
+            }
+            else if (strcmp(var, "autotune") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->autotune) == 1 && system->autotune >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "autotunecache") == 0)
+            {
+                if (sscanf(line, "%*s %*s %s", value) != 1 || strlen(value) >= MAX_NAME_LEN)
+                    return -2;
+
+                strcpy(system->autotuneCache, value);
+                return 0;
+            }
+            else if (strcmp(var, "reorder") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->reorderEvery) == 1 && system->reorderEvery >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "compensated") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->compensated) == 1 && system->compensated >= 0) ? 0 : -2;
+            }
+            else if (strcmp(var, "unroll") == 0)
+            {
+                return (sscanf(line, "%*s %*s %d", &system->unroll) == 1 && system->unroll >= 0) ? 0 : -2;
+            }
+
+            sscanf(line, "%*s %*s %Lf", &doubleRead);
+            if (doubleRead <= 0)
+                return -2;
+
+            if (strncmp(var, "G", 1) == 0 && system->G < 0)
+            {
+                system->G = doubleRead;
+                readHeadersCounter++;
+                return 0;
+            }
+            else if (strncmp(var, "dt", 2) == 0 && system->dt < 0)
+            {
+                system->dt = doubleRead;
+                readHeadersCounter++;
+                return 0;
+            }
+
+            // Se si arriva qui allora il valore atteso è un numero intero, quindi si può controllare che sia maggiore di 0
+            // se si fosse fatto prima allora sarebbe potuto essere 0 in caso fosse un double minore di 1 per via di troncamento
+            sscanf(line, "%*s %*s %ld", &intRead);
+
+            if (intRead <= 0)
+                return -2;
+
+            if (strncmp(var, "N", 1) == 0 && system->nBodies < 0)
+            {
+                system->nBodies = intRead;
+                readHeadersCounter++;
+            }
+            else if (strncmp(var, "tdump", 5) == 0 && system->tdump < 0)
+            {
+                system->tdump = intRead;
+                readHeadersCounter++;
+            }
+            else if (strncmp(var, "T", 1) == 0 && system->T < 0)
+            {
+                system->T = intRead;
+                readHeadersCounter++;
+            }
+        }
+        return 0;
+    }
+
+    // controllo che siano stati letti i dati necessari per l'esecuzione del programma
+    if (readHeadersCounter != N_HEADERS)
+    {
+        return -2;
+    }
+
+    int nChar, nTotChar, bodyNumber;
+
+    // I puntatori nella struct sono inizializzati soltanto quando sono NULL, quindi una volta per esecuzione del programma.
+    if (!system->masses)
+    {
+        system->masses = (long double *)malloc(system->nBodies * sizeof(long double));
+    }
+
+    if (!system->coord)
+    {
+        system->coord = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
+    }
+
+    if (!system->vel)
+    {
+        system->vel = (long double *)malloc(system->nBodies * SPATIAL_DIM * sizeof(long double));
+    }
+
+    // i raggi sono facoltativi, quindi quelli non specificati restano a 0
+    if (!system->radii)
+    {
+        system->radii = (long double *)calloc(system->nBodies, sizeof(long double));
+    }
+
+    if (!system->masses || !system->coord || !system->vel || !system->radii)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return -2;
+    }
+
+    // lettura del numero di corpo di cui si stanno leggendo posizioni e velocità di partenza
+    sscanf(line, "%d %n", &bodyNumber, &nTotChar);
+
+    // lettura della massa del corpo specificato da bodyNumber
+    sscanf(line + nTotChar, "%Lf %n", system->masses + (bodyNumber - 1), &nChar);
+    nTotChar += nChar;
+
+    // ciclo per la lettura della posizione di partenza del corpo specificato da bodyNumber
+    for (int i = 0; i < SPATIAL_DIM; i++)
+    {
+        sscanf(line + nTotChar, "%Lf %n", system->coord + i + SPATIAL_DIM * (bodyNumber - 1), &nChar);
+        nTotChar += nChar;
+    }
+
+    // ciclo per la lettura della velocità di partenza del corpo specificato da bodyNumber
+    for (int i = 0; i < SPATIAL_DIM; i++)
+    {
+        sscanf(line + nTotChar, "%Lf %n", system->vel + i + SPATIAL_DIM * (bodyNumber - 1), &nChar);
+        nTotChar += nChar;
+    }
+
+    // lettura del raggio del corpo, se presente come ultima colonna
+    if (sscanf(line + nTotChar, "%Lf", system->radii + (bodyNumber - 1)) == 1 && system->radii[bodyNumber - 1] < 0)
+    {
+        return -2;
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che legge i tempi dell'output denso dal file indicato dall'header dumptimes: un tempo per riga, in ordine crescente e non
+ * negativi. Le righe vuote e quelle che iniziano con '#' vengono ignorate.
+ *
+ * @param path Percorso del file dei tempi.
+ * @param system Puntatore alla struct in cui salvare i tempi (dumpTimes e nDumpTimes).
+ *
+ * @return -2 in caso di errore, 0 di default (come read_input).
+ */
+int read_dump_times(const char *path, PhysicalSystem *system)
+{
+    FILE *timesFile = fopen(path, "r");
+
+    if (!timesFile)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", path);
+        return -2;
+    }
+
+    char line[MAX_LEN];
+    long int capacity = 0;
+    long double t;
+
+    while (fgets(line, MAX_LEN, timesFile))
+    {
+        if (line[0] == '#' || sscanf(line, "%Lf", &t) != 1)
+        {
+            continue;
+        }
+
+        if (t < 0 || (system->nDumpTimes > 0 && t <= system->dumpTimes[system->nDumpTimes - 1]))
+        {
+            fprintf(stderr, "\nI tempi in %s devono essere non negativi e crescenti.\n\n", path);
+            fclose(timesFile);
+            return -2;
+        }
+
+        if (system->nDumpTimes == capacity)
+        {
+            capacity = capacity > 0 ? 2 * capacity : 64;
+            long double *times = (long double *)realloc(system->dumpTimes, capacity * sizeof(long double));
+            if (!times)
+            {
+                fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+                fclose(timesFile);
+                return -2;
+            }
+            system->dumpTimes = times;
+        }
+
+        system->dumpTimes[system->nDumpTimes++] = t;
+    }
+
+    fclose(timesFile);
+
+    // un file senza tempi non richiede alcuna stampa, ma va comunque distinto dall'header assente
+    if (!system->dumpTimes)
+    {
+        fprintf(stderr, "\nIl file %s non contiene tempi.\n\n", path);
+        return -2;
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che legge la lista dei corpi da scrivere nel file delle traiettorie (header bodies): numeri dei corpi e intervalli separati
+ * da virgole, in ordine crescente, ad esempio 1,3,5-8. Gli indici vengono salvati a partire da 0.
+ *
+ * @param list Stringa con la lista.
+ * @param system Puntatore alla struct in cui salvare gli indici (outBodies e nOutBodies).
+ *
+ * @return -2 in caso di errore, 0 di default (come read_input).
+ */
+int parse_body_list(const char *list, PhysicalSystem *system)
+{
+    // il primo passaggio conta i corpi, il secondo li salva
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const char *p = list;
+        int count = 0, last = 0, first, end, nChar;
+
+        while (*p)
+        {
+            if (sscanf(p, "%d%n", &first, &nChar) != 1 || first <= last)
+                return -2;
+            p += nChar;
+
+            end = first;
+            if (*p == '-')
+            {
+                if (sscanf(p + 1, "%d%n", &end, &nChar) != 1 || end < first)
+                    return -2;
+                p += nChar + 1;
+            }
+
+            if (*p == ',')
+                p++;
+            else if (*p != '\0')
+                return -2;
+
+            for (int b = first; b <= end; b++, count++)
+            {
+                if (pass == 1)
+                    system->outBodies[count] = b - 1;
+            }
+            last = end;
+        }
+
+        if (pass == 0)
+        {
+            system->outBodies = count > 0 ? (int *)malloc(count * sizeof(int)) : NULL;
+            if (!system->outBodies)
+                return -2;
+            system->nOutBodies = count;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che, date le posizioni di un numero di corpi specificato in un dato istante, calcola le forze gravitazionali
+ * agenti tra questi nel dato istante.
+ *
+ * @param coord Puntatore al vettore di long double contenente le posizioni dei corpi un corpo alla volta: x11, x12, ..., x21, ...
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi nel sistema.
+ * @param G Costante di gravitazione considerata per il calcolo della forza gravitazionale.
+ * @param nBodies Numero di corpi che compongono il sistema considerato.
+ * @param force Puntatore al vettore di long double in cui salvare la risultante delle forze su ciascun corpo.
+ */
+void grav_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+    long double forceComp, d;
+    long double vec_d[SPATIAL_DIM];
+
+    for (int i = 0; i < SPATIAL_DIM * nBodies; i++)
+    {
+        force[i] = 0.L;
+    }
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            vec_diff((coord + i * SPATIAL_DIM), (coord + j * SPATIAL_DIM), vec_d, SPATIAL_DIM);
             d = dist((coord + i * SPATIAL_DIM), (coord + j * SPATIAL_DIM), SPATIAL_DIM);
 
-            for (int k = 0; k < SPATIAL_DIM; k++)
-            {
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+
+                forceComp = -G * masses[i] * masses[j] * vec_d[k] / pow(d, 3);
+                *(force + k + i * SPATIAL_DIM) += forceComp;
+                *(force + k + j * SPATIAL_DIM) -= forceComp;
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che calcola le stesse forze di grav_force in double, per il passo compensato (vedere compensated_steps). I cicli in double
+ * sono più veloci e vettorizzabili; la precisione dei double basta per le forze, dato che l'arrotondamento che si accumula nei passi
+ * è quello delle somme su posizioni e velocità, compensato a parte.
+ *
+ * @param coord Puntatore al vettore di double contenente le posizioni dei corpi un corpo alla volta: x11, x12, ..., x21, ...
+ * @param masses Puntatore al vettore di double contenente le masse dei corpi nel sistema.
+ * @param G Costante di gravitazione considerata per il calcolo della forza gravitazionale.
+ * @param nBodies Numero di corpi che compongono il sistema considerato.
+ * @param force Puntatore al vettore di double in cui salvare la risultante delle forze su ciascun corpo.
+ */
+void grav_force_double(const double *coord, const double *masses, const double G, const int nBodies, double *force)
+{
+    for (int i = 0; i < SPATIAL_DIM * nBodies; i++)
+    {
+        force[i] = 0.;
+    }
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            double vec_d[SPATIAL_DIM], d2 = 0.;
+
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+                vec_d[k] = coord[k + i * SPATIAL_DIM] - coord[k + j * SPATIAL_DIM];
+                d2 += vec_d[k] * vec_d[k];
+            }
+
+            double scale = -G * masses[i] * masses[j] / (d2 * sqrt(d2));
+
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+                force[k + i * SPATIAL_DIM] += scale * vec_d[k];
+                force[k + j * SPATIAL_DIM] -= scale * vec_d[k];
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che calcola le stesse forze di grav_force, ma scorrendo le coppie di corpi a blocchi di tileBodies corpi (TILE_BODIES se non
+ * scelto dall'autotuning).
+ * Per ogni coppia di blocchi (I, J) con J >= I le coordinate e le masse dei due blocchi restano in cache mentre vengono calcolate tutte
+ * le loro interazioni, e le forze parziali vengono accumulate in due vettori locali sommati a force solo alla fine del blocco.
+ * Così per N grande il vettore coord non viene riletto per intero per ogni corpo i. Come in grav_force ogni coppia viene
+ * calcolata una sola volta (terza legge di Newton).
+ *
+ * @param coord Puntatore al vettore di long double contenente le posizioni dei corpi un corpo alla volta: x11, x12, ..., x21, ...
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi nel sistema.
+ * @param G Costante di gravitazione considerata per il calcolo della forza gravitazionale.
+ * @param nBodies Numero di corpi che compongono il sistema considerato.
+ * @param force Puntatore al vettore di long double in cui salvare la risultante delle forze su ciascun corpo.
+ *
+ * @note Il risultato coincide con quello di grav_force a meno degli arrotondamenti, dato che cambia l'ordine delle somme e la distanza
+ * al cubo viene calcolata come d * d^2 invece che con pow.
+ */
+void grav_force_tiled(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+    // Vettori di dimensione fissa: non crescono con il numero di corpi, quindi nello stack non c'è rischio di overflow.
+    long double forceI[TILE_BODIES * SPATIAL_DIM], forceJ[TILE_BODIES * SPATIAL_DIM];
+
+    for (int i = 0; i < SPATIAL_DIM * nBodies; i++)
+    {
+        force[i] = 0.L;
+    }
+
+    for (int startI = 0; startI < nBodies; startI += tileBodies)
+    {
+        int endI = startI + tileBodies < nBodies ? startI + tileBodies : nBodies;
+
+        for (int startJ = startI; startJ < nBodies; startJ += tileBodies)
+        {
+            int endJ = startJ + tileBodies < nBodies ? startJ + tileBodies : nBodies;
+
+            for (int k = 0; k < tileBodies * SPATIAL_DIM; k++)
+            {
+                forceI[k] = 0.L;
+                forceJ[k] = 0.L;
+            }
+
+            for (int i = startI; i < endI; i++)
+            {
+                const long double *ci = coord + i * SPATIAL_DIM;
+                long double *fi = forceI + (i - startI) * SPATIAL_DIM;
+                long double Gmi = G * masses[i];
+
+                // nel blocco diagonale si considerano solo le coppie con j > i
+                for (int j = (startJ == startI ? i + 1 : startJ); j < endJ; j++)
+                {
+                    const long double *cj = coord + j * SPATIAL_DIM;
+                    long double *fj = forceJ + (j - startJ) * SPATIAL_DIM;
+                    long double vec_d[SPATIAL_DIM], d2 = 0.L;
+
+                    for (int k = 0; k < SPATIAL_DIM; k++)
+                    {
+                        vec_d[k] = ci[k] - cj[k];
+                        d2 += vec_d[k] * vec_d[k];
+                    }
+
+                    long double factor = -Gmi * masses[j] / (d2 * sqrtl(d2));
+
+                    for (int k = 0; k < SPATIAL_DIM; k++)
+                    {
+                        fi[k] += factor * vec_d[k];
+                        fj[k] -= factor * vec_d[k];
+                    }
+                }
+            }
+
+            for (int k = 0; k < (endI - startI) * SPATIAL_DIM; k++)
+            {
+                force[startI * SPATIAL_DIM + k] += forceI[k];
+            }
+            for (int k = 0; k < (endJ - startJ) * SPATIAL_DIM; k++)
+            {
+                force[startJ * SPATIAL_DIM + k] += forceJ[k];
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che calcola le stesse forze di grav_force, ma corpo per corpo: la forza su ogni corpo i viene accumulata con i contributi di
+ * tutti gli altri corpi. Ogni coppia viene calcolata due volte, ma i corpi sono indipendenti e vengono divisi tra i thread OpenMP
+ * senza somme tra thread diversi, quindi con molti corpi e più processori può essere più veloce delle varianti che sfruttano la terza
+ * legge di Newton.
+ *
+ * @param coord Puntatore al vettore di long double contenente le posizioni dei corpi un corpo alla volta: x11, x12, ..., x21, ...
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi nel sistema.
+ * @param G Costante di gravitazione considerata per il calcolo della forza gravitazionale.
+ * @param nBodies Numero di corpi che compongono il sistema considerato.
+ * @param force Puntatore al vettore di long double in cui salvare la risultante delle forze su ciascun corpo.
+ */
+void grav_force_full(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+#pragma omp parallel for if (omp_get_max_threads() > 1) schedule(static)
+    for (int i = 0; i < nBodies; i++)
+    {
+        const long double *ci = coord + i * SPATIAL_DIM;
+        long double fi[SPATIAL_DIM] = {0.L};
+        long double Gmi = G * masses[i];
+
+        for (int j = 0; j < nBodies; j++)
+        {
+            const long double *cj = coord + j * SPATIAL_DIM;
+            long double vec_d[SPATIAL_DIM], d2 = 0.L;
+
+            if (j == i)
+            {
+                continue;
+            }
+
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+                vec_d[k] = ci[k] - cj[k];
+                d2 += vec_d[k] * vec_d[k];
+            }
+
+            long double factor = -Gmi * masses[j] / (d2 * sqrtl(d2));
+
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+                fi[k] += factor * vec_d[k];
+            }
+        }
+
+        for (int k = 0; k < SPATIAL_DIM; k++)
+        {
+            force[k + i * SPATIAL_DIM] = fi[k];
+        }
+    }
+}
+
+/**
+ * Funzione che calcola l'energia cinetica del sistema di un numero di corpi pari a nBodies.
+ *
+ * @param vel Puntatore al vettore di long double contenente le velocità dei corpi.
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi.
+ * @param nBodies Numero intero del numero di corpi del sistema.
+ *
+ * @return Valore long double dell'energia cinetica.
+ */
+
+long double Ekin(const long double *vel, const long double *masses, const int nBodies)
+{
+    long double kinEnergyTot = 0.L;
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        kinEnergyTot += 0.5L * masses[i] * scal(vel + SPATIAL_DIM * i, vel + SPATIAL_DIM * i, SPATIAL_DIM);
+    }
+
+    return kinEnergyTot;
+}
+
+/**
+ * Funzione che calcola l'energia potenziale del sistema di un numero di corpi pari a nBodies.
+ *
+ * @param coord Puntatore al vettore di long double contenente le coordinate spaziali dei corpi.
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi.
+ * @param G costante di gravitazione considerata.
+ * @param nBodies Numero intero del numero di corpi del sistema.
+ *
+ * @return Valore long double dell'energia potenziale
+ */
+long double Epot(const long double *coord, const long double *masses, const long double G, const int nBodies)
+{
+    long double potEnergyTot = 0.L;
+    for (int i = 0; i < nBodies; i++)
+    {
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            long double distance = dist(coord + j * SPATIAL_DIM, coord + i * SPATIAL_DIM, SPATIAL_DIM);
+            potEnergyTot += -G * masses[i] * masses[j] / distance;
+        }
+    }
+
+    return potEnergyTot;
+}
+
+/**
+ * Funzione che stampa l'header per i file di output.
+ *
+ * @param outFile Puntatore al file di output.
+ * @param system Puntatore alla struct contenente le variabili relative al sistema.
+ * @param format Stringa indicante il tipo di format scelto ("system" o "energies" a seconda che si vogliano stampare la traiettoria
+ * del sistema o le energie del sistema).
+ */
+void print_header(FILE *outFile, const PhysicalSystem *system, char *format)
+{
+#ifdef FUNNY
+    char *quotes[N_QUOTES] =
+        {"Above all, don't fear difficult moments. The best comes from them.  (Rita Levi-Montalcini)",
+         "In physics, you don't have to go around making trouble for yourself. Nature does it for you.  (Frank Wilczek)",
+         "If you thought that science was certain - well, that is just an error on your part.  (Richard P. Feynman)",
+         "In science there is only physics; all the rest is stamp collecting.  (Lord Kelvin)",
+         "Nothing happens until something moves.  (Albert Einstein)",
+         "Not only is the Universe stranger than we think, it is stranger than we can think.  (Werner Heisenberg)",
+         "Physics is the only profession in which prophecy is not only accurate but routine.  (Neil deGrasse Tyson)"};
+
+    int r = rand() % N_QUOTES;
+
+    fprintf(outFile, "#%s\n", quotes[r]);
+#endif
+
+    // il file delle traiettorie contiene solo i corpi selezionati con l'header bodies, di cui si scrivono numeri e masse
+    int isSystem = strncmp(format, "system", 6) == 0, nOut = isSystem && system->outBodies ? system->nOutBodies : system->nBodies;
+
+    fprintf(outFile, "#HDR N\t%d\n", nOut);
+    fprintf(outFile, "#HDR G\t%Lf\n", system->G);
+    if (isSystem && system->outBodies)
+    {
+        fprintf(outFile, "#HDR bodies\t");
+        for (int i = 0; i < nOut; i++)
+        {
+            fprintf(outFile, "%d ", system->outBodies[i] + 1);
+        }
+        fprintf(outFile, "\n");
+    }
+    fprintf(outFile, "#HDR m\t");
+    for (int i = 0; i < nOut; i++)
+    {
+        fprintf(outFile, "%Lf ", system->masses[body_slot(system, isSystem && system->outBodies ? system->outBodies[i] : i)]);
+    }
+    fprintf(outFile, "\n");
+
+    // controlli che scrivono il format dei dati nel file
+    fprintf(outFile, "#format:\t ");
+    if (isSystem)
+    {
+        const char *names[] = {"coords", "velocities", "accelerations"}, symbols[] = {'x', 'v', 'a'};
+
+        fprintf(outFile, "time");
+        for (int f = 0; f < 3; f++)
+        {
+            if (!(system->outFields & (1 << f)))
+            {
+                continue;
+            }
+
+            fprintf(outFile, "\t %s: (", names[f]);
+            for (int i = 0; i < SPATIAL_DIM; i++)
+            {
+                fprintf(outFile, " %c%d", symbols[f], i);
+            }
+            fprintf(outFile, ")");
+        }
+        fprintf(outFile, "\n");
+    }
+    else if (strncmp(format, "energies", 8) == 0)
+    {
+        fprintf(outFile, "kinetic energy\t potential energy\t total energy\n");
+    }
+    else
+    {
+        fprintf(stderr, "\nFormato specificato non supportato. La riga di formato verrà lasciata vuota.\n\n");
+    }
+}
+
+/**
+ * Funzione che aggiunge al blocco di testo chunk il valore x scritto come con "%*.*Lf" seguito dal carattere sep.
+ * Il valore viene formattato con format_fixed, molto più veloce di fprintf; quando il blocco è quasi pieno viene passato al file
+ * con un solo fwrite. I valori non gestiti da format_fixed vengono scritti con fprintf dopo aver svuotato il blocco.
+ *
+ * @param outFile Puntatore al file di output.
+ * @param chunk Puntatore al blocco di OUTPUT_CHUNK caratteri.
+ * @param used Puntatore al numero di caratteri già presenti nel blocco, viene aggiornato dalla funzione.
+ * @param x Valore da scrivere.
+ * @param width Larghezza minima del campo.
+ * @param precision Numero di cifre decimali.
+ * @param sep Carattere da scrivere dopo il valore.
+ */
+void write_value(FILE *outFile, char *chunk, int *used, const long double x, const int width, const int precision, const char sep)
+{
+    if (*used > OUTPUT_CHUNK - FORMAT_MAX_LEN - 1)
+    {
+        fwrite(chunk, 1, *used, outFile);
+        *used = 0;
+    }
+
+    int n = format_fixed(chunk + *used, x, width, precision);
+
+    if (n < 0)
+    {
+        fwrite(chunk, 1, *used, outFile);
+        *used = 0;
+        fprintf(outFile, "%*.*Lf%c", width, precision, x, sep);
+        return;
+    }
+
+    *used += n;
+    chunk[(*used)++] = sep;
+}
+
+/**
+ * Funzione che date le condizioni del sistema in un dato istante, stampa il tempo fisico, le posizioni, le velocità e le accelerazioni
+ * del dato istante nel file specificato in outFile, limitandosi ai corpi e ai campi selezionati con gli header bodies e fields.
+ * Il formato è quello di fprintf con "%Lf " per il tempo e "%.16Lf " per ogni componente, ma i valori vengono scritti con write_value.
+ *
+ * @param outFile Puntatore al file in cui stampare posizioni, velocità e accelerazioni del sistema.
+ * @param system Puntatore alla struct contenente tutte le variabili in gioco nel sistema.
+ * @param time Tempo fisico dell'istante stampato.
+ */
+void print_system(FILE *outFile, const PhysicalSystem *system, const long double time)
+{
+    char chunk[OUTPUT_CHUNK];
+    int used = 0;
+
+    const long double *fields[] = {system->coord, system->vel, system->acc};
+    int nOut = system->outBodies ? system->nOutBodies : system->nBodies;
+
+    write_value(outFile, chunk, &used, time, 0, 6, ' ');
+
+    for (int f = 0; f < 3; f++)
+    {
+        if (!(system->outFields & (1 << f)))
+        {
+            continue;
+        }
+
+        for (int b = 0; b < nOut; b++)
+        {
+            const long double *x = fields[f] + SPATIAL_DIM * body_slot(system, system->outBodies ? system->outBodies[b] : b);
+
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+                write_value(outFile, chunk, &used, x[k], 0, 16, ' ');
+            }
+        }
+    }
+
+    chunk[used++] = '\n';
+    fwrite(chunk, 1, used, outFile);
+}
+
+/**
+ * Funzione che, date le condizioni del sistema in un dato istante, calcola energia cinetica e potenziale nel dato istante
+ * con le funzioni adatte al motore di forza scelto.
+ *
+ * @param system Puntatore alla struct contenente tutte le variabili in gioco nel sistema.
+ * @param kEnergy Puntatore in cui salvare l'energia cinetica.
+ * @param potEnergy Puntatore in cui salvare l'energia potenziale.
+ */
+void system_energies(const PhysicalSystem *system, long double *kEnergy, long double *potEnergy)
+{
+    // Nel problema ristretto i traccianti non hanno energia propria: si stampa quella dei soli corpi massivi (i primi nMassive),
+    // che è conservata. Senza traccianti nMassive coincide con nBodies.
+    if (system->reproducible && (system->engine == ENGINE_DIRECT || system->engine == ENGINE_TILED))
+    {
+        *kEnergy = repro_ekin(system->vel, system->masses, system->nMassive);
+        *potEnergy = repro_epot(system->coord, system->masses, system->G, system->nMassive);
+        return;
+    }
+
+    *kEnergy = Ekin(system->vel, system->masses, system->nMassive);
+    // l'energia potenziale deve essere consistente con le forze: ammorbidita con il softening, periodica con i motori particle-mesh
+    if (system->softening != SOFTENING_NONE)
+    {
+        *potEnergy = softening_epot(system->coord, system->masses, system->G, system->nBodies);
+    }
+    else if (system->engine == ENGINE_FMM)
+    {
+        *potEnergy = fmm_epot(system->coord, system->masses, system->G, system->nBodies);
+    }
+    else if (system->engine == ENGINE_DIRECT || system->engine == ENGINE_TILED)
+    {
+        *potEnergy = Epot(system->coord, system->masses, system->G, system->nMassive);
+    }
+    else
+    {
+        *potEnergy = pm_epot(system->coord, system->masses, system->G, system->nBodies);
+    }
+}
+
+/**
+ * Funzione che stampa energia cinetica, potenziale e totale del sistema in un dato istante nel file specificato in outFile.
+ *
+ * @param outFile Puntatore al file in cui stampare energia cinetica, potenziale e totale del sistema in un dato istante.
+ * @param kEnergy Energia cinetica del sistema.
+ * @param potEnergy Energia potenziale del sistema.
+ */
+void print_energies(FILE *outFile, const long double kEnergy, const long double potEnergy)
+{
+    long double totEnergy = kEnergy + potEnergy;
+
+    // stesso formato di "%16.9Lf %16.9Lf %16.9Lf\n"
+    char chunk[OUTPUT_CHUNK];
+    int used = 0;
+
+    write_value(outFile, chunk, &used, kEnergy, 16, 9, ' ');
+    write_value(outFile, chunk, &used, potEnergy, 16, 9, ' ');
+    write_value(outFile, chunk, &used, totEnergy, 16, 9, '\n');
+    fwrite(chunk, 1, used, outFile);
+}
+
+/**
+ * Funzione che scrive lo stato del sistema in un dato istante in tutte le destinazioni dell'output: traiettorie (testo o formato a
+ * blocchi) una stampa ogni trajEvery, energie una stampa ogni energiesEvery e memoria condivisa a ogni stampa. Le energie vengono
+ * calcolate una sola volta, e solo se qualcuno le usa: il file delle energie, la memoria condivisa o il controllo della deriva, a cui
+ * vengono restituite.
+ *
+ * @param outputs Puntatore alla struct con le destinazioni dell'output.
+ * @param system Puntatore alla struct con lo stato da scrivere (accelerazioni comprese, almeno per i corpi selezionati se servono).
+ * @param time Tempo fisico dello stato.
+ * @param dumpIndex Indice della stampa (da 0), confrontato con le cadenze trajEvery ed energiesEvery.
+ * @param energies Puntatore al vettore di SHMSTREAM_ENERGIES elementi in cui salvare energia cinetica, potenziale e totale.
+ *
+ * @return -1 in caso di errore, 1 se le energie sono state calcolate, 0 altrimenti.
+ */
+int write_dump(OutputFiles *outputs, const PhysicalSystem *system, const long double time, const long int dumpIndex,
+               long double *energies)
+{
+    int trajDue = dumpIndex % system->trajEvery == 0, energiesDue = dumpIndex % system->energiesEvery == 0;
+    int needEnergies = energiesDue || outputs->shm || system->watchdogTol > 0;
+
+    if (needEnergies)
+    {
+        system_energies(system, energies, energies + 1);
+        energies[2] = energies[0] + energies[1];
+    }
+
+    if (outputs->trajStore && trajDue)
+    {
+        const long double *fields[] = {system->coord, system->vel, system->acc};
+        int nOut = system->outBodies ? system->nOutBodies : system->nBodies, n = nOut * SPATIAL_DIM;
+
+        // corpi e campi selezionati vengono raccolti in trajBuffer, con zeri al posto dei campi non selezionati
+        for (int f = 0; f < 3 && outputs->trajBuffer; f++)
+        {
+            for (int b = 0; b < nOut; b++)
+            {
+                const long double *x = fields[f] + SPATIAL_DIM * body_slot(system, system->outBodies ? system->outBodies[b] : b);
+
+                for (int k = 0; k < SPATIAL_DIM; k++)
+                {
+                    outputs->trajBuffer[k + SPATIAL_DIM * b + f * n] = (system->outFields & (1 << f)) ? x[k] : 0.L;
+                }
+            }
+        }
+
+        if (outputs->trajBuffer)
+        {
+            fields[0] = outputs->trajBuffer;
+            fields[1] = outputs->trajBuffer + n;
+            fields[2] = outputs->trajBuffer + 2 * n;
+        }
+
+        if (trajstore_write(outputs->trajStore, time, fields[0], fields[1], fields[2]) == -1)
+        {
+            return -1;
+        }
+    }
+    else if (outputs->system && trajDue)
+    {
+        print_system(outputs->system, system, time);
+    }
+
+    if (energiesDue)
+    {
+        print_energies(outputs->energies, energies[0], energies[1]);
+    }
+
+    if (outputs->shm)
+    {
+        shmstream_publish(outputs->shm, time, system->coord, system->vel, system->acc, energies);
+    }
+
+    return needEnergies;
+}
+
+/**
+ * Funzione che restituisce il k-esimo tempo dell'output denso: k * dumpDt con una cadenza fissa, altrimenti il k-esimo tempo letto
+ * dal file dell'header dumptimes.
+ *
+ * @param system Puntatore alla struct contenente dumpDt o i tempi letti.
+ * @param k Indice del tempo (da 0).
+ *
+ * @return Il tempo richiesto, oppure -1 se i tempi letti sono finiti.
+ */
+long double dump_time(const PhysicalSystem *system, const long int k)
+{
+    if (system->dumpDt > 0)
+    {
+        return (long double)k * system->dumpDt;
+    }
+
+    return k < system->nDumpTimes ? system->dumpTimes[k] : -1.L;
+}
+
+/**
+ * Funzione che restituisce i byte scritti fino a questo momento nei file di output delle traiettorie, delle energie e della
+ * diagnostica (compresi quelli ancora nei buffer).
+ *
+ * @param outputs Puntatore alla struct con le destinazioni dell'output.
+ */
+long int output_bytes(const OutputFiles *outputs)
+{
+    long int bytes = ftell(outputs->energies);
+
+    if (outputs->system)
+    {
+        bytes += ftell(outputs->system);
+    }
+    if (outputs->trajStore)
+    {
+        bytes += ftell(outputs->trajStore->file);
+    }
+    if (outputs->diagnostics)
+    {
+        bytes += ftell(outputs->diagnostics->file);
+    }
+
+    return bytes;
+}
+
+/**
+ * Funzione che restituisce il numero di interazioni tra coppie di corpi calcolate in un passo, come se le forze fossero calcolate con
+ * la somma diretta. Con i traccianti si contano le coppie di corpi massivi e quelle tra traccianti e corpi massivi.
+ *
+ * @param system Puntatore alla struct contenente il sistema.
+ */
+long double pairs_per_step(const PhysicalSystem *system)
+{
+    long double pairs = system->nMassive * (system->nMassive - 1.L) / 2.L +
+                        (long double)(system->nBodies - system->nMassive) * system->nMassive;
+
+    return system->integrator == INTEGRATOR_YOSHIDA4 ? 3.L * pairs : pairs;
+}
+
+/**
+ * Funzione che restituisce la posizione del k-esimo tempo dell'output denso in passi di integrazione (dump_time / dt). Se il tempo
+ * dista dalla fine di un passo meno degli errori di arrotondamento, la posizione viene arrotondata a quel passo, in modo che venga
+ * stampato lo stato integrato senza interpolazione.
+ *
+ * @param system Puntatore alla struct contenente dt, dumpDt o i tempi letti.
+ * @param k Indice del tempo (da 0).
+ *
+ * @return La posizione del tempo richiesto, oppure -1 se i tempi letti sono finiti.
+ */
+long double dump_position(const PhysicalSystem *system, const long int k)
+{
+    long double t = dump_time(system, k);
+
+    if (t < 0)
+    {
+        return -1.L;
+    }
+
+    long double pos = t / system->dt, nearest = roundl(pos);
+
+    return fabsl(pos - nearest) <= 1e-12L * (1.L + nearest) ? nearest : pos;
+}
+
+/**
+ * Funzione che libera tutti i puntatori della struct PhysicalSystem passata in input e poi il puntatore alla struct stessa.
+ *
+ * @param system Puntatore alla struct PhysicalSystem da liberare.
+ */
+void free_struct_pointers(PhysicalSystem *system)
+{
+    free(system->masses);
+    free(system->coord);
+    free(system->vel);
+    free(system->acc);
+    free(system->radii);
+    free(system->dumpTimes);
+    free(system->outBodies);
+    free(system->bodySlot);
+    free(system->bodyOrder);
+    free(system);
+
+    // non fanno nulla se i motori particle-mesh e FMM, gli esponenti di Lyapunov, il parareal, le somme riproducibili, le collisioni,
+    // le metriche, il passo compensato o i riordinamenti non sono stati inizializzati
+    pm_free();
+    fmm_free();
+    lyapunov_free();
+    parareal_free();
+    repro_free();
+    collisions_free();
+    metrics_free();
+    compensated_free();
+    sfc_free();
+}
+
+/**
+ * Funzione che chiude le destinazioni dell'output aperte (quelle non aperte sono NULL). Per il formato a blocchi scrive anche l'indice
+ * dei frame.
+ *
+ * @param outputs Puntatore alla struct con le destinazioni dell'output.
+ *
+ * @return -1 se la scrittura dell'indice del file a blocchi è fallita, 0 di default.
+ */
+int close_outputs(OutputFiles *outputs)
+{
+    // "Chiudere" un puntatore null è undefined behaviour, per questo ci sono questi controlli
+    if (outputs->system)
+    {
+        fclose(outputs->system);
+    }
+    if (outputs->energies)
+    {
+        fclose(outputs->energies);
+    }
+
+    shmstream_close(outputs->shm);
+    events_free(outputs->events);
+    diagnostics_free(outputs->diagnostics);
+    free(outputs->trajBuffer);
+
+    return trajstore_close(outputs->trajStore);
+}
+
+/**
+ * Funzione che stampa su stdout un frame di un file di traiettoria a blocchi, nello stesso formato delle righe di traj.dat
+ * (ma con il tempo fisico al posto del numero della riga).
+ *
+ * @param option "--frame" per cercare il frame per numero (a partire da 0), "--time" per cercare l'ultimo frame con tempo non
+ * superiore a quello indicato.
+ * @param path Percorso del file di traiettoria a blocchi.
+ * @param value Stringa con il numero del frame o il tempo.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int print_stored_frame(const char *option, const char *path, const char *value)
+{
+    TrajReader *reader = trajreader_open(path);
+    if (!reader)
+    {
+        return -1;
+    }
+
+    long int frame = strcmp(option, "--frame") == 0 ? strtol(value, NULL, 10) : trajreader_find_time(reader, strtod(value, NULL));
+    long int nValues = (long int)reader->nBodies * reader->spatialDim;
+    long double *values = (long double *)malloc(3 * nValues * sizeof(long double));
+    long double t;
+
+    if (!values || trajreader_frame(reader, frame, &t, values, values + nValues, values + 2 * nValues) == -1)
+    {
+        fprintf(stderr, "\nFrame non presente nel file %s.\n\n", path);
+        free(values);
+        trajreader_close(reader);
+        return -1;
+    }
+
+    printf("%Lf ", t);
+    for (long int i = 0; i < 3 * nValues; i++)
+    {
+        printf("%.16Lf ", values[i]);
+    }
+    printf("\n");
+
+    free(values);
+    trajreader_close(reader);
+
+    return 0;
+}
+
+/**
+ * Funzione che salva lo stato del sistema dopo stepsDone passi come file di input, da cui si può riprendere la simulazione per i passi
+ * rimanenti. Vengono scritti gli header obbligatori, quelli opzionali che cambiano la dinamica (motore di forza, integratore, traccianti,
+ * collisioni e softening) e i corpi (con il raggio se le collisioni sono attive) con 21 cifre significative, sufficienti a rileggere esattamente i long double. Tempo raggiunto e dt suggerito sono scritti come commenti.
+ *
+ * @param path Percorso del file da scrivere.
+ * @param system Puntatore alla struct contenente lo stato del sistema.
+ * @param stepsDone Numero di passi di integrazione già eseguiti.
+ * @param suggestedDt dt suggerito per riprendere la simulazione (ignorato se <= 0).
+ * @param headersFrom Percorso del file di input di cui copiare gli header opzionali, esclusi quelli dei rami (NULL per non copiarli).
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int write_checkpoint(const char *path, const PhysicalSystem *system, const long int stepsDone, const long double suggestedDt,
+                     const char *headersFrom)
+{
+    FILE *outFile = fopen(path, "w");
+
+    if (!outFile)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file: %s\n\n", path);
+        return -1;
+    }
+
+    // la simulazione ripresa esegue i passi rimanenti e il suo tempo continua da quello raggiunto (header tstart)
+    long int remaining = system->T - stepsDone > 0 ? system->T - stepsDone : system->tdump;
+    long double reached = system->tStart + stepsDone * system->dt;
+
+    fprintf(outFile, "# checkpoint at time %.21Le (step %ld of %ld)\n", reached, stepsDone, system->T);
+    if (suggestedDt > 0)
+    {
+        fprintf(outFile, "# suggested dt %.6Le\n", suggestedDt);
+    }
+
+    fprintf(outFile, "#HDR N %d\n", system->nBodies);
+    fprintf(outFile, "#HDR G %.21Le\n", system->G);
+    fprintf(outFile, "#HDR dt %.21Le\n", system->dt);
+    fprintf(outFile, "#HDR tdump %d\n", system->tdump);
+    fprintf(outFile, "#HDR T %ld\n", remaining);
+    if (reached != 0)
+    {
+        fprintf(outFile, "#HDR tstart %.21Le\n", reached);
+    }
+
+    if (system->engine != ENGINE_DIRECT)
+    {
+        const char *engines[] = {"direct", "pm", "p3m", "tiled", "fmm"};
+        fprintf(outFile, "#HDR engine %s\n", engines[system->engine]);
+    }
+    if (system->engine == ENGINE_FMM)
+    {
+        fprintf(outFile, "#HDR fmmorder %d\n#HDR fmmtheta %.21Le\n", system->fmmOrder, system->fmmTheta);
+    }
+    if (system->engine == ENGINE_PM || system->engine == ENGINE_P3M)
+    {
+        fprintf(outFile, "#HDR box %.21Le\n#HDR mesh %d\n#HDR rsplit %.21Le\n", system->box, system->mesh, system->rsplit);
+    }
+    if (system->nMassive < system->nBodies)
+    {
+        fprintf(outFile, "#HDR Nmassive %d\n", system->nMassive);
+    }
+    if (!system->unroll)
+    {
+        fprintf(outFile, "#HDR unroll 0\n");
+    }
+    if (system->collisions != COLLISIONS_NONE)
+    {
+        fprintf(outFile, "#HDR collisions %s\n", system->collisions == COLLISIONS_MERGE ? "merge" : "bounce");
+    }
+    if (system->integrator == INTEGRATOR_YOSHIDA4)
+    {
+        fprintf(outFile, "#HDR integrator yoshida4\n");
+    }
+    if (system->compensated)
+    {
+        fprintf(outFile, "#HDR compensated 1\n");
+    }
+    if (system->softening != SOFTENING_NONE)
+    {
+        fprintf(outFile, "#HDR softening %s\n#HDR softlength %.21Le\n", system->softening == SOFTENING_PLUMMER ? "plummer" : "spline",
+                system->softLength);
+    }
+
+    // gli header copiati vengono dopo quelli scritti qui sopra, che hanno gli stessi valori, mentre quelli obbligatori vanno saltati
+    FILE *headersFile = headersFrom ? fopen(headersFrom, "r") : NULL;
+    char line[MAX_LEN], var[MAX_LEN];
+    while (headersFile && fgets(line, MAX_LEN, headersFile))
+    {
+        if (strncmp(line, "#HDR", 4) != 0 || sscanf(line, "%*s %s", var) != 1 || strcmp(var, "N") == 0 || strcmp(var, "G") == 0 ||
+            strcmp(var, "dt") == 0 || strcmp(var, "tdump") == 0 || strcmp(var, "T") == 0 || strcmp(var, "tstart") == 0 ||
+            strncmp(var, "branch", 6) == 0)
+        {
+            continue;
+        }
+        fputs(line, outFile);
+    }
+    if (headersFile)
+    {
+        fclose(headersFile);
+    }
 
-                forceComp = -G * masses[i] * masses[j] * vec_d[k] / pow(d, 3);
-                *(force + k + i * SPATIAL_DIM) += forceComp;
-                *(force + k + j * SPATIAL_DIM) -= forceComp;
-            }
+    fprintf(outFile, "#idx m");
+    for (int k = 0; k < SPATIAL_DIM; k++)
+    {
+        fprintf(outFile, " x%d", k);
+    }
+    for (int k = 0; k < SPATIAL_DIM; k++)
+    {
+        fprintf(outFile, " v%d", k);
+    }
+    fprintf(outFile, system->collisions != COLLISIONS_NONE ? " r\n" : "\n");
+
+    // i corpi vengono scritti nell'ordine del file di input anche dopo i riordinamenti
+    for (int b = 0; b < system->nBodies; b++)
+    {
+        int j = body_slot(system, b);
+
+        fprintf(outFile, "%d %.21Le", b + 1, system->masses[j]);
+        for (int k = 0; k < SPATIAL_DIM; k++)
+        {
+            fprintf(outFile, " %.21Le", system->coord[k + SPATIAL_DIM * j]);
+        }
+        for (int k = 0; k < SPATIAL_DIM; k++)
+        {
+            fprintf(outFile, " %.21Le", system->vel[k + SPATIAL_DIM * j]);
+        }
+        // i raggi cambiano con le fusioni, quindi si scrivono esplicitamente invece dell'header density
+        if (system->collisions != COLLISIONS_NONE)
+        {
+            fprintf(outFile, " %.21Le", system->radii[j]);
         }
+        fprintf(outFile, "\n");
     }
+
+    return fclose(outFile) == 0 ? 0 : -1;
 }
 
 /**
- * Funzione che calcola l'energia cinetica del sistema di un numero di corpi pari a nBodies.
+ * Funzione che prepara i rami di un insieme a partire dallo stato al passo branchStep: per ogni ramo k crea la cartella
+ * BRANCH_DIR_FORMAT e vi scrive come checkpoint (con gli header opzionali del file di input) lo stato con ogni componente di posizioni e
+ * velocità perturbato da un numero uniforme in [-branchCoord, branchCoord) e [-branchVel, branchVel), estratto con il seme
+ * branchSeed + k. Posizioni e velocità del sistema vengono ripristinate alla fine.
  *
- * @param vel Puntatore al vettore di long double contenente le velocità dei corpi.
- * @param masses Puntatore al vettore di long double contenente le masse dei corpi.
- * @param nBodies Numero intero del numero di corpi del sistema.
+ * @param system Puntatore alla struct contenente lo stato del sistema al passo branchStep.
+ * @param inPath Percorso del file di input della simulazione.
  *
- * @return Valore long double dell'energia cinetica.
+ * @return -1 in caso di errore, 0 di default.
  */
-
-long double Ekin(const long double *vel, const long double *masses, const int nBodies)
+int write_branches(PhysicalSystem *system, const char *inPath)
 {
-    long double kinEnergyTot = 0.L;
+    int n = system->nBodies * SPATIAL_DIM;
+    long double *saved = (long double *)malloc(2 * n * sizeof(long double));
 
-    for (int i = 0; i < nBodies; i++)
+    if (!saved)
     {
-        kinEnergyTot += 0.5L * masses[i] * scal(vel + SPATIAL_DIM * i, vel + SPATIAL_DIM * i, SPATIAL_DIM);
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return -1;
     }
+    memcpy(saved, system->coord, n * sizeof(long double));
+    memcpy(saved + n, system->vel, n * sizeof(long double));
 
-    return kinEnergyTot;
+    int resultCode = 0;
+    for (int k = 0; k < system->branches && resultCode == 0; k++)
+    {
+        unsigned long long rng = (system->branchSeed + k) ^ 0x9E3779B97F4A7C15ULL;
+
+        // le componenti vengono perturbate nell'ordine del file di input, così ogni ramo non dipende dai riordinamenti
+        for (int b = 0; b < system->nBodies; b++)
+        {
+            for (int k = 0; k < SPATIAL_DIM; k++)
+            {
+                int i = k + SPATIAL_DIM * body_slot(system, b);
+                system->coord[i] = saved[i] + system->branchCoord * (2.L * uniform_random(&rng) - 1.L);
+                system->vel[i] = saved[n + i] + system->branchVel * (2.L * uniform_random(&rng) - 1.L);
+            }
+        }
+
+        char dir[FILENAME_MAX], path[FILENAME_MAX + sizeof(BRANCH_INPUT) + 1];
+        resultCode = branch_dir(k, dir);
+        if (resultCode == 0)
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, BRANCH_INPUT);
+            resultCode = write_checkpoint(path, system, system->branchStep, -1.L, inPath);
+        }
+    }
+
+    memcpy(system->coord, saved, n * sizeof(long double));
+    memcpy(system->vel, saved + n, n * sizeof(long double));
+    free(saved);
+
+    return resultCode;
 }
 
 /**
- * Funzione che calcola l'energia potenziale del sistema di un numero di corpi pari a nBodies.
+ * Funzione che misura il costo e l'accuratezza dei diversi integratori al variare di dt, per scegliere la configurazione più economica
+ * che raggiunge l'accuratezza richiesta. Per ogni integratore (Velocity Verlet, con i passi specializzati se disponibili, e Yoshida del
+ * quarto ordine) e per BENCH_POINTS valori di dt in progressione geometrica da dtMax a dtMin, il sistema viene integrato dallo stato
+ * iniziale fino al tempo fisico T * dt del file di input (dt viene ritoccato perché il numero di passi sia intero). Vengono misurati il
+ * tempo di calcolo dei soli passi, le valutazioni della forza e l'errore relativo massimo sull'energia totale, controllata BENCH_CHECKS
+ * volte per prova. La tabella viene stampata su stdout; una prova che diverge viene interrotta e ha errore inf o nan.
  *
- * @param coord Puntatore al vettore di long double contenente le coordinate spaziali dei corpi.
- * @param masses Puntatore al vettore di long double contenente le masse dei corpi.
- * @param G costante di gravitazione considerata.
- * @param nBodies Numero intero del numero di corpi del sistema.
+ * @param system Puntatore alla struct con il sistema letto dal file di input (lo stato viene ripristinato alla fine).
+ * @param name Nome del file di input, riportato nella tabella.
+ * @param forceFunction Funzione della forza scelta per il sistema.
+ * @param smallStep Passo specializzato di Velocity Verlet per il sistema (NULL se non disponibile).
+ * @param dtMin Valore minimo di dt.
+ * @param dtMax Valore massimo di dt.
+ * @param target Errore relativo massimo richiesto: se positivo viene indicata la prova più veloce che lo rispetta.
  *
- * @return Valore long double dell'energia potenziale
+ * @return -1 in caso di errore, 0 di default.
  */
-long double Epot(const long double *coord, const long double *masses, const long double G, const int nBodies)
+int run_benchmark(PhysicalSystem *system, const char *name,
+                  void (*forceFunction)(const long double *, const long double *, const long double, const int, long double *),
+                  SmallNStep smallStep, const long double dtMin, const long double dtMax, const long double target)
 {
-    long double potEnergyTot = 0.L;
-    for (int i = 0; i < nBodies; i++)
+    if (system->lyapVectors > 0 || system->pararealSlices > 0 || system->collisions != COLLISIONS_NONE)
     {
-        for (int j = i + 1; j < nBodies; j++)
+        fprintf(stderr, "\nIl banco di prova non supporta esponenti di Lyapunov, parareal e collisioni.\n\n");
+        return -1;
+    }
+
+    int n = system->nBodies * SPATIAL_DIM;
+    long double *coord0 = (long double *)malloc(n * sizeof(long double));
+    long double *vel0 = (long double *)malloc(n * sizeof(long double));
+    long double *force = (long double *)malloc(n * sizeof(long double));
+
+    if (!coord0 || !vel0 || !force)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        free(coord0);
+        free(vel0);
+        free(force);
+        return -1;
+    }
+
+    memcpy(coord0, system->coord, n * sizeof(long double));
+    memcpy(vel0, system->vel, n * sizeof(long double));
+
+    const char *names[] = {"verlet", "yoshida4"};
+    int (*stepFunctions[])(const long double, const long double, const int, const int, const long double *, long double *, long double *,
+                           long double *, long double **,
+                           void (*)(const long double *, const long double *, const long double, const int, long double *)) =
+        {&velverlet_ndim_npart, &yoshida4_ndim_npart};
+    // valutazioni della forza per passo di ciascun integratore
+    const int forcesPerStep[] = {1, 3};
+
+    long double tPhys = system->T * system->dt;
+    int bestIntegrator = -1, resultCode = 0;
+    long double bestDt = 0.L;
+    double bestWall = 0.;
+
+    printf("# %s: N = %d, physical time %Lf\n", name, system->nBodies, tPhys);
+    printf("#format:\t integrator\t dt\t steps\t force evaluations\t wall time [s]\t max relative energy error\n");
+
+    for (int integ = 0; integ < 2 && resultCode == 0; integ++)
+    {
+        for (int p = 0; p < BENCH_POINTS && resultCode == 0; p++)
         {
-            long double distance = dist(coord + j * SPATIAL_DIM, coord + i * SPATIAL_DIM, SPATIAL_DIM);
-            potEnergyTot += -G * masses[i] * masses[j] / distance;
+            long double dt = dtMax * powl(dtMin / dtMax, (long double)p / (BENCH_POINTS - 1));
+            long int nSteps = (long int)ceill(tPhys / dt);
+            nSteps = nSteps > 0 ? nSteps : 1;
+            dt = tPhys / nSteps;
+
+            memcpy(system->coord, coord0, n * sizeof(long double));
+            memcpy(system->vel, vel0, n * sizeof(long double));
+            forceFunction(system->coord, system->masses, system->G, system->nBodies, force);
+
+            // f_o viene riallocato a ogni prova, così velverlet_ndim_npart riparte dalla forza dello stato iniziale
+            long double *f_o = NULL;
+            long double kEnergy, potEnergy, energy0, maxErr = 0.L;
+            system_energies(system, &kEnergy, &potEnergy);
+            energy0 = kEnergy + potEnergy;
+
+            long int batch = nSteps / BENCH_CHECKS > 0 ? nSteps / BENCH_CHECKS : 1, done = 0;
+            double wall = 0.;
+
+            while (done < nSteps && isfinite(maxErr))
+            {
+                int steps = (int)(nSteps - done < batch ? nSteps - done : batch);
+                double start = metrics_wall_time();
+
+                if (integ == 0 && smallStep)
+                {
+                    smallStep(dt, system->G, system->masses, system->coord, system->vel, force, steps);
+                }
+                else
+                {
+                    for (int s = 0; s < steps && resultCode == 0; s++)
+                    {
+                        resultCode = stepFunctions[integ](dt, system->G, system->nBodies, SPATIAL_DIM, system->masses, system->coord,
+                                                          system->vel, force, &f_o, forceFunction);
+                    }
+                }
+
+                wall += metrics_wall_time() - start;
+                done += steps;
+
+                system_energies(system, &kEnergy, &potEnergy);
+                long double err = energy0 != 0 ? fabsl((kEnergy + potEnergy - energy0) / energy0) : fabsl(kEnergy + potEnergy);
+                // il confronto negato fa passare anche nan, che interrompe la prova
+                if (!(err <= maxErr))
+                {
+                    maxErr = err;
+                }
+            }
+
+            free(f_o);
+
+            if (resultCode == 0)
+            {
+                printf("%s %.6Le %ld %ld %.6f %.6Le\n", names[integ], dt, done, done * forcesPerStep[integ] + 1, wall, maxErr);
+            }
+
+            if (resultCode == 0 && target > 0 && maxErr <= target && (bestIntegrator < 0 || wall < bestWall))
+            {
+                bestIntegrator = integ;
+                bestDt = dt;
+                bestWall = wall;
+            }
         }
     }
 
-    return potEnergyTot;
+    if (target > 0 && resultCode == 0)
+    {
+        if (bestIntegrator >= 0)
+        {
+            printf("# fastest configuration with error <= %Le: integrator %s, dt %.6Le (%.6f s)\n", target, names[bestIntegrator],
+                   bestDt, bestWall);
+        }
+        else
+        {
+            printf("# no configuration with error <= %Le: lower dtmin\n", target);
+        }
+    }
+
+    memcpy(system->coord, coord0, n * sizeof(long double));
+    memcpy(system->vel, vel0, n * sizeof(long double));
+
+    free(coord0);
+    free(vel0);
+    free(force);
+
+    return resultCode;
 }
 
 /**
- * Funzione che stampa l'header per i file di output.
+ * Funzione che restituisce un numero casuale uniforme in [0, 1) con il generatore xorshift64*, la cui sequenza dipende solo dal seme
+ * (a differenza di rand) ed è quindi la stessa su ogni piattaforma.
  *
- * @param outFile Puntatore al file di output.
- * @param system Puntatore alla struct contenente le variabili relative al sistema.
- * @param format Stringa indicante il tipo di format scelto ("system" o "energies" a seconda che si vogliano stampare la traiettoria
- * del sistema o le energie del sistema).
+ * @param state Puntatore allo stato del generatore (non nullo), aggiornato a ogni chiamata.
  */
-void print_header(FILE *outFile, const PhysicalSystem *system, char *format)
+long double uniform_random(unsigned long long *state)
 {
-#ifdef FUNNY
-    char *quotes[N_QUOTES] =
-        {"Above all, don't fear difficult moments. The best comes from them.  (Rita Levi-Montalcini)",
-         "In physics, you don't have to go around making trouble for yourself. Nature does it for you.  (Frank Wilczek)",
-         "If you thought that science was certain - well, that is just an error on your part.  (Richard P. Feynman)",
-         "In science there is only physics; all the rest is stamp collecting.  (Lord Kelvin)",
-         "Nothing happens until something moves.  (Albert Einstein)",
-         "Not only is the Universe stranger than we think, it is stranger than we can think.  (Werner Heisenberg)",
-         "Physics is the only profession in which prophecy is not only accurate but routine.  (Neil deGrasse Tyson)"};
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
 
-    int r = rand() % N_QUOTES;
+    return (long double)((*state * 2685821657736338717ULL) >> 11) / 9007199254740992.L;
+}
 
-    fprintf(outFile, "#%s\n", quotes[r]);
-#endif
+/**
+ * Funzione che cerca un'orbita periodica vicina allo stato del file di input con il metodo di shooting (vedere shooting_solve). I
+ * candidati sono lo stato del file di input con il periodo period e altri nCandidates - 1 stati in cui ogni componente di posizioni e
+ * velocità è perturbata da un numero uniforme in [-spread, spread). Ogni integrazione usa ceil(period / dt) passi, con dt del file di
+ * input, la cui durata segue il periodo. Su stdout viene stampata una riga per candidato; il candidato convergito con il residuo minore
+ * viene salvato in OUTPUT_PERIODIC come file di input che integra esattamente un periodo.
+ *
+ * @param system Puntatore alla struct con il sistema letto dal file di input.
+ * @param name Nome del file di input, riportato nella tabella.
+ * @param period Stima iniziale del periodo.
+ * @param nCandidates Numero di candidati.
+ * @param spread Ampiezza delle perturbazioni dei candidati oltre il primo.
+ * @param seed Seme del generatore delle perturbazioni.
+ *
+ * @return -1 in caso di errore o se nessun candidato converge, 0 di default.
+ */
+int run_periodic_search(PhysicalSystem *system, const char *name, const long double period, const int nCandidates,
+                        const long double spread, const unsigned long long seed)
+{
+    // la matrice di transizione usa lo jacobiano della forza newtoniana diretta, come gli esponenti di Lyapunov
+    if (system->engine != ENGINE_DIRECT || system->nMassive < system->nBodies || system->softening != SOFTENING_NONE)
+    {
+        fprintf(stderr, "\nLa ricerca di orbite periodiche è supportata solo dal motore direct senza traccianti e softening.\n\n");
+        return -1;
+    }
 
-    fprintf(outFile, "#HDR N\t%d\n", system->nBodies);
-    fprintf(outFile, "#HDR G\t%Lf\n", system->G);
-    fprintf(outFile, "#HDR m\t");
-    for (int i = 0; i < system->nBodies; i++)
+    int n = system->nBodies * SPATIAL_DIM;
+    long int nSteps = (long int)ceill(period / system->dt);
+    ShootingCandidate *candidates = (ShootingCandidate *)malloc(nCandidates * sizeof(ShootingCandidate));
+    long double *states = (long double *)malloc(nCandidates * 2 * n * sizeof(long double));
+
+    if (!candidates || !states)
     {
-        fprintf(outFile, "%Lf ", system->masses[i]);
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        free(candidates);
+        free(states);
+        return -1;
     }
-    fprintf(outFile, "\n");
 
-    // controlli che scrivono il format dei dati nel file
-    fprintf(outFile, "#format:\t ");
-    if (strncmp(format, "system", 6) == 0)
+    unsigned long long rng = seed ^ 0x9E3779B97F4A7C15ULL;
+    for (int c = 0; c < nCandidates; c++)
     {
-        fprintf(outFile, "time\t coords: (");
-        for (int i = 0; i < SPATIAL_DIM; i++)
-        {
-            fprintf(outFile, " x%d", i);
-        }
-        fprintf(outFile, ")\t velocities: (");
-        for (int i = 0; i < SPATIAL_DIM; i++)
+        long double amplitude = c > 0 ? spread : 0.L;
+
+        candidates[c].state = states + c * 2 * n;
+        candidates[c].period = period;
+        for (int i = 0; i < n; i++)
         {
-            fprintf(outFile, " v%d", i);
+            candidates[c].state[i] = system->coord[i] + amplitude * (2.L * uniform_random(&rng) - 1.L);
+            candidates[c].state[n + i] = system->vel[i] + amplitude * (2.L * uniform_random(&rng) - 1.L);
         }
-        fprintf(outFile, ")\t accelerations: (");
-        for (int i = 0; i < SPATIAL_DIM; i++)
+    }
+
+    double start = metrics_wall_time();
+    int converged = shooting_solve(system->nBodies, SPATIAL_DIM, system->masses, system->G, nSteps, candidates, nCandidates);
+    double wall = metrics_wall_time() - start;
+
+    int best = -1;
+    if (converged >= 0)
+    {
+        printf("# %s: N = %d, %d candidates, %ld steps per period, %d converged in %.3f s\n", name, system->nBodies, nCandidates, nSteps,
+               converged, wall);
+        printf("#format:\t candidate\t converged\t iterations\t period\t residual\n");
+
+        for (int c = 0; c < nCandidates; c++)
         {
-            fprintf(outFile, " a%d", i);
+            printf("%d %d %d %.15Le %.6Le\n", c, candidates[c].converged, candidates[c].iterations, candidates[c].period,
+                   candidates[c].residual);
+
+            if (candidates[c].converged && (best < 0 || candidates[c].residual < candidates[best].residual))
+            {
+                best = c;
+            }
         }
-        fprintf(outFile, ")\n");
     }
-    else if (strncmp(format, "energies", 8) == 0)
+
+    // il file salvato integra un periodo con lo stesso numero di passi usato dallo shooting
+    int resultCode = converged >= 0 ? 0 : -1;
+    if (best >= 0)
     {
-        fprintf(outFile, "kinetic energy\t potential energy\t total energy\n");
+        memcpy(system->coord, candidates[best].state, n * sizeof(long double));
+        memcpy(system->vel, candidates[best].state + n, n * sizeof(long double));
+        system->dt = candidates[best].period / nSteps;
+        system->T = nSteps;
+        system->tdump = system->tdump < nSteps ? system->tdump : (int)nSteps;
+
+        resultCode = write_checkpoint(OUTPUT_PERIODIC, system, 0, -1.L, NULL);
+        if (resultCode == 0)
+        {
+            printf("# candidate %d written to %s (period %.15Le)\n", best, OUTPUT_PERIODIC, candidates[best].period);
+        }
     }
-    else
+    else if (converged >= 0)
     {
-        fprintf(stderr, "\nFormato specificato non supportato. La riga di formato verrà lasciata vuota.\n\n");
+        printf("# no candidate converged: improve the initial guess or lower dt\n");
+        resultCode = -1;
     }
+
+    free(candidates);
+    free(states);
+
+    return resultCode;
 }
 
 /**
- * Funzione che date le condizioni del sistema in un dato istante, stampa le posizioni, le velocità e le accelerazioni
- * del dato istante nel file specificato in outFile.
+ * Funzione che stampa su stdout un file di input con nBodies corpi di uguale massa estratti da una sfera di Plummer in equilibrio
+ * (Aarseth, Hénon e Wielen 1974), nelle unità standard con G = 1, massa totale 1 ed energia -1/4, nel sistema del centro di massa.
+ * Gli header dt, tdump e T corrispondono a un tempo fisico 1: vanno adattati all'uso, ad esempio come sistema di prova per --bench.
  *
- * @param outFile Puntatore al file in cui stampare posizioni, velocità e accelerazioni del sistema.
- * @param system Puntatore alla struct contenente tutte le variabili in gioco nel sistema.
+ * @param nBodies Numero di corpi (almeno 2).
+ * @param seed Seme del generatore casuale: lo stesso seme produce lo stesso sistema.
+ *
+ * @return -1 in caso di errore, 0 di default.
  */
-void print_system(FILE *outFile, const PhysicalSystem *system)
+int print_plummer(const int nBodies, const unsigned long long seed)
 {
-    static double t = 0.;
-
-    fprintf(outFile, "%lf ", t);
+    if (SPATIAL_DIM != 3 || nBodies < 2)
+    {
+        fprintf(stderr, "\nLa sfera di Plummer richiede SPATIAL_DIM = 3 e almeno 2 corpi.\n\n");
+        return -1;
+    }
 
-    for (int i = 0; i < system->nBodies * SPATIAL_DIM; i++)
+    long double *state = (long double *)malloc(2 * SPATIAL_DIM * nBodies * sizeof(long double));
+    if (!state)
     {
-        fprintf(outFile, "%.16Lf ", system->coord[i]);
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return -1;
     }
 
-    for (int i = 0; i < system->nBodies * SPATIAL_DIM; i++)
+    // lo stato dello xorshift non può essere nullo
+    unsigned long long rng = seed ^ 0x9E3779B97F4A7C15ULL;
+    long double scale = 3.L * M_PI / 16.L, cm[2 * SPATIAL_DIM] = {0.L};
+
+    for (int j = 0; j < nBodies; j++)
     {
-        fprintf(outFile, "%.16Lf ", system->vel[i]);
+        long double *x = state + 2 * SPATIAL_DIM * j, *v = x + SPATIAL_DIM, r, q, g;
+
+        // raggio dalla massa cumulativa, scartando le code oltre PLUMMER_MAX_RADIUS
+        do
+        {
+            r = 1.L / sqrtl(powl(uniform_random(&rng) + 1e-30L, -2.L / 3.L) - 1.L);
+        } while (r > PLUMMER_MAX_RADIUS);
+
+        // modulo della velocità in unità della velocità di fuga, per rigetto dalla distribuzione g(q) = q^2 (1 - q^2)^(7/2)
+        do
+        {
+            q = uniform_random(&rng);
+            g = 0.1L * uniform_random(&rng);
+        } while (g > q * q * powl(1.L - q * q, 3.5L));
+
+        long double speed = q * sqrtl(2.L) * powl(1.L + r * r, -0.25L);
+
+        for (int k = 0; k < 2; k++)
+        {
+            long double *u = k == 0 ? x : v, norm = k == 0 ? r : speed;
+            long double cosTheta = 1.L - 2.L * uniform_random(&rng), phi = 2.L * M_PI * uniform_random(&rng);
+            long double sinTheta = sqrtl(1.L - cosTheta * cosTheta);
+
+            u[0] = norm * sinTheta * cosl(phi);
+            u[1] = norm * sinTheta * sinl(phi);
+            u[2] = norm * cosTheta;
+        }
+
+        for (int k = 0; k < SPATIAL_DIM; k++)
+        {
+            x[k] *= scale;
+            v[k] /= sqrtl(scale);
+            cm[k] += x[k] / nBodies;
+            cm[k + SPATIAL_DIM] += v[k] / nBodies;
+        }
     }
 
-    for (int i = 0; i < system->nBodies * SPATIAL_DIM; i++)
+    printf("# Plummer sphere with %d bodies, seed %llu\n", nBodies, seed);
+    printf("#HDR N %d\n#HDR G 1\n#HDR dt 0.001\n#HDR tdump 10\n#HDR T 1000\n", nBodies);
+    printf("#idx m x y z vx vy vz\n");
+
+    for (int j = 0; j < nBodies; j++)
     {
-        fprintf(outFile, "%.16Lf ", system->acc[i]);
+        printf("%d %.21Le", j + 1, 1.L / nBodies);
+        for (int k = 0; k < 2 * SPATIAL_DIM; k++)
+        {
+            printf(" %.21Le", state[k + 2 * SPATIAL_DIM * j] - cm[k]);
+        }
+        printf("\n");
     }
 
-    fprintf(outFile, "\n");
+    free(state);
 
-    t++;
+    return 0;
 }
 
 /**
- * Funzione che, date le condizioni del sistema in un dato istante, calcola energia cinetica, potenziale e totale nel dato istante.
- * Stampa poi tutto nel file specificato in outFile.
+ * Funzione che restituisce la posizione attuale nei vettori del sistema del corpo con indice body nel file di input.
  *
- * @param outFile Puntatore al file in cui stampare energia cinetica, potenziale e totale del sistema in un dato istante.
- * @param system Puntatore alla struct contenente tutte le variabili in gioco nel sistema.
+ * @param system Puntatore alla struct contenente i dati relativi al sistema fisico considerato.
+ * @param body Indice (da 0) del corpo nel file di input.
+ *
+ * @return Posizione del corpo nei vettori (body stesso senza riordinamenti).
+ */
+int body_slot(const PhysicalSystem *system, const int body)
+{
+    return system->bodySlot ? system->bodySlot[body] : body;
+}
+
+/**
+ * Funzione che riordina i corpi lungo la curva di Morton (vedere sfc_order), separatamente tra i corpi massivi e i traccianti, che
+ * devono restare dopo di loro. Tutti i vettori per corpo vengono permutati allo stesso modo e bodyOrder e bodySlot vengono aggiornati,
+ * così l'output continua a riportare i corpi nell'ordine del file di input.
+ *
+ * @param system Puntatore alla struct contenente i dati relativi al sistema fisico considerato.
+ * @param force Puntatore alle forze attuali (NULL se non ancora calcolate).
+ * @param f_o Puntatore alle forze del passo precedente usate da velverlet_ndim_npart (NULL se non ancora allocate).
  */
-void print_energies(FILE *outFile, const PhysicalSystem *system)
+void reorder_bodies(PhysicalSystem *system, long double *force, long double *f_o)
 {
-    long double kEnergy, potEnergy, totEnergy;
+    int n = system->nBodies;
+    long double *fields[] = {system->coord, system->vel, system->acc, force, f_o};
+
+    sfc_order(system->coord, 0, system->nMassive);
+    sfc_order(system->coord, system->nMassive, n);
 
-    kEnergy = Ekin(system->vel, system->masses, system->nBodies);
-    potEnergy = Epot(system->coord, system->masses, system->G, system->nBodies);
-    totEnergy = kEnergy + potEnergy;
+    sfc_permute(system->masses, n, 1);
+    for (int f = 0; f < 5; f++)
+    {
+        if (fields[f])
+        {
+            sfc_permute(fields[f], n, SPATIAL_DIM);
+        }
+    }
+    if (system->radii)
+    {
+        sfc_permute(system->radii, n, 1);
+    }
 
-    fprintf(outFile, "%16.9Lf %16.9Lf %16.9Lf\n", kEnergy, potEnergy, totEnergy);
+    sfc_permute_index(system->bodyOrder, n);
+    for (int j = 0; j < n; j++)
+    {
+        system->bodySlot[system->bodyOrder[j]] = j;
+    }
 }
 
 /**
- * Funzione che libera tutti i puntatori della struct PhysicalSystem passata in input e poi il puntatore alla struct stessa.
+ * Funzione che sceglie all'avvio come calcolare la forza diretta sulla macchina e sul sistema in uso. Le varianti sono la somma sulle
+ * coppie (grav_force), quella a blocchi di 16, 32 e 64 corpi (grav_force_tiled), quella corpo per corpo (grav_force_full) e, se
+ * disponibile, il passo specializzato di smalln.c. Le varianti che calcolano la forza con un solo thread vengono provate una volta con un
+ * thread, quella corpo per corpo con 1, 2, 4, ... thread e con il massimo di OpenMP. Ogni prova integra una copia dello stato iniziale
+ * con stepFunction (a blocchi di passi che raddoppiano) per almeno AUTOTUNE_MIN_STEPS passi e AUTOTUNE_MIN_SECONDS secondi e viene
+ * valutata con il tempo per passo del suo blocco più veloce; dopo AUTOTUNE_MIN_STEPS passi viene interrotta appena è più lenta di
+ * AUTOTUNE_SLOWDOWN volte la migliore. La scelta viene salvata
+ * nella cache (vedere autotune_store) e riusata dalle simulazioni successive con la stessa macchina, dimensione e intervallo di N;
+ * su stderr viene riportata la scelta e da dove viene.
  *
- * @param system Puntatore alla struct PhysicalSystem da liberare.
+ * @param system Puntatore alla struct con il sistema letto dal file di input (non viene modificato).
+ * @param forceFunction Puntatore alla funzione della forza, sostituita con quella scelta.
+ * @param smallStep Puntatore al passo specializzato (NULL se non disponibile), posto a NULL se la scelta è un'altra variante.
+ * @param stepFunction Passo di integrazione usato dalla simulazione.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ *
+ * @note Il numero di thread scelto viene impostato con omp_set_num_threads e vale per tutto il resto della simulazione.
  */
-void free_struct_pointers(PhysicalSystem *system)
+int run_autotune(const PhysicalSystem *system,
+                 void (**forceFunction)(const long double *, const long double *, const long double, const int, long double *),
+                 SmallNStep *smallStep,
+                 int (*stepFunction)(const long double, const long double, const int, const int, const long double *, long double *,
+                                     long double *, long double *, long double **,
+                                     void (*)(const long double *, const long double *, const long double, const int, long double *)))
 {
-    free(system->masses);
-    free(system->coord);
-    free(system->vel);
-    free(system->acc);
-    free(system);
+    if ((system->engine != ENGINE_DIRECT && system->engine != ENGINE_TILED) || system->nMassive < system->nBodies ||
+        system->softening != SOFTENING_NONE || system->reproducible || system->lyapVectors > 0 || system->pararealSlices > 0)
+    {
+        fprintf(stderr, "\nL'autotuning richiede il motore direct o tiled senza traccianti, softening, reproducible, Lyapunov e "
+                        "parareal.\n\n");
+        return -1;
+    }
+
+    // il passo specializzato sostituisce l'intero passo, quindi non ha una funzione della forza (né blocchi)
+    const char *names[AUTOTUNE_VARIANTS] = {"pairs", "tiled16", "tiled32", "tiled64", "full", "unrolled"};
+    void (*forces[AUTOTUNE_VARIANTS])(const long double *, const long double *, const long double, const int, long double *) =
+        {&grav_force, &grav_force_tiled, &grav_force_tiled, &grav_force_tiled, &grav_force_full, NULL};
+    const int tiles[AUTOTUNE_VARIANTS] = {TILE_BODIES, 16, 32, 64, TILE_BODIES, TILE_BODIES};
+    int maxThreads = 1, best = -1, stored = 0;
+#ifdef _OPENMP
+    maxThreads = omp_get_max_threads();
+#endif
+
+    char path[FILENAME_MAX];
+    AutotuneChoice choice;
+    autotune_cache_path(system->autotuneCache, path);
+
+    // una scelta salvata vale solo se la variante esiste anche per questo N (il passo specializzato no per tutto l'intervallo)
+    int cached = autotune_lookup(path, system->nBodies, SPATIAL_DIM, maxThreads, &choice);
+    for (int v = 0; v < AUTOTUNE_VARIANTS && cached; v++)
+    {
+        if (strcmp(choice.variant, names[v]) == 0 && (forces[v] || *smallStep) && choice.threads >= 1 && choice.threads <= maxThreads)
+        {
+            best = v;
+        }
+    }
+
+    if (best < 0)
+    {
+        cached = 0;
+
+        int n = system->nBodies * SPATIAL_DIM;
+        long double *coord = (long double *)malloc(3 * n * sizeof(long double));
+
+        if (!coord)
+        {
+            fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+            return -1;
+        }
+        long double *vel = coord + n, *force = coord + 2 * n;
+
+        for (int v = 0; v < AUTOTUNE_VARIANTS; v++)
+        {
+            for (int threads = 1; threads <= maxThreads && (forces[v] || *smallStep);
+                 threads = threads < maxThreads && 2 * threads > maxThreads ? maxThreads : 2 * threads)
+            {
+                memcpy(coord, system->coord, n * sizeof(long double));
+                memcpy(vel, system->vel, n * sizeof(long double));
+#ifdef _OPENMP
+                omp_set_num_threads(threads);
+#endif
+                tileBodies = tiles[v];
+
+                // la forza iniziale viene calcolata con la funzione scelta prima dell'autotuning, che il passo specializzato usa
+                (forces[v] ? forces[v] : *forceFunction)(coord, system->masses, system->G, system->nBodies, force);
+
+                long double *f_o = NULL;
+                long int steps = 0, batch = 1;
+                // tempo per passo del blocco più veloce: un blocco rallentato da un altro processo non decide la scelta
+                double wall = 0., rate = -1.;
+
+                while (steps < AUTOTUNE_MIN_STEPS || wall < AUTOTUNE_MIN_SECONDS)
+                {
+                    double start = metrics_wall_time();
+
+                    if (!forces[v])
+                    {
+                        (*smallStep)(system->dt, system->G, system->masses, coord, vel, force, batch);
+                    }
+                    else
+                    {
+                        for (long int s = 0; s < batch; s++)
+                        {
+                            if (stepFunction(system->dt, system->G, system->nBodies, SPATIAL_DIM, system->masses, coord, vel, force, &f_o,
+                                             forces[v]) == -1)
+                            {
+                                free(f_o);
+                                free(coord);
+                                return -1;
+                            }
+                        }
+                    }
+
+                    double batchWall = metrics_wall_time() - start;
+                    wall += batchWall;
+                    rate = rate < 0 || batchWall / batch < rate ? batchWall / batch : rate;
+                    steps += batch;
+                    batch *= 2;
+
+                    // il primo passo, a cache fredda, non basta per scartare una variante
+                    if (best >= 0 && steps >= AUTOTUNE_MIN_STEPS && rate > AUTOTUNE_SLOWDOWN * choice.seconds)
+                    {
+                        break;
+                    }
+                }
+
+                free(f_o);
+
+                if (best < 0 || rate < choice.seconds)
+                {
+                    best = v;
+                    strcpy(choice.variant, names[v]);
+                    choice.threads = threads;
+                    choice.seconds = rate;
+                }
+
+                // solo la variante corpo per corpo divide la forza tra i thread: le altre vengono misurate una volta, con un thread
+                if (forces[v] != &grav_force_full)
+                {
+                    break;
+                }
+            }
+        }
+
+        free(coord);
+
+        // una cache che non si può scrivere non impedisce la simulazione
+        stored = autotune_store(path, system->nBodies, SPATIAL_DIM, maxThreads, &choice) == 0;
+    }
+
+#ifdef _OPENMP
+    omp_set_num_threads(choice.threads);
+#endif
+    tileBodies = tiles[best];
+    if (forces[best])
+    {
+        *forceFunction = forces[best];
+        *smallStep = NULL;
+    }
+
+    fprintf(stderr, "Autotuning: variante %s con %d thread, %.3e s per passo (%s %s).\n", names[best], choice.threads, choice.seconds,
+            cached ? "letta da" : stored ? "misurata e salvata in" : "misurata, non salvata in", path);
+
+    return 0;
 }
@@ -0,0 +1,166 @@
+// sigaction è POSIX e non fa parte di C99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "metrics.h"
+
+// Stato del monitoraggio, impostato da metrics_setup. Le grandezze "last" sono quelle dell'ultima chiamata di metrics_poll, quelle
+// "written" quelle dell'ultima riscrittura del file, usate per la velocità recente.
+static int active = 0;
+static const char *outPath = NULL;
+static double period = 0.;
+static long int total = 0;
+static long double stepDt = 0.L;
+static double startTime = 0.;
+static long int lastStep = 0;
+static long double pairsDone = 0.L;
+static long double lastError = -1.L;
+static long int lastBytes = 0;
+static double writtenTime = 0.;
+static long int writtenStep = 0;
+static long double writtenPairs = 0.L;
+static int snapshots = 0;
+static struct sigaction oldAction;
+
+// impostato dal gestore del segnale, che per essere sicuro non può fare altro
+static volatile sig_atomic_t snapshotRequested = 0;
+
+double metrics_wall_time(void)
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+#endif
+}
+
+static void request_snapshot(int sig)
+{
+    (void)sig;
+    snapshotRequested = 1;
+}
+
+/**
+ * Funzione che riscrive il file delle metriche con i valori dell'ultima chiamata di metrics_poll.
+ */
+static void write_metrics(const double now)
+{
+    char tmpPath[FILENAME_MAX];
+    snprintf(tmpPath, FILENAME_MAX, "%s.tmp", outPath);
+
+    FILE *outFile = fopen(tmpPath, "w");
+    if (!outFile)
+    {
+        return;
+    }
+
+    double elapsed = now - startTime, recent = now - writtenTime;
+    double stepsPerSec = recent > 0 ? (lastStep - writtenStep) / recent : 0.;
+    double pairsPerSec = recent > 0 ? (double)(pairsDone - writtenPairs) / recent : 0.;
+    double eta = lastStep > 0 ? elapsed * (total - lastStep) / lastStep : -1.;
+
+    fprintf(outFile, "# rewritten every %g s, rates since the previous rewrite\n", period);
+    fprintf(outFile, "step %ld\n", lastStep);
+    fprintf(outFile, "total_steps %ld\n", total);
+    fprintf(outFile, "sim_time %.9Lf\n", lastStep * stepDt);
+    fprintf(outFile, "elapsed_s %.3f\n", elapsed);
+    fprintf(outFile, "steps_per_s %.6e\n", stepsPerSec);
+    fprintf(outFile, "pair_interactions_per_s %.6e\n", pairsPerSec);
+    fprintf(outFile, "eta_s %.1f\n", eta);
+    fprintf(outFile, "energy_rel_error %.6Le\n", lastError);
+    fprintf(outFile, "bytes_written %ld\n", lastBytes);
+    fprintf(outFile, "snapshots %d\n", snapshots);
+
+    if (fclose(outFile) == 0)
+    {
+        rename(tmpPath, outPath);
+    }
+
+    writtenTime = now;
+    writtenStep = lastStep;
+    writtenPairs = pairsDone;
+}
+
+int metrics_setup(const char *path, const double interval, const long int totalSteps, const long double dt)
+{
+    struct sigaction action;
+    action.sa_handler = &request_snapshot;
+    sigemptyset(&action.sa_mask);
+    // le chiamate di sistema interrotte dal segnale (ad esempio le scritture su file) ripartono da sole
+    action.sa_flags = SA_RESTART;
+
+    if (sigaction(SIGUSR1, &action, &oldAction) == -1)
+    {
+        fprintf(stderr, "\nImpossibile installare il gestore di SIGUSR1.\n\n");
+        return -1;
+    }
+
+    active = 1;
+    outPath = path;
+    period = interval;
+    total = totalSteps;
+    stepDt = dt;
+    startTime = metrics_wall_time();
+    writtenTime = startTime;
+
+    if (period > 0)
+    {
+        write_metrics(startTime);
+    }
+
+    return 0;
+}
+
+long int metrics_max_batch(const long int step)
+{
+    double elapsed = metrics_wall_time() - startTime;
+    long int batch = elapsed > 0 ? (long int)(step / elapsed * METRICS_LATENCY) : 1;
+
+    return batch > 0 ? batch : 1;
+}
+
+int metrics_due(void)
+{
+    return snapshotRequested || (period > 0 && metrics_wall_time() - writtenTime >= period);
+}
+
+int metrics_poll(const long int step, const long double pairsPerStep, const long double energyError, const long int bytesWritten)
+{
+    pairsDone += (step - lastStep) * pairsPerStep;
+    lastStep = step;
+    lastError = energyError;
+    lastBytes = bytesWritten;
+
+    int requested = snapshotRequested;
+    snapshotRequested = 0;
+    snapshots += requested;
+
+    double now = metrics_wall_time();
+    // alla fine della simulazione il file viene riscritto comunque
+    if (period > 0 && (requested || now - writtenTime >= period || step == total))
+    {
+        write_metrics(now);
+    }
+
+    return requested;
+}
+
+void metrics_free(void)
+{
+    if (!active)
+    {
+        return;
+    }
+
+    sigaction(SIGUSR1, &oldAction, NULL);
+    active = 0;
+}
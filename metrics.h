@@ -0,0 +1,66 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// tempo massimo (in secondi) tra due punti sicuri in cui vengono controllate le richieste di snapshot e la riscrittura delle metriche
+#define METRICS_LATENCY 0.1
+
+/**
+ * Funzione che prepara il monitoraggio di una simulazione lunga. Se interval è positivo il file path viene riscritto ogni interval
+ * secondi con passi eseguiti, velocità di calcolo (passi e interazioni tra coppie al secondo), tempo stimato alla fine, errore
+ * relativo sull'energia e byte scritti nei file di output. Il file viene scritto in path.tmp e poi rinominato, così chi lo legge non
+ * trova mai un file scritto a metà. Viene inoltre installato un gestore di SIGUSR1 che registra la richiesta di uno snapshot: la
+ * richiesta viene segnalata da metrics_due e restituita dalla successiva chiamata di metrics_poll, che riscrive subito anche il file
+ * delle metriche.
+ *
+ * @param path Percorso del file delle metriche.
+ * @param interval Intervallo in secondi tra due riscritture del file (file disattivato se <= 0).
+ * @param totalSteps Numero totale di passi della simulazione.
+ * @param dt Passo di integrazione.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ *
+ * @note Il gestore del segnale e le risorse vanno rilasciati con metrics_free().
+ */
+int metrics_setup(const char *path, const double interval, const long int totalSteps, const long double dt);
+
+/**
+ * Funzione che restituisce il numero massimo di passi da eseguire prima del prossimo punto sicuro, stimato dalla velocità media
+ * perché tra due punti sicuri passino al più METRICS_LATENCY secondi (1 finché la velocità non è nota).
+ *
+ * @param step Numero di passi eseguiti.
+ */
+long int metrics_max_batch(const long int step);
+
+/**
+ * Funzione che controlla, a costo trascurabile, se in un punto sicuro va chiamata metrics_poll.
+ *
+ * @return 1 se è arrivato SIGUSR1 o se è trascorso l'intervallo di riscrittura del file delle metriche, 0 di default.
+ */
+int metrics_due(void);
+
+/**
+ * Funzione che riscrive il file delle metriche (se attivo) e restituisce le richieste di snapshot arrivate. Va chiamata nei punti
+ * sicuri della simulazione, tra un passo e l'altro, quando metrics_due restituisce 1, e alla fine della simulazione.
+ *
+ * @param step Numero di passi eseguiti.
+ * @param pairsPerStep Interazioni tra coppie di corpi calcolate in ogni passo (con i motori approssimati, quelle della somma diretta
+ * equivalente).
+ * @param energyError Ultimo errore relativo sull'energia totale calcolato (negativo se non disponibile).
+ * @param bytesWritten Byte scritti fino a questo momento nei file di output.
+ *
+ * @return 1 se dall'ultima chiamata è arrivato SIGUSR1 e va salvato uno snapshot, 0 di default.
+ */
+int metrics_poll(const long int step, const long double pairsPerStep, const long double energyError, const long int bytesWritten);
+
+/**
+ * Funzione che restituisce il tempo trascorso in secondi da un istante fisso: omp_get_wtime se il programma è compilato con OpenMP,
+ * altrimenti l'orologio monotono POSIX. Serve solo per differenze tra due chiamate.
+ */
+double metrics_wall_time(void);
+
+/**
+ * Funzione che ripristina il gestore di SIGUSR1 precedente a metrics_setup. Non fa nulla se metrics_setup non è stata chiamata.
+ */
+void metrics_free(void);
+
+#endif
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "parareal.h"
+#include "integrator.h"
+
+// Configurazione e memoria, impostate da parareal_setup. Gli stati sono vettori di 3 * nValues componenti: posizioni, velocità e forza
+// nelle posizioni (come f_o nell'integrazione seriale, così che la propagazione fine di un intervallo che parte da uno stato esatto
+// riproduca bit per bit quella seriale anche con i passi di smalln.h, che calcolano la forza con arrotondamenti diversi da F).
+// - U : stato corrente all'inizio di ogni intervallo (nSlices + 1 stati);
+// - coarseOld : propagazione grossolana dell'iterazione precedente, alla fine di ogni intervallo;
+// - fine : propagazione fine dell'iterazione corrente, alla fine di ogni intervallo;
+// - sliceOld : forza del passo precedente di ogni intervallo per velverlet_ndim_npart, così che i thread non condividano memoria;
+// - sliceSteps : numero di passi fini di ogni intervallo.
+static int nB = 0;
+static int dim = 0;
+static int nValues = 0;
+static int slices = 0;
+static int ratio = 1;
+static long double tolerance = 0.L;
+static void (*forceFunction)(const long double *, const long double *, const long double, const int, long double *) = NULL;
+static SmallNStep step = NULL;
+static long double *U = NULL;
+static long double *coarseOld = NULL;
+static long double *fine = NULL;
+static long double *coarseNew = NULL;
+static long double *sliceOld = NULL;
+static long int *sliceSteps = NULL;
+
+/**
+ * Funzione che propaga lo stato state (posizioni, velocità e forza) di nSteps passi di durata dt, usando fOld (nValues componenti)
+ * come memoria di lavoro.
+ */
+static void propagate(const long double dt, const long int nSteps, const long double G, const long double *masses, long double *state,
+                      long double *fOld)
+{
+    long double *force = state + 2 * nValues;
+
+    if (nSteps <= 0)
+    {
+        return;
+    }
+
+    if (step)
+    {
+        step(dt, G, masses, state, state + nValues, force, nSteps);
+        return;
+    }
+
+    memcpy(fOld, force, nValues * sizeof(long double));
+    for (long int s = 0; s < nSteps; s++)
+    {
+        // fOld è già allocato, quindi velverlet_ndim_npart non può fallire
+        velverlet_ndim_npart(dt, G, nB, dim, masses, state, state + nValues, force, &fOld, forceFunction);
+    }
+}
+
+/**
+ * Funzione che applica il propagatore grossolano: nSteps / ratio passi di durata ratio * dt e un ultimo passo per i passi rimanenti.
+ */
+static void coarse(const long double dt, const long int nSteps, const long double G, const long double *masses, long double *state,
+                   long double *fOld)
+{
+    propagate(ratio * dt, nSteps / ratio, G, masses, state, fOld);
+    propagate((nSteps % ratio) * dt, nSteps % ratio ? 1 : 0, G, masses, state, fOld);
+}
+
+int parareal_setup(const int nBodies, const int spatialDim, const int nSlices, const int coarseRatio, const long double tol,
+                   void (*F)(const long double *, const long double *, const long double, const int, long double *), SmallNStep fineStep)
+{
+    if (nSlices <= 0 || coarseRatio <= 0 || tol < 0)
+    {
+        fprintf(stderr, "\nParametri non validi per l'integrazione parareal.\n\n");
+        return -1;
+    }
+
+    nB = nBodies;
+    dim = spatialDim;
+    nValues = nBodies * spatialDim;
+    slices = nSlices;
+    ratio = coarseRatio;
+    tolerance = tol;
+    forceFunction = F;
+    step = fineStep;
+
+    U = (long double *)malloc((slices + 1) * 3 * nValues * sizeof(long double));
+    coarseOld = (long double *)malloc((slices + 1) * 3 * nValues * sizeof(long double));
+    fine = (long double *)malloc((slices + 1) * 3 * nValues * sizeof(long double));
+    coarseNew = (long double *)malloc(3 * nValues * sizeof(long double));
+    sliceOld = (long double *)malloc(slices * nValues * sizeof(long double));
+    sliceSteps = (long int *)malloc(slices * sizeof(long int));
+
+    if (!U || !coarseOld || !fine || !coarseNew || !sliceOld || !sliceSteps)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        parareal_free();
+        return -1;
+    }
+
+    return 0;
+}
+
+void parareal_steps(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                    long double *force, const long int nSteps)
+{
+    int P = nSteps < slices ? (int)nSteps : slices, len = 3 * nValues;
+
+    for (int n = 0; n < P; n++)
+    {
+        sliceSteps[n] = nSteps / P + (n < nSteps % P ? 1 : 0);
+    }
+
+    memcpy(U, coord, nValues * sizeof(long double));
+    memcpy(U + nValues, vel, nValues * sizeof(long double));
+    memcpy(U + 2 * nValues, force, nValues * sizeof(long double));
+
+    // prima stima seriale con il solo propagatore grossolano
+    for (int n = 0; n < P; n++)
+    {
+        memcpy(U + (n + 1) * len, U + n * len, len * sizeof(long double));
+        coarse(dt, sliceSteps[n], G, masses, U + (n + 1) * len, sliceOld);
+        memcpy(coarseOld + (n + 1) * len, U + (n + 1) * len, len * sizeof(long double));
+    }
+
+    // Gli intervalli prima di firstOpen partono da uno stato esatto: la loro propagazione fine è definitiva e non va ripetuta.
+    for (int firstOpen = 0; firstOpen < P;)
+    {
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int n = firstOpen; n < P; n++)
+        {
+            memcpy(fine + (n + 1) * len, U + n * len, len * sizeof(long double));
+            propagate(dt, sliceSteps[n], G, masses, fine + (n + 1) * len, sliceOld + n * nValues);
+        }
+
+        // Il primo intervallo aperto parte da uno stato esatto, quindi il suo stato finale è quello fine (assegnato direttamente perché
+        // G(U) + F(U) - G(U) potrebbe differire da F(U) per gli arrotondamenti).
+        memcpy(U + (firstOpen + 1) * len, fine + (firstOpen + 1) * len, len * sizeof(long double));
+
+        long double maxDelta = 0.L, maxAbs = 1.L;
+
+        for (int n = firstOpen + 1; n < P; n++)
+        {
+            memcpy(coarseNew, U + n * len, len * sizeof(long double));
+            coarse(dt, sliceSteps[n], G, masses, coarseNew, sliceOld);
+
+            // anche la forza viene corretta, così resta consistente con le posizioni a meno della tolleranza; la convergenza si
+            // misura solo su posizioni e velocità
+            for (int i = 0; i < len; i++)
+            {
+                long double updated = coarseNew[i] + fine[i + (n + 1) * len] - coarseOld[i + (n + 1) * len];
+
+                if (i < 2 * nValues)
+                {
+                    long double delta = fabsl(updated - U[i + (n + 1) * len]);
+                    maxDelta = delta > maxDelta ? delta : maxDelta;
+                    maxAbs = fabsl(updated) > maxAbs ? fabsl(updated) : maxAbs;
+                }
+
+                U[i + (n + 1) * len] = updated;
+                coarseOld[i + (n + 1) * len] = coarseNew[i];
+            }
+        }
+
+        firstOpen++;
+
+        if (maxDelta <= tolerance * maxAbs)
+        {
+            break;
+        }
+    }
+
+    memcpy(coord, U + P * len, nValues * sizeof(long double));
+    memcpy(vel, U + P * len + nValues, nValues * sizeof(long double));
+    memcpy(force, U + P * len + 2 * nValues, nValues * sizeof(long double));
+}
+
+void parareal_free(void)
+{
+    free(U);
+    free(coarseOld);
+    free(fine);
+    free(coarseNew);
+    free(sliceOld);
+    free(sliceSteps);
+
+    U = NULL;
+    coarseOld = NULL;
+    fine = NULL;
+    coarseNew = NULL;
+    sliceOld = NULL;
+    sliceSteps = NULL;
+}
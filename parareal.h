@@ -0,0 +1,45 @@
+#ifndef PARAREAL_H
+#define PARAREAL_H
+
+#include "smalln.h"
+
+// valori di default del rapporto tra passo grossolano e passo fine e della tolleranza sulla convergenza
+#define PARAREAL_DEFAULT_RATIO 10
+#define PARAREAL_DEFAULT_TOL 1e-12L
+
+/**
+ * Funzione che prepara l'integrazione parareal (parallela nel tempo).
+ *
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param nSlices Numero di intervalli in cui viene diviso ogni blocco di passi, propagati in parallelo dai thread OpenMP.
+ * @param coarseRatio Rapporto tra il passo del propagatore grossolano e quello fine.
+ * @param tol Tolleranza sulla variazione dello stato tra due iterazioni (relativa al massimo valore assoluto delle componenti, o
+ * assoluta se questo è minore di 1). Con tol = 0 le iterazioni proseguono fino a riprodurre esattamente il propagatore fine.
+ * @param F Funzione che calcola la forza per velverlet_ndim_npart (deve poter essere chiamata da più thread insieme, quindi non pm_force).
+ * @param fineStep Passo specializzato di smalln.h da usare come propagatore, NULL per usare velverlet_ndim_npart con F.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int parareal_setup(const int nBodies, const int spatialDim, const int nSlices, const int coarseRatio, const long double tol,
+                   void (*F)(const long double *, const long double *, const long double, const int, long double *), SmallNStep fineStep);
+
+/**
+ * Funzione che esegue nSteps passi di Velocity Verlet con il metodo parareal: gli nSteps passi vengono divisi in nSlices intervalli,
+ * una prima stima dello stato all'inizio di ogni intervallo viene ottenuta in seriale con il propagatore grossolano (Velocity Verlet
+ * con passo coarseRatio * dt) e poi corretta iterando
+ * U[n + 1] = G(U[n]) + F(U_old[n]) - G(U_old[n]),
+ * dove le propagazioni fini F di tutti gli intervalli (la parte costosa) sono eseguite in parallelo e solo G è seriale.
+ * Dopo k iterazioni i primi k intervalli coincidono con la soluzione fine, quindi al più dopo nSlices iterazioni il risultato è quello
+ * dell'integrazione seriale; di solito la variazione scende sotto la tolleranza molto prima.
+ * Ha la stessa interfaccia dei passi specializzati di smalln.h (force svolge il ruolo di f_o).
+ */
+void parareal_steps(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                    long double *force, const long int nSteps);
+
+/**
+ * Funzione che libera la memoria allocata da parareal_setup. Non fa nulla se parareal_setup non è stata chiamata.
+ */
+void parareal_free(void);
+
+#endif
@@ -0,0 +1,587 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "pm.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define PM_DIM 3
+
+// M_PI non fa parte dello standard C99
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// oltre PM_RCUT_FACTOR * rsplit la parte a corto raggio della forza è trascurabile (erfc(2.25) ~ 1e-3)
+#define PM_RCUT_FACTOR 4.5L
+
+// costante di Madelung del reticolo cubico semplice con fondo uniforme: le immagini periodiche di un corpo e il fondo generano nella sua
+// posizione il potenziale G m PM_MADELUNG / box
+#define PM_MADELUNG 2.8372974794806
+
+static int pmMesh = 0;
+static double pmBox, pmCell;
+static double pmRsplit;
+static int pmShortRange;
+static int pmThreads = 1;
+
+// Le griglie complesse sono salvate come coppie (parte reale, parte immaginaria) consecutive.
+static double *phiK = NULL;    // trasformata del potenziale (senza il fattore G)
+static double *work = NULL;    // griglia di lavoro per densità, componenti della forza e potenziale
+static double *greenK = NULL;  // funzione di Green già filtrata e deconvoluta (reale)
+static double *lineBuf = NULL; // una riga di FFT per ogni thread
+static double *twiddle = NULL;
+static int *bitrev = NULL;
+
+// potenziale sulla griglia (senza G) di una massa unitaria in un nodo, nel nodo stesso e nei nodi vicini: selfGreen[(ax * 2 + ay) * 2 + az]
+// con a = |spostamento| lungo ogni asse (solo per il PM puro)
+static double selfGreen[8];
+
+// liste concatenate di celle per la correzione a corto raggio
+static int nCells = 0;
+static int *cellHead = NULL;
+static int *cellNext = NULL;
+
+static long int grid_index(const int ix, const int iy, const int iz)
+{
+    return ((long int)ix * pmMesh + iy) * pmMesh + iz;
+}
+
+static double wave_number(const int n)
+{
+    return 2. * M_PI / pmBox * (n <= pmMesh / 2 ? n : n - pmMesh);
+}
+
+/**
+ * Funzione che calcola in place la FFT radix-2 di una riga complessa di pmMesh elementi.
+ *
+ * @param a Puntatore alla riga di 2 * pmMesh double (parte reale e immaginaria alternate).
+ * @param inverse Se diverso da 0 calcola la trasformata inversa (non normalizzata).
+ */
+static void fft_line(double *a, const int inverse)
+{
+    for (int i = 0; i < pmMesh; i++)
+    {
+        int j = bitrev[i];
+        if (j > i)
+        {
+            double tr = a[2 * i], ti = a[2 * i + 1];
+            a[2 * i] = a[2 * j];
+            a[2 * i + 1] = a[2 * j + 1];
+            a[2 * j] = tr;
+            a[2 * j + 1] = ti;
+        }
+    }
+
+    for (int len = 2; len <= pmMesh; len <<= 1)
+    {
+        int half = len / 2, step = pmMesh / len;
+        for (int start = 0; start < pmMesh; start += len)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                double wr = twiddle[2 * k * step];
+                double wi = inverse ? twiddle[2 * k * step + 1] : -twiddle[2 * k * step + 1];
+                double *u = a + 2 * (start + k), *v = a + 2 * (start + k + half);
+                double vr = v[0] * wr - v[1] * wi;
+                double vi = v[0] * wi + v[1] * wr;
+                v[0] = u[0] - vr;
+                v[1] = u[1] - vi;
+                u[0] += vr;
+                u[1] += vi;
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che calcola la FFT tridimensionale di una griglia complessa applicando fft_line lungo i tre assi.
+ *
+ * @param grid Puntatore alla griglia di 2 * pmMesh^3 double.
+ * @param inverse Se diverso da 0 calcola la trasformata inversa (non normalizzata).
+ */
+static void fft_3d(double *grid, const int inverse)
+{
+    const long int strides[PM_DIM] = {(long int)pmMesh * pmMesh, pmMesh, 1};
+
+    for (int axis = 0; axis < PM_DIM; axis++)
+    {
+        long int stride = strides[axis];
+
+#pragma omp parallel for schedule(static)
+        for (long int line = 0; line < (long int)pmMesh * pmMesh; line++)
+        {
+            int thread = 0;
+#ifdef _OPENMP
+            thread = omp_get_thread_num();
+#endif
+            double *buf = lineBuf + 2L * pmMesh * thread;
+
+            // la riga è individuata dai due indici degli assi diversi da quello trasformato
+            long int a = line / pmMesh, b = line % pmMesh, base;
+            if (axis == 0)
+                base = grid_index(0, a, b);
+            else if (axis == 1)
+                base = grid_index(a, 0, b);
+            else
+                base = grid_index(a, b, 0);
+
+            for (int n = 0; n < pmMesh; n++)
+            {
+                buf[2 * n] = grid[2 * (base + n * stride)];
+                buf[2 * n + 1] = grid[2 * (base + n * stride) + 1];
+            }
+
+            fft_line(buf, inverse);
+
+            for (int n = 0; n < pmMesh; n++)
+            {
+                grid[2 * (base + n * stride)] = buf[2 * n];
+                grid[2 * (base + n * stride) + 1] = buf[2 * n + 1];
+            }
+        }
+    }
+}
+
+/**
+ * Funzione che calcola gli indici e i pesi cloud-in-cell (CIC) dei vertici della cella che contiene il corpo.
+ *
+ * @param pos Puntatore alle PM_DIM coordinate del corpo.
+ * @param idx Vettore di 2 * PM_DIM interi in cui inserire gli indici di griglia (inferiore e superiore) per ogni asse.
+ * @param w Vettore di 2 * PM_DIM double in cui inserire i pesi corrispondenti.
+ */
+static void cic_weights(const long double *pos, int *idx, double *w)
+{
+    for (int d = 0; d < PM_DIM; d++)
+    {
+        // riporto la coordinata all'interno della scatola periodica
+        double u = fmod((double)pos[d], pmBox);
+        if (u < 0.)
+            u += pmBox;
+
+        double s = u / pmCell;
+        int i0 = (int)floor(s);
+        double f = s - i0;
+
+        idx[2 * d] = i0 % pmMesh;
+        idx[2 * d + 1] = (i0 + 1) % pmMesh;
+        w[2 * d] = 1. - f;
+        w[2 * d + 1] = f;
+    }
+}
+
+/**
+ * Funzione che assegna le masse alla griglia e calcola la trasformata del potenziale in phiK.
+ */
+static void pm_solve(const long double *coord, const long double *masses, const int nBodies)
+{
+    long int nGrid = (long int)pmMesh * pmMesh * pmMesh;
+    double cellVolume = pmCell * pmCell * pmCell;
+    int idx[2 * PM_DIM];
+    double w[2 * PM_DIM];
+
+    for (long int i = 0; i < 2 * nGrid; i++)
+    {
+        work[i] = 0.;
+    }
+
+    // L'assegnazione è seriale: in parallelo più corpi scriverebbero sulle stesse celle.
+    for (int j = 0; j < nBodies; j++)
+    {
+        cic_weights(coord + j * PM_DIM, idx, w);
+        double rho = (double)masses[j] / cellVolume;
+
+        for (int a = 0; a < 2; a++)
+            for (int b = 0; b < 2; b++)
+                for (int c = 0; c < 2; c++)
+                    work[2 * grid_index(idx[a], idx[2 + b], idx[4 + c])] += rho * w[a] * w[2 + b] * w[4 + c];
+    }
+
+    fft_3d(work, 0);
+
+#pragma omp parallel for schedule(static)
+    for (long int i = 0; i < nGrid; i++)
+    {
+        phiK[2 * i] = work[2 * i] * greenK[i];
+        phiK[2 * i + 1] = work[2 * i + 1] * greenK[i];
+    }
+}
+
+/**
+ * Funzione che interpola con pesi CIC il valore della griglia reale (parte reale di work) nella posizione del corpo.
+ */
+static double cic_interpolate(const long double *pos)
+{
+    int idx[2 * PM_DIM];
+    double w[2 * PM_DIM], value = 0.;
+
+    cic_weights(pos, idx, w);
+
+    for (int a = 0; a < 2; a++)
+        for (int b = 0; b < 2; b++)
+            for (int c = 0; c < 2; c++)
+                value += work[2 * grid_index(idx[a], idx[2 + b], idx[4 + c])] * w[a] * w[2 + b] * w[4 + c];
+
+    return value;
+}
+
+/**
+ * Funzione che costruisce le liste concatenate di celle di lato almeno pari al raggio di taglio.
+ */
+static void build_cells(const long double *coord, const int nBodies)
+{
+    for (int c = 0; c < nCells * nCells * nCells; c++)
+    {
+        cellHead[c] = -1;
+    }
+
+    for (int j = 0; j < nBodies; j++)
+    {
+        int cell[PM_DIM];
+        for (int d = 0; d < PM_DIM; d++)
+        {
+            double u = fmod((double)coord[d + j * PM_DIM], pmBox);
+            if (u < 0.)
+                u += pmBox;
+            cell[d] = (int)(u / pmBox * nCells) % nCells;
+        }
+
+        int c = (cell[0] * nCells + cell[1]) * nCells + cell[2];
+        cellNext[j] = cellHead[c];
+        cellHead[c] = j;
+    }
+}
+
+/**
+ * Funzione che calcola il contributo di una coppia alla parte a corto raggio (con convenzione dell'immagine minima).
+ * Aggiunge le forze a force (se non NULL) e ritorna il contributo della coppia all'energia potenziale.
+ */
+static long double short_range_pair(const long double *coord, const long double *masses, const long double G, const int i, const int j,
+                                    long double *force)
+{
+    long double vec_d[PM_DIM], d2 = 0.L;
+    long double rcut = PM_RCUT_FACTOR * pmRsplit;
+
+    for (int k = 0; k < PM_DIM; k++)
+    {
+        vec_d[k] = coord[k + i * PM_DIM] - coord[k + j * PM_DIM];
+        vec_d[k] -= pmBox * roundl(vec_d[k] / pmBox);
+        d2 += vec_d[k] * vec_d[k];
+    }
+
+    if (d2 >= rcut * rcut || d2 == 0.L)
+        return 0.L;
+
+    long double d = sqrtl(d2);
+    long double x = d / (2.L * pmRsplit);
+
+    if (force)
+    {
+        long double shape = erfcl(x) + d / (pmRsplit * sqrtl(M_PI)) * expl(-x * x);
+        for (int k = 0; k < PM_DIM; k++)
+        {
+            long double forceComp = -G * masses[i] * masses[j] * vec_d[k] * shape / (d2 * d);
+            force[k + i * PM_DIM] += forceComp;
+            force[k + j * PM_DIM] -= forceComp;
+        }
+    }
+
+    return -G * masses[i] * masses[j] * erfcl(x) / d;
+}
+
+/**
+ * Funzione che somma su tutte le coppie vicine la parte a corto raggio della forza (P3M) e ne ritorna l'energia potenziale.
+ * Ogni coppia viene considerata una sola volta (j > i) come in grav_force.
+ */
+static long double short_range(const long double *coord, const long double *masses, const long double G, const int nBodies,
+                               long double *force)
+{
+    long double energy = 0.L;
+
+    // con meno di 3 celle per lato le celle vicine non sarebbero distinte: si sommano tutte le coppie
+    if (nCells < 3)
+    {
+        for (int i = 0; i < nBodies; i++)
+            for (int j = i + 1; j < nBodies; j++)
+                energy += short_range_pair(coord, masses, G, i, j, force);
+
+        return energy;
+    }
+
+    build_cells(coord, nBodies);
+
+    for (int cx = 0; cx < nCells; cx++)
+        for (int cy = 0; cy < nCells; cy++)
+            for (int cz = 0; cz < nCells; cz++)
+                for (int i = cellHead[(cx * nCells + cy) * nCells + cz]; i >= 0; i = cellNext[i])
+                    for (int ox = -1; ox <= 1; ox++)
+                        for (int oy = -1; oy <= 1; oy++)
+                            for (int oz = -1; oz <= 1; oz++)
+                            {
+                                int nx = (cx + ox + nCells) % nCells;
+                                int ny = (cy + oy + nCells) % nCells;
+                                int nz = (cz + oz + nCells) % nCells;
+
+                                for (int j = cellHead[(nx * nCells + ny) * nCells + nz]; j >= 0; j = cellNext[j])
+                                {
+                                    if (j > i)
+                                        energy += short_range_pair(coord, masses, G, i, j, force);
+                                }
+                            }
+
+    return energy;
+}
+
+int pm_setup(const int nBodies, const int spatialDim, const int mesh, const long double box, const long double rsplit, const int shortRange)
+{
+    if (spatialDim != PM_DIM)
+    {
+        fprintf(stderr, "\nIl metodo particle-mesh è implementato solo per %d dimensioni.\n\n", PM_DIM);
+        return -1;
+    }
+
+    if (mesh < 2 || (mesh & (mesh - 1)) != 0 || box <= 0.L)
+    {
+        fprintf(stderr, "\nIl metodo particle-mesh richiede box positivo e mesh potenza di 2.\n\n");
+        return -1;
+    }
+
+    pmMesh = mesh;
+    pmBox = (double)box;
+    pmCell = pmBox / pmMesh;
+    pmShortRange = shortRange;
+    pmRsplit = shortRange ? (double)rsplit : 0.;
+
+#ifdef _OPENMP
+    pmThreads = omp_get_max_threads();
+#endif
+
+    long int nGrid = (long int)pmMesh * pmMesh * pmMesh;
+
+    phiK = (double *)malloc(2 * nGrid * sizeof(double));
+    work = (double *)malloc(2 * nGrid * sizeof(double));
+    greenK = (double *)malloc(nGrid * sizeof(double));
+    lineBuf = (double *)malloc(2L * pmMesh * pmThreads * sizeof(double));
+    twiddle = (double *)malloc(pmMesh * sizeof(double));
+    bitrev = (int *)malloc(pmMesh * sizeof(int));
+
+    if (pmShortRange)
+    {
+        if (pmRsplit <= 0. || PM_RCUT_FACTOR * pmRsplit >= pmBox / 2.)
+        {
+            fprintf(stderr, "\nrsplit deve essere positivo e il raggio di taglio minore di metà box.\n\n");
+            pm_free();
+            return -1;
+        }
+
+        nCells = (int)(pmBox / (PM_RCUT_FACTOR * pmRsplit));
+        cellHead = (int *)malloc(nCells * nCells * nCells * sizeof(int));
+        cellNext = (int *)malloc(nBodies * sizeof(int));
+    }
+
+    if (!phiK || !work || !greenK || !lineBuf || !twiddle || !bitrev || (pmShortRange && (!cellHead || !cellNext)))
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        pm_free();
+        return -1;
+    }
+
+    for (int k = 0; k < pmMesh / 2; k++)
+    {
+        twiddle[2 * k] = cos(2. * M_PI * k / pmMesh);
+        twiddle[2 * k + 1] = sin(2. * M_PI * k / pmMesh);
+    }
+
+    int logMesh = 0;
+    while ((1 << logMesh) < pmMesh)
+        logMesh++;
+    for (int i = 0; i < pmMesh; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < logMesh; b++)
+            r |= ((i >> b) & 1) << (logMesh - 1 - b);
+        bitrev[i] = r;
+    }
+
+    // Funzione di Green dell'equazione di Poisson (phi_k = -4 pi rho_k / k^2).
+    // Per il P3M si aggiunge il filtro gaussiano a lungo raggio e si divide per il quadrato della finestra CIC (assegnazione +
+    // interpolazione). Senza filtro lo spettro troncato alla frequenza di Nyquist produrrebbe forti oscillazioni nella forza,
+    // quindi per il PM puro si usa il laplaciano discreto (k^2 -> sum (2 sin(k h / 2) / h)^2), coerente con il gradiente alle
+    // differenze finite di pm_force.
+    for (int ix = 0; ix < pmMesh; ix++)
+        for (int iy = 0; iy < pmMesh; iy++)
+            for (int iz = 0; iz < pmMesh; iz++)
+            {
+                double k[PM_DIM] = {wave_number(ix), wave_number(iy), wave_number(iz)};
+                double k2 = 0., window = 1.;
+
+                for (int d = 0; d < PM_DIM; d++)
+                {
+                    double x = k[d] * pmCell / 2.;
+                    double sinc = x == 0. ? 1. : sin(x) / x;
+                    window *= sinc * sinc;
+                    k2 += pmShortRange ? k[d] * k[d] : pow(2. * sin(x) / pmCell, 2);
+                }
+
+                long int i = grid_index(ix, iy, iz);
+                if (!pmShortRange)
+                    window = 1.;
+
+                greenK[i] = k2 == 0. ? 0. : -4. * M_PI / k2 * exp(-k2 * pmRsplit * pmRsplit) / (window * window);
+            }
+
+    // per il PM puro il potenziale di un corpo su sé stesso dipende dalla sua posizione nella cella, quindi si salva la risposta
+    // della griglia a una massa unitaria in un nodo (stessa assegnazione, stessa funzione di Green) da usare in pm_epot
+    if (!pmShortRange)
+    {
+        const long double origin[PM_DIM] = {0.L, 0.L, 0.L}, unitMass = 1.L;
+
+        pm_solve(origin, &unitMass, 1);
+        for (long int i = 0; i < 2 * nGrid; i++)
+        {
+            work[i] = phiK[i];
+        }
+        fft_3d(work, 1);
+
+        for (int ax = 0; ax < 2; ax++)
+            for (int ay = 0; ay < 2; ay++)
+                for (int az = 0; az < 2; az++)
+                    selfGreen[(ax * 2 + ay) * 2 + az] = work[2 * grid_index(ax, ay, az)] / nGrid;
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che restituisce il potenziale sulla griglia (senza G) generato nella posizione di un corpo di massa unitaria dalla sua
+ * stessa assegnazione CIC: somma sui due gruppi di 8 vertici della cella dei prodotti dei pesi per selfGreen.
+ */
+static double pm_self_potential(const long double *pos)
+{
+    int idx[2 * PM_DIM];
+    double w[2 * PM_DIM], value = 0.;
+
+    cic_weights(pos, idx, w);
+
+    for (int a = 0; a < 8; a++)
+        for (int b = 0; b < 8; b++)
+        {
+            double weight = 1.;
+            int shift = 0;
+
+            for (int d = 0; d < PM_DIM; d++)
+            {
+                int ad = (a >> (PM_DIM - 1 - d)) & 1, bd = (b >> (PM_DIM - 1 - d)) & 1;
+                weight *= w[2 * d + ad] * w[2 * d + bd];
+                shift = 2 * shift + (ad != bd);
+            }
+
+            value += weight * selfGreen[shift];
+        }
+
+    return value;
+}
+
+void pm_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+    long int nGrid = (long int)pmMesh * pmMesh * pmMesh;
+
+    pm_solve(coord, masses, nBodies);
+
+    for (int i = 0; i < PM_DIM * nBodies; i++)
+    {
+        force[i] = 0.L;
+    }
+
+    // ogni componente dell'accelerazione g = -grad(phi) viene ottenuta nello spazio di Fourier come -i k phi_k
+    for (int d = 0; d < PM_DIM; d++)
+    {
+#pragma omp parallel for schedule(static)
+        for (long int i = 0; i < nGrid; i++)
+        {
+            int n[PM_DIM] = {(int)(i / ((long int)pmMesh * pmMesh)), (int)(i / pmMesh % pmMesh), (int)(i % pmMesh)};
+            // la componente di Nyquist non ha un gradiente reale ben definito
+            double k = n[d] == pmMesh / 2 ? 0. : wave_number(n[d]);
+
+            // per il PM puro si usa la differenza finita centrata, il cui simbolo è sin(k h) / h
+            if (!pmShortRange)
+                k = sin(k * pmCell) / pmCell;
+
+            work[2 * i] = k * phiK[2 * i + 1];
+            work[2 * i + 1] = -k * phiK[2 * i];
+        }
+
+        fft_3d(work, 1);
+
+#pragma omp parallel for schedule(static)
+        for (int j = 0; j < nBodies; j++)
+        {
+            force[d + j * PM_DIM] = G * masses[j] * cic_interpolate(coord + j * PM_DIM) / nGrid;
+        }
+    }
+
+    if (pmShortRange)
+    {
+        short_range(coord, masses, G, nBodies, force);
+    }
+}
+
+long double pm_epot(const long double *coord, const long double *masses, const long double G, const int nBodies)
+{
+    long int nGrid = (long int)pmMesh * pmMesh * pmMesh;
+    long double potEnergyTot = 0.L;
+
+    pm_solve(coord, masses, nBodies);
+
+    for (long int i = 0; i < 2 * nGrid; i++)
+    {
+        work[i] = phiK[i];
+    }
+
+    fft_3d(work, 1);
+
+    for (int j = 0; j < nBodies; j++)
+    {
+        potEnergyTot += 0.5L * G * masses[j] * cic_interpolate(coord + j * PM_DIM) / nGrid;
+    }
+
+    if (pmShortRange)
+    {
+        potEnergyTot += short_range(coord, masses, G, nBodies, NULL);
+
+        // il potenziale filtrato di ogni corpo vale -G m / (rsplit sqrt(pi)) nella sua stessa posizione: si rimuove l'autointerazione
+        for (int j = 0; j < nBodies; j++)
+        {
+            potEnergyTot += 0.5L * G * masses[j] * masses[j] / (pmRsplit * sqrtl(M_PI));
+        }
+    }
+    else
+    {
+        // Nel PM puro si toglie l'intero potenziale di ogni corpo su sé stesso attraverso la griglia e si aggiunge quello delle sue
+        // immagini periodiche, che il P3M conserva: le energie dei due motori restano così confrontabili.
+        for (int j = 0; j < nBodies; j++)
+        {
+            potEnergyTot -= 0.5L * G * masses[j] * masses[j] * (pm_self_potential(coord + j * PM_DIM) - PM_MADELUNG / pmBox);
+        }
+    }
+
+    return potEnergyTot;
+}
+
+void pm_free(void)
+{
+    free(phiK);
+    free(work);
+    free(greenK);
+    free(lineBuf);
+    free(twiddle);
+    free(bitrev);
+    free(cellHead);
+    free(cellNext);
+
+    phiK = work = greenK = lineBuf = twiddle = NULL;
+    bitrev = cellHead = cellNext = NULL;
+}
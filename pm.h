@@ -0,0 +1,56 @@
+#ifndef PM_H
+#define PM_H
+
+/**
+ * Funzione che prepara il motore di forza particle-mesh (PM) per un sistema periodico in una scatola cubica di lato box.
+ * Alloca una volta sola le griglie necessarie (densità, potenziale e buffer per la FFT), che vengono poi riutilizzate ad ogni
+ * chiamata di pm_force e pm_epot.
+ *
+ * @param nBodies Numero intero del numero di corpi considerato nel sistema.
+ * @param spatialDim Dimensione spaziale del sistema (il metodo PM è implementato solo per 3 dimensioni).
+ * @param mesh Numero di celle della griglia per lato (deve essere una potenza di 2).
+ * @param box Lato della scatola periodica.
+ * @param rsplit Scala di separazione tra la parte a lungo raggio (griglia) e quella a corto raggio (somma diretta) della forza.
+ * Viene utilizzata solo se shortRange è diverso da 0.
+ * @param shortRange Se diverso da 0 attiva la correzione diretta a corto raggio (P3M).
+ *
+ * @return -1 in caso di errore, 0 di default.
+ *
+ * @note Le risorse allocate vanno liberate con pm_free().
+ */
+int pm_setup(const int nBodies, const int spatialDim, const int mesh, const long double box, const long double rsplit, const int shortRange);
+
+/**
+ * Funzione che calcola le forze gravitazionali periodiche tramite il metodo particle-mesh: assegnazione delle masse alla griglia
+ * (CIC), risoluzione dell'equazione di Poisson con la FFT e interpolazione delle forze sui corpi. Se attivata in pm_setup aggiunge
+ * la correzione diretta a corto raggio (P3M).
+ * Rispetta l'interfaccia del puntatore a funzione richiesto da velverlet_ndim_npart.
+ *
+ * @param coord Puntatore al vettore di long double contenente le posizioni dei corpi un corpo alla volta: x11, x12, ..., x21, ...
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi nel sistema.
+ * @param G Costante di gravitazione considerata per il calcolo della forza gravitazionale.
+ * @param nBodies Numero di corpi che compongono il sistema considerato.
+ * @param force Puntatore al vettore di long double in cui salvare la risultante delle forze su ciascun corpo.
+ */
+void pm_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
+
+/**
+ * Funzione che calcola l'energia potenziale periodica del sistema in modo consistente con le forze di pm_force. L'interazione di ogni
+ * corpo con sé stesso viene rimossa in entrambi i motori (nel PM puro quella attraverso la griglia, che dipende dalla posizione nella
+ * cella), mentre resta quella con le sue immagini periodiche, quindi PM e P3M danno energie confrontabili.
+ *
+ * @param coord Puntatore al vettore di long double contenente le coordinate spaziali dei corpi.
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi.
+ * @param G costante di gravitazione considerata.
+ * @param nBodies Numero intero del numero di corpi del sistema.
+ *
+ * @return Valore long double dell'energia potenziale.
+ */
+long double pm_epot(const long double *coord, const long double *masses, const long double G, const int nBodies);
+
+/**
+ * Funzione che libera le griglie allocate da pm_setup.
+ */
+void pm_free(void);
+
+#endif
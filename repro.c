@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "repro.h"
+
+// sotto questo numero di corpi le forze e le energie vengono calcolate da un solo thread (il risultato non cambia)
+#define REPRO_PARALLEL_MIN 256
+
+static int dim = 0;
+static long double *perBody = NULL; // contributo di ogni corpo alle energie
+static long double *partial = NULL; // somme dei blocchi
+
+int repro_setup(const int nBodies, const int spatialDim)
+{
+    if (spatialDim > REPRO_MAX_DIM)
+    {
+        fprintf(stderr, "\nLe somme riproducibili richiedono una dimensione spaziale al più %d.\n\n", REPRO_MAX_DIM);
+        return -1;
+    }
+
+    dim = spatialDim;
+
+    perBody = (long double *)malloc(nBodies * sizeof(long double));
+    partial = (long double *)malloc((nBodies / REPRO_BLOCK + 1) * sizeof(long double));
+
+    if (!perBody || !partial)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        repro_free();
+        return -1;
+    }
+
+    return 0;
+}
+
+long double repro_sum(const long double *values, const int n)
+{
+    int nBlocks = (n + REPRO_BLOCK - 1) / REPRO_BLOCK;
+
+    if (nBlocks == 0)
+    {
+        return 0.L;
+    }
+
+#pragma omp parallel for if (n >= REPRO_PARALLEL_MIN) schedule(static)
+    for (int b = 0; b < nBlocks; b++)
+    {
+        int end = (b + 1) * REPRO_BLOCK < n ? (b + 1) * REPRO_BLOCK : n;
+        long double sum = 0.L;
+
+        for (int i = b * REPRO_BLOCK; i < end; i++)
+        {
+            sum += values[i];
+        }
+
+        partial[b] = sum;
+    }
+
+    // albero binario fisso sulle somme dei blocchi
+    for (int stride = 1; stride < nBlocks; stride *= 2)
+    {
+        for (int b = 0; b + stride < nBlocks; b += 2 * stride)
+        {
+            partial[b] += partial[b + stride];
+        }
+    }
+
+    return partial[0];
+}
+
+void repro_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+#pragma omp parallel for if (nBodies >= REPRO_PARALLEL_MIN) schedule(static)
+    for (int i = 0; i < nBodies; i++)
+    {
+        long double fi[REPRO_MAX_DIM];
+
+        for (int k = 0; k < dim; k++)
+        {
+            fi[k] = 0.L;
+        }
+
+        for (int j = 0; j < nBodies; j++)
+        {
+            if (j == i)
+            {
+                continue;
+            }
+
+            long double vec_d[REPRO_MAX_DIM], d2 = 0.L;
+
+            for (int k = 0; k < dim; k++)
+            {
+                vec_d[k] = coord[k + i * dim] - coord[k + j * dim];
+                d2 += vec_d[k] * vec_d[k];
+            }
+
+            long double factor = -G * masses[i] * masses[j] / (d2 * sqrtl(d2));
+
+            for (int k = 0; k < dim; k++)
+            {
+                fi[k] += factor * vec_d[k];
+            }
+        }
+
+        for (int k = 0; k < dim; k++)
+        {
+            force[k + i * dim] = fi[k];
+        }
+    }
+}
+
+long double repro_ekin(const long double *vel, const long double *masses, const int nBodies)
+{
+#pragma omp parallel for if (nBodies >= REPRO_PARALLEL_MIN) schedule(static)
+    for (int i = 0; i < nBodies; i++)
+    {
+        long double v2 = 0.L;
+
+        for (int k = 0; k < dim; k++)
+        {
+            v2 += vel[k + i * dim] * vel[k + i * dim];
+        }
+
+        perBody[i] = 0.5L * masses[i] * v2;
+    }
+
+    return repro_sum(perBody, nBodies);
+}
+
+long double repro_epot(const long double *coord, const long double *masses, const long double G, const int nBodies)
+{
+    // le righe del triangolo j > i hanno lunghezze diverse, quindi conviene una distribuzione dinamica (che non cambia il risultato)
+#pragma omp parallel for if (nBodies >= REPRO_PARALLEL_MIN) schedule(dynamic, REPRO_BLOCK)
+    for (int i = 0; i < nBodies; i++)
+    {
+        long double sum = 0.L;
+
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            long double d2 = 0.L;
+
+            for (int k = 0; k < dim; k++)
+            {
+                long double diff = coord[k + i * dim] - coord[k + j * dim];
+                d2 += diff * diff;
+            }
+
+            sum += -G * masses[i] * masses[j] / sqrtl(d2);
+        }
+
+        perBody[i] = sum;
+    }
+
+    return repro_sum(perBody, nBodies);
+}
+
+void repro_free(void)
+{
+    free(perBody);
+    free(partial);
+
+    perBody = NULL;
+    partial = NULL;
+}
@@ -0,0 +1,56 @@
+#ifndef REPRO_H
+#define REPRO_H
+
+// Numero di corpi per blocco delle somme riproducibili: i blocchi dipendono solo dal numero di corpi, non dal numero di thread.
+#define REPRO_BLOCK 64
+
+// dimensione spaziale massima, usata per i vettori di appoggio di repro_force
+#define REPRO_MAX_DIM 3
+
+/**
+ * Funzione che prepara le somme riproducibili per un sistema di nBodies corpi in spatialDim dimensioni.
+ *
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema (al più REPRO_MAX_DIM).
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int repro_setup(const int nBodies, const int spatialDim);
+
+/**
+ * Funzione che somma n valori in modo riproducibile: ogni blocco di REPRO_BLOCK valori consecutivi viene sommato in ordine (i blocchi
+ * in parallelo), poi le somme dei blocchi vengono combinate con un albero binario fisso (a coppie di blocchi adiacenti). La forma
+ * della somma dipende solo da n, quindi il risultato è identico bit per bit con qualsiasi numero di thread.
+ *
+ * @param values Puntatore al vettore dei valori.
+ * @param n Numero di valori (al massimo il numero di corpi passato a repro_setup).
+ *
+ * @return Somma dei valori.
+ */
+long double repro_sum(const long double *values, const int n);
+
+/**
+ * Funzione che calcola le forze gravitazionali in parallelo in modo riproducibile: la forza su ogni corpo viene calcolata da un solo
+ * thread sommando i contributi degli altri corpi sempre nello stesso ordine (j crescente). Rinunciando alla terza legge di Newton
+ * ogni coppia viene calcolata due volte, ma non servono somme tra thread diversi e il risultato non dipende dal loro numero.
+ * Rispetta l'interfaccia del puntatore a funzione richiesto da velverlet_ndim_npart.
+ */
+void repro_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
+
+/**
+ * Funzione che calcola l'energia cinetica dei primi nBodies corpi in parallelo, sommando i contributi con repro_sum.
+ */
+long double repro_ekin(const long double *vel, const long double *masses, const int nBodies);
+
+/**
+ * Funzione che calcola l'energia potenziale dei primi nBodies corpi in parallelo: per ogni corpo i si sommano in ordine le coppie
+ * con j > i, poi i contributi dei corpi vengono sommati con repro_sum.
+ */
+long double repro_epot(const long double *coord, const long double *masses, const long double G, const int nBodies);
+
+/**
+ * Funzione che libera la memoria allocata da repro_setup. Non fa nulla se repro_setup non è stata chiamata.
+ */
+void repro_free(void);
+
+#endif
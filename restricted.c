@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "restricted.h"
+
+static int nMassiveBodies = 0;
+static int dim = 0;
+
+int restricted_setup(const int nMassive, const int spatialDim)
+{
+    if (nMassive <= 0 || spatialDim <= 0)
+    {
+        fprintf(stderr, "\nIl problema ristretto richiede almeno un corpo massivo.\n\n");
+        return -1;
+    }
+
+    nMassiveBodies = nMassive;
+    dim = spatialDim;
+
+    return 0;
+}
+
+void restricted_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+    for (int i = 0; i < dim * nMassiveBodies; i++)
+    {
+        force[i] = 0.L;
+    }
+
+    // coppie tra corpi massivi: sono poche, quindi vengono calcolate in seriale con la terza legge di Newton
+    for (int i = 0; i < nMassiveBodies; i++)
+    {
+        for (int j = i + 1; j < nMassiveBodies; j++)
+        {
+            long double d2 = 0.L;
+
+            for (int k = 0; k < dim; k++)
+            {
+                long double diff = coord[k + i * dim] - coord[k + j * dim];
+                d2 += diff * diff;
+            }
+
+            long double factor = -G * masses[i] * masses[j] / (d2 * sqrtl(d2));
+
+            for (int k = 0; k < dim; k++)
+            {
+                long double forceComp = factor * (coord[k + i * dim] - coord[k + j * dim]);
+                force[k + i * dim] += forceComp;
+                force[k + j * dim] -= forceComp;
+            }
+        }
+    }
+
+    // Ogni tracciante scrive solo nelle proprie componenti, quindi i traccianti possono essere aggiornati in parallelo.
+#pragma omp parallel for schedule(static)
+    for (int t = nMassiveBodies; t < nBodies; t++)
+    {
+        for (int k = 0; k < dim; k++)
+        {
+            force[k + t * dim] = 0.L;
+        }
+
+        for (int j = 0; j < nMassiveBodies; j++)
+        {
+            long double d2 = 0.L;
+
+            for (int k = 0; k < dim; k++)
+            {
+                long double diff = coord[k + t * dim] - coord[k + j * dim];
+                d2 += diff * diff;
+            }
+
+            long double factor = -G * masses[t] * masses[j] / (d2 * sqrtl(d2));
+
+            for (int k = 0; k < dim; k++)
+            {
+                force[k + t * dim] += factor * (coord[k + t * dim] - coord[k + j * dim]);
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef RESTRICTED_H
+#define RESTRICTED_H
+
+/**
+ * Funzione che prepara il calcolo della forza per il problema ristretto: i primi nMassive corpi sono massivi, gli altri sono
+ * particelle test (traccianti) che subiscono la gravità dei corpi massivi ma non la esercitano.
+ *
+ * @param nMassive Numero intero dei corpi massivi, che devono occupare le prime posizioni dei vettori.
+ * @param spatialDim Dimensione spaziale in cui si sta considerando il sistema.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int restricted_setup(const int nMassive, const int spatialDim);
+
+/**
+ * Funzione che calcola le forze del problema ristretto con costo O(nMassive * nBodies): le coppie tra corpi massivi sono calcolate
+ * una sola volta come in grav_force, mentre per ogni tracciante (in parallelo) si sommano soltanto i contributi dei corpi massivi.
+ * Le coppie tra traccianti, che darebbero forza nulla, non vengono considerate.
+ * Rispetta l'interfaccia del puntatore a funzione richiesto da velverlet_ndim_npart.
+ *
+ * @param coord Puntatore al vettore di long double contenente le posizioni dei corpi un corpo alla volta: x11, x12, ..., x21, ...
+ * @param masses Puntatore al vettore di long double contenente le masse dei corpi nel sistema. Per i traccianti la massa è usata solo
+ * come massa inerziale (la forza restituita è massa per accelerazione, così che l'integratore ricavi l'accelerazione corretta).
+ * @param G Costante di gravitazione considerata per il calcolo della forza gravitazionale.
+ * @param nBodies Numero di corpi totale (massivi e traccianti).
+ * @param force Puntatore al vettore di long double in cui salvare la risultante delle forze su ciascun corpo.
+ */
+void restricted_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sfc.h"
+
+/**
+ * Chiave di Morton di un corpo, con il suo indice attuale.
+ */
+typedef struct
+{
+    unsigned long long key;
+    int index;
+} SfcKey;
+
+// memoria impostata da sfc_setup: chiavi dei corpi, ordine calcolato da sfc_order (l'indice attuale del corpo che va in ogni
+// posizione), vettori di appoggio per le permutazioni e, per ogni coordinata, minimo e scala del gruppo e valore quantizzato di un corpo
+static int dim = 0;
+static SfcKey *keys = NULL;
+static int *order = NULL;
+static int *indexScratch = NULL;
+static long double *scratch = NULL;
+static long double *low = NULL;
+static long double *scale = NULL;
+static unsigned long long *q = NULL;
+
+int sfc_setup(const int nBodies, const int spatialDim)
+{
+    dim = spatialDim;
+    keys = (SfcKey *)malloc(nBodies * sizeof(SfcKey));
+    order = (int *)malloc(nBodies * sizeof(int));
+    indexScratch = (int *)malloc(nBodies * sizeof(int));
+    scratch = (long double *)malloc(nBodies * spatialDim * sizeof(long double));
+    low = (long double *)malloc(spatialDim * sizeof(long double));
+    scale = (long double *)malloc(spatialDim * sizeof(long double));
+    q = (unsigned long long *)malloc(spatialDim * sizeof(unsigned long long));
+
+    if (!keys || !order || !indexScratch || !scratch || !low || !scale || !q)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        sfc_free();
+        return -1;
+    }
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        order[i] = i;
+    }
+
+    return 0;
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+    const SfcKey *ka = (const SfcKey *)a, *kb = (const SfcKey *)b;
+
+    if (ka->key != kb->key)
+    {
+        return ka->key < kb->key ? -1 : 1;
+    }
+    return (ka->index > kb->index) - (ka->index < kb->index);
+}
+
+void sfc_order(const long double *coord, const int first, const int last)
+{
+    int bits = 63 / dim, n = last - first;
+
+    if (n <= 0)
+    {
+        return;
+    }
+
+    for (int k = 0; k < dim; k++)
+    {
+        long double high = low[k] = coord[k + first * dim];
+
+        for (int i = first + 1; i < last; i++)
+        {
+            long double x = coord[k + i * dim];
+            low[k] = x < low[k] ? x : low[k];
+            high = x > high ? x : high;
+        }
+
+        // il lato massimo viene portato appena sotto 2^bits, così ogni coordinata quantizzata sta in bits bit
+        scale[k] = high > low[k] ? ((long double)(1ULL << bits) - 1.L) / (high - low[k]) : 0.L;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        unsigned long long key = 0;
+
+        for (int k = 0; k < dim; k++)
+        {
+            q[k] = (unsigned long long)((coord[k + (first + i) * dim] - low[k]) * scale[k]);
+        }
+
+        for (int b = bits - 1; b >= 0; b--)
+        {
+            for (int k = 0; k < dim; k++)
+            {
+                key = (key << 1) | ((q[k] >> b) & 1ULL);
+            }
+        }
+
+        keys[i].key = key;
+        keys[i].index = first + i;
+    }
+
+    qsort(keys, n, sizeof(SfcKey), &compare_keys);
+
+    for (int i = 0; i < n; i++)
+    {
+        order[first + i] = keys[i].index;
+    }
+}
+
+void sfc_permute(long double *values, const int nBodies, const int width)
+{
+    for (int i = 0; i < nBodies; i++)
+    {
+        memcpy(scratch + i * width, values + order[i] * width, width * sizeof(long double));
+    }
+
+    memcpy(values, scratch, nBodies * width * sizeof(long double));
+}
+
+void sfc_permute_index(int *index, const int nBodies)
+{
+    for (int i = 0; i < nBodies; i++)
+    {
+        indexScratch[i] = index[order[i]];
+    }
+
+    memcpy(index, indexScratch, nBodies * sizeof(int));
+}
+
+void sfc_free(void)
+{
+    free(keys);
+    free(order);
+    free(indexScratch);
+    free(scratch);
+    free(low);
+    free(scale);
+    free(q);
+
+    keys = NULL;
+    order = NULL;
+    indexScratch = NULL;
+    scratch = NULL;
+    low = NULL;
+    scale = NULL;
+    q = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef SFC_H
+#define SFC_H
+
+/**
+ * Funzione che prepara il riordinamento dei corpi lungo la curva di Morton (Z-order), allocando chiavi e memoria di lavoro.
+ *
+ * @param nBodies Numero massimo di corpi da riordinare.
+ * @param spatialDim Dimensione spaziale del sistema.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ *
+ * @note Le risorse allocate vanno liberate con sfc_free().
+ */
+int sfc_setup(const int nBodies, const int spatialDim);
+
+/**
+ * Funzione che calcola il nuovo ordine dei corpi da first a last - 1: ad ogni corpo viene associata la chiave di Morton delle sue
+ * posizioni, quantizzate nel parallelepipedo che contiene il gruppo con 63 / spatialDim bit per coordinata e intercalate bit per bit,
+ * e i corpi vengono ordinati per chiave (a parità di chiave per indice, così l'ordine è deterministico). Corpi vicini nello spazio
+ * finiscono così vicini nei vettori, e i motori di forza che li visitano per celle (albero dell'FMM, griglia e celle del PM/P3M) leggono
+ * la memoria in modo più regolare. Il nuovo ordine viene applicato ai vettori con sfc_permute e sfc_permute_index.
+ *
+ * @param coord Puntatore alle posizioni dei corpi.
+ * @param first Indice del primo corpo del gruppo.
+ * @param last Indice successivo all'ultimo corpo del gruppo.
+ */
+void sfc_order(const long double *coord, const int first, const int last);
+
+/**
+ * Funzione che applica l'ordine calcolato da sfc_order a un vettore con width valori per corpo.
+ *
+ * @param values Puntatore al vettore da riordinare (nBodies * width elementi).
+ * @param nBodies Numero di corpi.
+ * @param width Numero di valori per corpo (al più spatialDim).
+ */
+void sfc_permute(long double *values, const int nBodies, const int width);
+
+/**
+ * Funzione che applica l'ordine calcolato da sfc_order a un vettore di interi con un valore per corpo (ad esempio gli indici originali
+ * dei corpi).
+ *
+ * @param index Puntatore al vettore da riordinare.
+ * @param nBodies Numero di corpi.
+ */
+void sfc_permute_index(int *index, const int nBodies);
+
+/**
+ * Funzione che libera la memoria allocata da sfc_setup. Non fa nulla se sfc_setup non è stata chiamata.
+ */
+void sfc_free(void);
+
+#endif
@@ -0,0 +1,200 @@
+// shm_open, ftruncate e mmap sono POSIX e non fanno parte di C99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmstream.h"
+
+#define SHM_MAGIC "TBSHM01"
+
+// Le sequenze e il contatore dei frame sono letti e scritti con le operazioni atomiche di gcc/clang: l'ordine release/acquire
+// garantisce che un lettore che vede una sequenza pari veda anche tutti i dati scritti prima di essa.
+#define ATOMIC_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+
+static uint64_t *slot_seq(const ShmStream *stream, const uint64_t frame)
+{
+    return (uint64_t *)(stream->slots + (frame % (uint64_t)stream->header->nSlots) * stream->header->slotSize);
+}
+
+ShmStream *shmstream_create(const char *name, const int nBodies, const int spatialDim, const int nSlots)
+{
+    if (nSlots <= 0 || strlen(name) >= sizeof(((ShmStream *)0)->name))
+    {
+        fprintf(stderr, "\nNome o numero di slot non valido per la memoria condivisa.\n\n");
+        return NULL;
+    }
+
+    ShmStream *stream = (ShmStream *)calloc(1, sizeof(ShmStream));
+    if (!stream)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return NULL;
+    }
+
+    uint64_t slotSize = sizeof(uint64_t) +
+                        (1 + SHMSTREAM_ENERGIES + (uint64_t)SHMSTREAM_FIELDS * nBodies * spatialDim) * sizeof(double);
+
+    strcpy(stream->name, name);
+    stream->writer = 1;
+    stream->size = sizeof(ShmHeader) + nSlots * slotSize;
+
+    // un eventuale segmento rimasto da un'esecuzione interrotta viene sostituito
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)stream->size) != 0)
+    {
+        fprintf(stderr, "\nImpossibile creare il segmento di memoria condivisa %s\n\n", name);
+        if (fd >= 0)
+            close(fd);
+        free(stream);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, stream->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "\nImpossibile mappare il segmento di memoria condivisa %s\n\n", name);
+        shm_unlink(name);
+        free(stream);
+        return NULL;
+    }
+
+    // ftruncate azzera il segmento, quindi tutte le sequenze partono da 0 (nessun frame)
+    stream->header = (ShmHeader *)map;
+    stream->slots = (unsigned char *)map + sizeof(ShmHeader);
+    stream->header->nBodies = nBodies;
+    stream->header->spatialDim = spatialDim;
+    stream->header->nSlots = nSlots;
+    stream->header->finished = 0;
+    stream->header->slotSize = slotSize;
+    stream->header->published = 0;
+
+    // il magic viene scritto per ultimo: un lettore che lo trova può fidarsi del resto dell'intestazione
+    char magic[8] = SHM_MAGIC;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(stream->header->magic, magic, sizeof(magic));
+
+    return stream;
+}
+
+void shmstream_publish(ShmStream *stream, const long double time, const long double *coord, const long double *vel, const long double *acc,
+                       const long double *energies)
+{
+    uint64_t frame = stream->header->published;
+    uint64_t *seq = slot_seq(stream, frame);
+    double *data = (double *)(seq + 1);
+    long int perField = (long int)stream->header->nBodies * stream->header->spatialDim;
+    const long double *fields[SHMSTREAM_FIELDS] = {coord, vel, acc};
+
+    ATOMIC_STORE(seq, 2 * frame + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    *data++ = (double)time;
+    for (int e = 0; e < SHMSTREAM_ENERGIES; e++)
+    {
+        *data++ = (double)energies[e];
+    }
+    for (int f = 0; f < SHMSTREAM_FIELDS; f++)
+    {
+        for (long int i = 0; i < perField; i++)
+        {
+            *data++ = (double)fields[f][i];
+        }
+    }
+
+    ATOMIC_STORE(seq, 2 * frame + 2);
+    ATOMIC_STORE(&stream->header->published, frame + 1);
+}
+
+ShmStream *shmstream_attach(const char *name)
+{
+    if (strlen(name) >= sizeof(((ShmStream *)0)->name))
+    {
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat info;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ShmHeader))
+    {
+        map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    ShmStream *stream = (ShmStream *)calloc(1, sizeof(ShmStream));
+    if (!stream || memcmp(((ShmHeader *)map)->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0)
+    {
+        munmap(map, (size_t)info.st_size);
+        free(stream);
+        return NULL;
+    }
+
+    strcpy(stream->name, name);
+    stream->writer = 0;
+    stream->size = (size_t)info.st_size;
+    stream->header = (ShmHeader *)map;
+    stream->slots = (unsigned char *)map + sizeof(ShmHeader);
+
+    return stream;
+}
+
+const double *shmstream_latest(const ShmStream *stream, uint64_t *frame, uint64_t *seq)
+{
+    uint64_t published = ATOMIC_LOAD(&stream->header->published);
+    if (published == 0)
+    {
+        return NULL;
+    }
+
+    *frame = published - 1;
+    const uint64_t *slotSeq = slot_seq(stream, *frame);
+    *seq = ATOMIC_LOAD(slotSeq);
+
+    if (*seq != 2 * *frame + 2)
+    {
+        return NULL;
+    }
+
+    return (const double *)(slotSeq + 1);
+}
+
+int shmstream_valid(const ShmStream *stream, const uint64_t frame, const uint64_t seq)
+{
+    // la barriera impedisce che le letture dei dati vengano spostate dopo la seconda lettura della sequenza
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return ATOMIC_LOAD(slot_seq(stream, frame)) == seq;
+}
+
+void shmstream_close(ShmStream *stream)
+{
+    if (!stream)
+        return;
+
+    if (stream->writer)
+    {
+        ATOMIC_STORE(&stream->header->finished, 1);
+        shm_unlink(stream->name);
+    }
+
+    munmap(stream->header, stream->size);
+    free(stream);
+}
@@ -0,0 +1,114 @@
+#ifndef SHMSTREAM_H
+#define SHMSTREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// numero di slot di default del buffer circolare
+#define SHMSTREAM_DEFAULT_SLOTS 64
+
+// campi per corpo (coord, vel, acc) ed energie (cinetica, potenziale, totale) pubblicati in ogni frame
+#define SHMSTREAM_FIELDS 3
+#define SHMSTREAM_ENERGIES 3
+
+/**
+ * Intestazione del segmento di memoria condivisa, seguita da nSlots slot di slotSize byte ciascuno.
+ *
+ * Ogni slot contiene: numero di sequenza (uint64), tempo fisico (double), energie (SHMSTREAM_ENERGIES double), poi coord, vel e acc
+ * (nBodies * spatialDim double ciascuno). Il frame numero f (a partire da 0) viene scritto nello slot f % nSlots.
+ *
+ * Protocollo (un solo scrittore, lettori senza lock): lo scrittore porta la sequenza dello slot a 2f + 1 (dispari, scrittura in corso),
+ * copia i dati, la porta a 2f + 2 e infine aggiorna published a f + 1. Un lettore legge published, legge la sequenza dello slot
+ * desiderato, legge i dati direttamente dalla memoria condivisa e rilegge la sequenza: il frame è valido se le due letture sono uguali
+ * e pari a 2f + 2, altrimenti è stato sovrascritto durante la lettura e va riletto (o si passa a un frame più recente).
+ */
+typedef struct
+{
+    char magic[8];
+    int32_t nBodies;
+    int32_t spatialDim;
+    int32_t nSlots;
+    int32_t finished;
+    uint64_t slotSize;
+    uint64_t published;
+} ShmHeader;
+
+/**
+ * Struct che rappresenta il segmento di memoria condivisa mappato dallo scrittore o da un lettore.
+ */
+typedef struct
+{
+    char name[256];
+    int writer;
+    size_t size;
+    ShmHeader *header;
+    unsigned char *slots;
+} ShmStream;
+
+/**
+ * Funzione che crea (o ricrea) il segmento di memoria condivisa e lo mappa per la scrittura.
+ *
+ * @param name Nome POSIX del segmento (ad esempio "/threebody").
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param nSlots Numero di frame mantenuti nel buffer circolare.
+ *
+ * @return Puntatore alla struct allocata, NULL in caso di errore. Va chiusa con shmstream_close().
+ */
+ShmStream *shmstream_create(const char *name, const int nBodies, const int spatialDim, const int nSlots);
+
+/**
+ * Funzione che pubblica un frame nel buffer circolare. Non attende mai i lettori.
+ *
+ * @param stream Puntatore alla struct creata con shmstream_create.
+ * @param time Tempo fisico del frame.
+ * @param coord Puntatore al vettore delle posizioni dei corpi.
+ * @param vel Puntatore al vettore delle velocità dei corpi.
+ * @param acc Puntatore al vettore delle accelerazioni dei corpi.
+ * @param energies Puntatore al vettore di SHMSTREAM_ENERGIES energie (cinetica, potenziale e totale).
+ */
+void shmstream_publish(ShmStream *stream, const long double time, const long double *coord, const long double *vel, const long double *acc,
+                       const long double *energies);
+
+/**
+ * Funzione che si collega in sola lettura a un segmento creato da shmstream_create.
+ *
+ * @param name Nome POSIX del segmento.
+ *
+ * @return Puntatore alla struct allocata, NULL in caso di errore. Va chiusa con shmstream_close().
+ */
+ShmStream *shmstream_attach(const char *name);
+
+/**
+ * Funzione che restituisce il puntatore allo slot dell'ultimo frame pubblicato, da leggere direttamente in memoria condivisa.
+ * Dopo la lettura va chiamata shmstream_valid per sapere se il frame è stato sovrascritto nel frattempo.
+ *
+ * @param stream Puntatore alla struct collegata con shmstream_attach.
+ * @param frame Puntatore in cui salvare il numero del frame.
+ * @param seq Puntatore in cui salvare la sequenza letta prima dei dati.
+ *
+ * @return Puntatore al tempo del frame, seguito nell'ordine da energie, coord, vel e acc (si veda ShmHeader). NULL se non è ancora
+ * stato pubblicato alcun frame o se lo slot è in scrittura.
+ */
+const double *shmstream_latest(const ShmStream *stream, uint64_t *frame, uint64_t *seq);
+
+/**
+ * Funzione che controlla se lo slot letto dopo shmstream_latest contiene ancora il frame atteso.
+ *
+ * @param stream Puntatore alla struct collegata con shmstream_attach.
+ * @param frame Numero del frame restituito da shmstream_latest.
+ * @param seq Sequenza restituita da shmstream_latest.
+ *
+ * @return 1 se i dati letti sono consistenti, 0 se vanno riletti.
+ */
+int shmstream_valid(const ShmStream *stream, const uint64_t frame, const uint64_t seq);
+
+/**
+ * Funzione che smappa il segmento e libera la struct. Se chiamata dallo scrittore segna il flusso come terminato e rimuove il nome
+ * del segmento (i lettori già collegati continuano a vedere gli ultimi frame).
+ *
+ * @param stream Puntatore alla struct (può essere NULL).
+ */
+void shmstream_close(ShmStream *stream);
+
+#endif
@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "shooting.h"
+#include "lyapunov.h"
+
+/**
+ * Memoria di lavoro di un candidato, allocata dal thread che lo risolve:
+ * - nB, dim : numero di corpi e dimensione spaziale;
+ * - n : numero di posizioni (nB * dim), len : numero di componenti dello stato (2 n), m : numero di incognite (len + 1, con il periodo);
+ * - coord, vel, force, fNew : stato durante l'integrazione e forza nelle posizioni nuove;
+ * - tangents : len vettori tangenti di 3 n componenti (dx, dv e dF = J dx, come in lyapunov.c);
+ * - dForceNew : variazioni della forza nelle posizioni nuove, n componenti per vettore;
+ * - z, r, jac : incognite, residuo e jacobiano (len righe e m colonne, per colonne) correnti;
+ * - zTrial, rTrial, jacTrial : gli stessi per il passo di prova;
+ * - normalJ : sistema aumentato (m righe e m + 1 colonne) delle equazioni normali J^T J dz = -J^T r, calcolato una volta per iterazione;
+ * - normal : copia di normalJ a cui viene aggiunto lo smorzamento, risolta per ogni passo di prova.
+ */
+typedef struct
+{
+    int nB, dim, n, len, m;
+    long double *coord, *vel, *force, *fNew, *tangents, *dForceNew;
+    long double *z, *r, *jac, *zTrial, *rTrial, *jacTrial, *normalJ, *normal;
+} Workspace;
+
+/**
+ * Funzione che alloca la memoria di lavoro di un candidato in un solo blocco.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+static int workspace_alloc(Workspace *w, const int nBodies, const int spatialDim)
+{
+    w->nB = nBodies;
+    w->dim = spatialDim;
+    w->n = nBodies * spatialDim;
+    w->len = 2 * w->n;
+    w->m = w->len + 1;
+
+    int n = w->n, len = w->len, m = w->m;
+    long double *block = (long double *)malloc((4 * n + 3 * n * len + n * len + 2 * (m + len + len * m) + 2 * m * (m + 1)) *
+                                               sizeof(long double));
+    if (!block)
+    {
+        return -1;
+    }
+
+    w->coord = block;
+    w->vel = w->coord + n;
+    w->force = w->vel + n;
+    w->fNew = w->force + n;
+    w->tangents = w->fNew + n;
+    w->dForceNew = w->tangents + 3 * n * len;
+    w->z = w->dForceNew + n * len;
+    w->r = w->z + m;
+    w->jac = w->r + len;
+    w->zTrial = w->jac + len * m;
+    w->rTrial = w->zTrial + m;
+    w->jacTrial = w->rTrial + len;
+    w->normalJ = w->jacTrial + len * m;
+    w->normal = w->normalJ + m * (m + 1);
+
+    return 0;
+}
+
+/**
+ * Funzione che integra lo stato z (posizioni, velocità e periodo) per nSteps passi di durata periodo / nSteps e calcola il residuo
+ * r = Phi(x0, P) - x0 e, se jac non è NULL, il suo jacobiano [M - I, f(Phi)]. Il passo e la sua mappa tangente sono quelli di
+ * lyapunov_steps.
+ *
+ * @return Norma del residuo (infinito se l'integrazione diverge o il periodo non è positivo).
+ */
+static long double shoot(Workspace *w, const long double *masses, const long double G, const long int nSteps, const long double *z,
+                         long double *r, long double *jac)
+{
+    int n = w->n, len = w->len, dim = w->dim, nVec = jac ? len : 0;
+    long double h = z[len] / nSteps;
+
+    if (!(h > 0))
+    {
+        return INFINITY;
+    }
+
+    memcpy(w->coord, z, n * sizeof(long double));
+    memcpy(w->vel, z + n, n * sizeof(long double));
+
+    // il vettore tangente c parte dal versore della componente c dello stato, quindi alla fine è la colonna c di M
+    for (int c = 0; c < nVec; c++)
+    {
+        long double *t = w->tangents + c * 3 * n;
+        for (int i = 0; i < 2 * n; i++)
+        {
+            t[i] = i == c ? 1.L : 0.L;
+        }
+    }
+    lyapunov_force_tangent(w->nB, dim, w->coord, masses, G, w->force, nVec, w->tangents, 3 * n, w->tangents + 2 * n, 3 * n);
+
+    for (long int s = 0; s < nSteps; s++)
+    {
+        for (int j = 0; j < w->nB; j++)
+        {
+            long double c = 1.L / (2.L * masses[j]) * h * h;
+
+            for (int k = j * dim; k < (j + 1) * dim; k++)
+            {
+                w->coord[k] = w->coord[k] + h * w->vel[k] + c * w->force[k];
+            }
+
+            for (int v = 0; v < nVec; v++)
+            {
+                long double *t = w->tangents + v * 3 * n;
+
+                for (int k = j * dim; k < (j + 1) * dim; k++)
+                {
+                    t[k] += h * t[n + k] + c * t[2 * n + k];
+                }
+            }
+        }
+
+        lyapunov_force_tangent(w->nB, dim, w->coord, masses, G, w->fNew, nVec, w->tangents, 3 * n, w->dForceNew, n);
+
+        for (int j = 0; j < w->nB; j++)
+        {
+            long double c = 1.L / (2.L * masses[j]) * h;
+
+            for (int k = j * dim; k < (j + 1) * dim; k++)
+            {
+                w->vel[k] = w->vel[k] + c * (w->force[k] + w->fNew[k]);
+                w->force[k] = w->fNew[k];
+            }
+
+            for (int v = 0; v < nVec; v++)
+            {
+                long double *t = w->tangents + v * 3 * n;
+                const long double *dfNew = w->dForceNew + v * n;
+
+                for (int k = j * dim; k < (j + 1) * dim; k++)
+                {
+                    t[n + k] += c * (t[2 * n + k] + dfNew[k]);
+                    t[2 * n + k] = dfNew[k];
+                }
+            }
+        }
+    }
+
+    long double norm = 0.L;
+    for (int i = 0; i < n; i++)
+    {
+        r[i] = w->coord[i] - z[i];
+        r[n + i] = w->vel[i] - z[n + i];
+    }
+    for (int i = 0; i < len; i++)
+    {
+        norm += r[i] * r[i];
+    }
+
+    if (!isfinite(norm))
+    {
+        return INFINITY;
+    }
+
+    for (int c = 0; c < nVec; c++)
+    {
+        const long double *t = w->tangents + c * 3 * n;
+        for (int i = 0; i < len; i++)
+        {
+            jac[i + c * len] = t[i] - (i == c ? 1.L : 0.L);
+        }
+    }
+    // la derivata dello stato finale rispetto al periodo è il campo nello stato finale (velocità e accelerazioni)
+    for (int j = 0; jac && j < w->nB; j++)
+    {
+        for (int k = j * dim; k < (j + 1) * dim; k++)
+        {
+            jac[k + len * len] = w->vel[k];
+            jac[n + k + len * len] = w->force[k] / masses[j];
+        }
+    }
+
+    return sqrtl(norm);
+}
+
+/**
+ * Funzione che risolve il sistema aumentato di m righe e m + 1 colonne (salvato per righe) con l'eliminazione di Gauss con pivoting
+ * parziale, lasciando la soluzione nell'ultima colonna.
+ *
+ * @return -1 se la matrice è singolare, 0 di default.
+ */
+static int solve_linear(const int m, long double *aug)
+{
+    int w = m + 1;
+
+    for (int col = 0; col < m; col++)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < m; row++)
+        {
+            if (fabsl(aug[row * w + col]) > fabsl(aug[pivot * w + col]))
+            {
+                pivot = row;
+            }
+        }
+
+        if (aug[pivot * w + col] == 0.L)
+        {
+            return -1;
+        }
+
+        for (int k = 0; k < w && pivot != col; k++)
+        {
+            long double tmp = aug[col * w + k];
+            aug[col * w + k] = aug[pivot * w + k];
+            aug[pivot * w + k] = tmp;
+        }
+
+        for (int row = col + 1; row < m; row++)
+        {
+            long double f = aug[row * w + col] / aug[col * w + col];
+            for (int k = col; k < w; k++)
+            {
+                aug[row * w + k] -= f * aug[col * w + k];
+            }
+        }
+    }
+
+    for (int row = m - 1; row >= 0; row--)
+    {
+        long double x = aug[row * w + m];
+        for (int k = row + 1; k < m; k++)
+        {
+            x -= aug[row * w + k] * aug[k * w + m];
+        }
+        aug[row * w + m] = x / aug[row * w + row];
+    }
+
+    return 0;
+}
+
+/**
+ * Funzione che applica Levenberg-Marquardt a un candidato (vedere shooting_solve).
+ */
+static void solve_candidate(Workspace *w, const long double *masses, const long double G, const long int nSteps, ShootingCandidate *cand)
+{
+    int len = w->len, m = w->m;
+
+    memcpy(w->z, cand->state, len * sizeof(long double));
+    w->z[len] = cand->period;
+
+    long double res = shoot(w, masses, G, nSteps, w->z, w->r, w->jac), mu = -1.L;
+    cand->iterations = 0;
+    cand->converged = 0;
+
+    while (cand->iterations < SHOOTING_MAX_ITER && isfinite(res))
+    {
+        long double stateNorm = 0.L;
+        for (int i = 0; i < len; i++)
+        {
+            stateNorm += w->z[i] * w->z[i];
+        }
+
+        if (res <= SHOOTING_TOL * (1.L + sqrtl(stateNorm)))
+        {
+            cand->converged = 1;
+            break;
+        }
+
+        // equazioni normali J^T J dz = -J^T r, con i prodotti scalari tra le colonne calcolati una sola volta per iterazione
+        long double maxDiag = 0.L;
+        for (int a = 0; a < m; a++)
+        {
+            for (int b = 0; b <= a; b++)
+            {
+                long double dot = 0.L;
+                for (int i = 0; i < len; i++)
+                {
+                    dot += w->jac[i + a * len] * w->jac[i + b * len];
+                }
+                w->normalJ[a * (m + 1) + b] = w->normalJ[b * (m + 1) + a] = dot;
+            }
+
+            long double g = 0.L;
+            for (int i = 0; i < len; i++)
+            {
+                g += w->jac[i + a * len] * w->r[i];
+            }
+            w->normalJ[a * (m + 1) + m] = -g;
+
+            maxDiag = w->normalJ[a * (m + 1) + a] > maxDiag ? w->normalJ[a * (m + 1) + a] : maxDiag;
+        }
+
+        if (mu < 0)
+        {
+            mu = 1e-3L * maxDiag;
+        }
+
+        int accepted = 0;
+        while (!accepted && mu <= 1e30L * (maxDiag > 0 ? maxDiag : 1.L))
+        {
+            memcpy(w->normal, w->normalJ, m * (m + 1) * sizeof(long double));
+            for (int a = 0; a < m; a++)
+            {
+                w->normal[a * (m + 1) + a] += mu;
+            }
+
+            if (solve_linear(m, w->normal) == 0)
+            {
+                for (int a = 0; a < m; a++)
+                {
+                    w->zTrial[a] = w->z[a] + w->normal[a * (m + 1) + m];
+                }
+
+                long double trialRes = shoot(w, masses, G, nSteps, w->zTrial, w->rTrial, w->jacTrial);
+                if (trialRes < res)
+                {
+                    long double *tmp = w->z;
+                    w->z = w->zTrial;
+                    w->zTrial = tmp;
+                    tmp = w->r;
+                    w->r = w->rTrial;
+                    w->rTrial = tmp;
+                    tmp = w->jac;
+                    w->jac = w->jacTrial;
+                    w->jacTrial = tmp;
+
+                    res = trialRes;
+                    mu /= 3.L;
+                    accepted = 1;
+                    cand->iterations++;
+                    continue;
+                }
+            }
+
+            mu *= 4.L;
+        }
+
+        // nessun passo riduce il residuo: il candidato si è fermato in un minimo locale
+        if (!accepted)
+        {
+            break;
+        }
+    }
+
+    memcpy(cand->state, w->z, len * sizeof(long double));
+    cand->period = w->z[len];
+    cand->residual = res;
+}
+
+int shooting_solve(const int nBodies, const int spatialDim, const long double *masses, const long double G, const long int nSteps,
+                   ShootingCandidate *candidates, const int nCandidates)
+{
+    int failed = 0, converged = 0;
+
+    if (spatialDim > LYAPUNOV_MAX_DIM)
+    {
+        fprintf(stderr, "\nLa ricerca delle orbite periodiche richiede una dimensione spaziale al più %d.\n\n", LYAPUNOV_MAX_DIM);
+        return -1;
+    }
+
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : failed, converged)
+    for (int c = 0; c < nCandidates; c++)
+    {
+        Workspace w;
+        if (workspace_alloc(&w, nBodies, spatialDim) == -1)
+        {
+            failed++;
+            continue;
+        }
+
+        // i puntatori di w vengono scambiati durante le iterazioni, quindi il blocco va liberato dall'indirizzo iniziale
+        long double *block = w.coord;
+        solve_candidate(&w, masses, G, nSteps, candidates + c);
+        converged += candidates[c].converged;
+        free(block);
+    }
+
+    if (failed > 0)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return -1;
+    }
+
+    return converged;
+}
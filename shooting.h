@@ -0,0 +1,49 @@
+#ifndef SHOOTING_H
+#define SHOOTING_H
+
+// numero massimo di iterazioni accettate di Levenberg-Marquardt per candidato e tolleranza sul residuo, relativa alla norma dello stato
+#define SHOOTING_MAX_ITER 50
+#define SHOOTING_TOL 1e-12L
+
+/**
+ * Candidato orbita periodica:
+ * - state : stato iniziale, prima le nBodies * spatialDim posizioni e poi le velocità (aggiornato dal solutore);
+ * - period : periodo (aggiornato dal solutore);
+ * - residual : norma di Phi(state, period) - state dopo l'ultima iterazione;
+ * - iterations : iterazioni accettate;
+ * - converged : 1 se il residuo è sceso sotto la tolleranza, 0 altrimenti.
+ */
+typedef struct
+{
+    long double *state;
+    long double period;
+    long double residual;
+    int iterations;
+    int converged;
+} ShootingCandidate;
+
+/**
+ * Funzione che cerca orbite periodiche con il metodo di shooting, partendo da nCandidates stati e periodi iniziali. Per ogni candidato
+ * lo stato x0 e il periodo P sono le incognite del sistema Phi(x0, P) - x0 = 0, dove Phi è la mappa di nSteps passi di Velocity
+ * Verlet lunghi P / nSteps con la forza diretta. Ogni integrazione propaga insieme allo stato la matrice di transizione M = dPhi / dx0
+ * (un vettore tangente per ogni componente dello stato, con le equazioni variazionali dello stesso passo usate da lyapunov.c), e lo
+ * jacobiano del residuo è [M - I, f(Phi)], con f il campo (velocità, accelerazioni) nello stato finale. Poiché le simmetrie del problema
+ * (traslazioni, rotazioni, scorrimento lungo l'orbita, famiglie a energia diversa) rendono lo jacobiano singolare, i passi sono quelli
+ * smorzati di Levenberg-Marquardt, (J^T J + mu I) dz = -J^T r, con mu ridotto dopo ogni passo che diminuisce il residuo e aumentato
+ * altrimenti. I candidati sono indipendenti e vengono risolti in parallelo, un thread per candidato, quindi il risultato di ognuno non
+ * dipende dal numero di thread.
+ *
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param masses Puntatore alle masse dei corpi.
+ * @param G Costante di gravitazione.
+ * @param nSteps Numero di passi di integrazione per periodo.
+ * @param candidates Puntatore ai candidati, aggiornati con le soluzioni trovate.
+ * @param nCandidates Numero di candidati.
+ *
+ * @return -1 in caso di errore, altrimenti il numero di candidati convergiti.
+ */
+int shooting_solve(const int nBodies, const int spatialDim, const long double *masses, const long double G, const long int nSteps,
+                   ShootingCandidate *candidates, const int nCandidates);
+
+#endif
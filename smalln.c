@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "smalln.h"
+
+#define SMALLN_DIM 3
+
+/**
+ * Corpo comune dei passi specializzati. Viene chiamato solo con n costante dalle funzioni qui sotto: essendo static inline il
+ * compilatore lo espande in ciascuna di esse e, conoscendo n, srotola completamente tutti i cicli.
+ * Lo stato viene copiato in vettori locali per tutta la durata degli nSteps passi, così che resti nei registri o almeno in cache.
+ * Le espressioni di aggiornamento di posizioni e velocità sono scritte nello stesso ordine di velverlet_ndim_npart.
+ */
+static inline void smalln_steps(const int n, const long double dt, const long double G, const long double *masses, long double *coord,
+                                long double *vel, long double *force, const long int nSteps)
+{
+    long double x[SMALLN_MAX * SMALLN_DIM], v[SMALLN_MAX * SMALLN_DIM], f[SMALLN_MAX * SMALLN_DIM], fNew[SMALLN_MAX * SMALLN_DIM];
+    long double halfInvMass[SMALLN_MAX], Gmm[SMALLN_MAX * SMALLN_MAX];
+
+    for (int j = 0; j < n; j++)
+    {
+        halfInvMass[j] = 1.L / (2.L * masses[j]);
+
+        for (int i = j + 1; i < n; i++)
+        {
+            Gmm[i + j * SMALLN_MAX] = -G * masses[j] * masses[i];
+        }
+    }
+
+    for (int i = 0; i < n * SMALLN_DIM; i++)
+    {
+        x[i] = coord[i];
+        v[i] = vel[i];
+        f[i] = force[i];
+    }
+
+    for (long int s = 0; s < nSteps; s++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            for (int k = 0; k < SMALLN_DIM; k++)
+            {
+                x[k + j * SMALLN_DIM] = x[k + j * SMALLN_DIM] + dt * v[k + j * SMALLN_DIM] + halfInvMass[j] * dt * dt * f[k + j * SMALLN_DIM];
+            }
+        }
+
+        for (int i = 0; i < n * SMALLN_DIM; i++)
+        {
+            fNew[i] = 0.L;
+        }
+
+        // differenza e distanza calcolate insieme per ogni coppia, ogni coppia una sola volta come in grav_force
+        for (int i = 0; i < n; i++)
+        {
+            for (int j = i + 1; j < n; j++)
+            {
+                long double vec_d[SMALLN_DIM], d2 = 0.L;
+
+                for (int k = 0; k < SMALLN_DIM; k++)
+                {
+                    vec_d[k] = x[k + i * SMALLN_DIM] - x[k + j * SMALLN_DIM];
+                    d2 += vec_d[k] * vec_d[k];
+                }
+
+                long double factor = Gmm[j + i * SMALLN_MAX] / (d2 * sqrtl(d2));
+
+                for (int k = 0; k < SMALLN_DIM; k++)
+                {
+                    fNew[k + i * SMALLN_DIM] += factor * vec_d[k];
+                    fNew[k + j * SMALLN_DIM] -= factor * vec_d[k];
+                }
+            }
+        }
+
+        for (int j = 0; j < n; j++)
+        {
+            for (int k = 0; k < SMALLN_DIM; k++)
+            {
+                v[k + j * SMALLN_DIM] = v[k + j * SMALLN_DIM] + halfInvMass[j] * dt * (f[k + j * SMALLN_DIM] + fNew[k + j * SMALLN_DIM]);
+                f[k + j * SMALLN_DIM] = fNew[k + j * SMALLN_DIM];
+            }
+        }
+    }
+
+    for (int i = 0; i < n * SMALLN_DIM; i++)
+    {
+        coord[i] = x[i];
+        vel[i] = v[i];
+        force[i] = f[i];
+    }
+}
+
+static void velverlet_2(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                        long double *force, const long int nSteps)
+{
+    smalln_steps(2, dt, G, masses, coord, vel, force, nSteps);
+}
+
+static void velverlet_3(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                        long double *force, const long int nSteps)
+{
+    smalln_steps(3, dt, G, masses, coord, vel, force, nSteps);
+}
+
+static void velverlet_4(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                        long double *force, const long int nSteps)
+{
+    smalln_steps(4, dt, G, masses, coord, vel, force, nSteps);
+}
+
+static void velverlet_5(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                        long double *force, const long int nSteps)
+{
+    smalln_steps(5, dt, G, masses, coord, vel, force, nSteps);
+}
+
+SmallNStep velverlet_smalln_select(const int nBodies, const int spatialDim)
+{
+    if (spatialDim != SMALLN_DIM)
+    {
+        return NULL;
+    }
+
+    switch (nBodies)
+    {
+    case 2:
+        return &velverlet_2;
+    case 3:
+        return &velverlet_3;
+    case 4:
+        return &velverlet_4;
+    case 5:
+        return &velverlet_5;
+    default:
+        return NULL;
+    }
+}
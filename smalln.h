@@ -0,0 +1,35 @@
+#ifndef SMALLN_H
+#define SMALLN_H
+
+// numero minimo e massimo di corpi per cui esiste un passo specializzato
+#define SMALLN_MIN 2
+#define SMALLN_MAX 5
+
+/**
+ * Puntatore a una funzione che esegue nSteps passi di Velocity Verlet con forza gravitazionale per un numero di corpi fissato
+ * in compilazione (tutti i cicli hanno estremi costanti e vengono srotolati dal compilatore).
+ * Richiede:
+ * - dt : differenziale del tempo utilizzato per l'integrazione numerica;
+ * - G : costante di gravitazione;
+ * - masses : puntatore al vettore delle masse dei corpi;
+ * - coord : puntatore al vettore delle posizioni, aggiornato con le posizioni dopo nSteps passi;
+ * - vel : puntatore al vettore delle velocità, aggiornato con le velocità dopo nSteps passi;
+ * - force : puntatore al vettore delle forze, che in ingresso deve contenere le forze nelle posizioni coord e in uscita contiene le
+ * forze nelle posizioni aggiornate (svolge quindi il ruolo di f_o di velverlet_ndim_npart);
+ * - nSteps : numero di passi da eseguire.
+ */
+typedef void (*SmallNStep)(const long double dt, const long double G, const long double *masses, long double *coord, long double *vel,
+                           long double *force, const long int nSteps);
+
+/**
+ * Funzione che sceglie il passo specializzato per il numero di corpi e di dimensioni del sistema.
+ *
+ * @param nBodies Numero intero del numero di corpi considerato nel sistema.
+ * @param spatialDim Dimensione spaziale in cui si sta considerando il sistema.
+ *
+ * @return Puntatore al passo specializzato, NULL se non ne esiste uno (nBodies fuori da [SMALLN_MIN, SMALLN_MAX] o spatialDim
+ * diverso da 3). In quel caso va utilizzato velverlet_ndim_npart.
+ */
+SmallNStep velverlet_smalln_select(const int nBodies, const int spatialDim);
+
+#endif
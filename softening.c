@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "softening.h"
+
+// configurazione impostata da softening_setup
+static int softKernel = SOFTENING_NONE;
+static long double eps = 0.L;
+static int dim = 0;
+
+int softening_setup(const int kernel, const long double length, const int spatialDim)
+{
+    if (spatialDim > SOFTENING_MAX_DIM)
+    {
+        fprintf(stderr, "\nIl softening richiede una dimensione spaziale al più %d.\n\n", SOFTENING_MAX_DIM);
+        return -1;
+    }
+
+    softKernel = kernel;
+    eps = length;
+    dim = spatialDim;
+
+    return 0;
+}
+
+/**
+ * Funzione che restituisce il fattore g(d) tale che la forza su i dovuta a j sia -G m_i m_j g(d) (x_i - x_j): 1 / d^3 senza softening.
+ */
+static long double force_factor(const long double d2)
+{
+    if (softKernel == SOFTENING_PLUMMER)
+    {
+        long double s2 = d2 + eps * eps;
+        return 1.L / (s2 * sqrtl(s2));
+    }
+
+    long double d = sqrtl(d2);
+    if (d >= eps)
+    {
+        return 1.L / (d2 * d);
+    }
+
+    // spline cubica: per u = d / eps < 1 la forza è un polinomio in u, con un termine 1 / u^3 solo nella parte esterna
+    long double u = d / eps, h3 = eps * eps * eps;
+    if (u < 0.5L)
+    {
+        return (32.L / 3.L + u * u * (32.L * u - 38.4L)) / h3;
+    }
+    return (64.L / 3.L + u * (-48.L + u * (38.4L - 32.L / 3.L * u)) - 1.L / (15.L * u * u * u)) / h3;
+}
+
+/**
+ * Funzione che restituisce il fattore phi(d) tale che l'energia potenziale della coppia sia -G m_i m_j phi(d): 1 / d senza softening.
+ */
+static long double potential_factor(const long double d2)
+{
+    if (softKernel == SOFTENING_PLUMMER)
+    {
+        return 1.L / sqrtl(d2 + eps * eps);
+    }
+
+    long double d = sqrtl(d2);
+    if (d >= eps)
+    {
+        return 1.L / d;
+    }
+
+    long double u = d / eps;
+    if (u < 0.5L)
+    {
+        return (2.8L - u * u * (16.L / 3.L + u * u * (6.4L * u - 9.6L))) / eps;
+    }
+    return (3.2L - 1.L / (15.L * u) - u * u * (32.L / 3.L + u * (-16.L + u * (9.6L - 32.L / 15.L * u)))) / eps;
+}
+
+void softening_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force)
+{
+    for (int i = 0; i < dim * nBodies; i++)
+    {
+        force[i] = 0.L;
+    }
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            long double vec_d[SOFTENING_MAX_DIM], d2 = 0.L;
+
+            for (int k = 0; k < dim; k++)
+            {
+                vec_d[k] = coord[k + i * dim] - coord[k + j * dim];
+                d2 += vec_d[k] * vec_d[k];
+            }
+
+            long double factor = -G * masses[i] * masses[j] * force_factor(d2);
+
+            for (int k = 0; k < dim; k++)
+            {
+                long double forceComp = factor * vec_d[k];
+                force[k + i * dim] += forceComp;
+                force[k + j * dim] -= forceComp;
+            }
+        }
+    }
+}
+
+long double softening_epot(const long double *coord, const long double *masses, const long double G, const int nBodies)
+{
+    long double potEnergy = 0.L;
+
+    for (int i = 0; i < nBodies; i++)
+    {
+        for (int j = i + 1; j < nBodies; j++)
+        {
+            long double d2 = 0.L;
+
+            for (int k = 0; k < dim; k++)
+            {
+                long double diff = coord[k + i * dim] - coord[k + j * dim];
+                d2 += diff * diff;
+            }
+
+            potEnergy += -G * masses[i] * masses[j] * potential_factor(d2);
+        }
+    }
+
+    return potEnergy;
+}
@@ -0,0 +1,41 @@
+#ifndef SOFTENING_H
+#define SOFTENING_H
+
+// nuclei di softening selezionabili con l'header opzionale "softening"
+#define SOFTENING_NONE 0
+#define SOFTENING_PLUMMER 1
+#define SOFTENING_SPLINE 2
+
+// dimensione spaziale massima, usata per i vettori di appoggio di softening_force
+#define SOFTENING_MAX_DIM 3
+
+/**
+ * Funzione che sceglie il nucleo di softening usato da softening_force e softening_epot. Con d distanza tra due corpi ed eps lunghezza
+ * di softening:
+ * - SOFTENING_PLUMMER : potenziale -G m1 m2 / sqrt(d^2 + eps^2), ammorbidito a tutte le distanze;
+ * - SOFTENING_SPLINE : potenziale della spline cubica a supporto compatto (Monaghan e Lattanzio, nella forma usata da GADGET), che
+ * coincide esattamente con quello newtoniano per d >= eps e resta finito per d -> 0. A parità di profondità del potenziale in d = 0,
+ * eps vale circa 2.8 volte la lunghezza di Plummer.
+ * Forza ed energia potenziale usano lo stesso nucleo (la forza è il gradiente del potenziale), quindi l'energia totale resta
+ * conservata a meno dell'errore di integrazione.
+ *
+ * @param kernel Nucleo di softening (SOFTENING_PLUMMER o SOFTENING_SPLINE).
+ * @param length Lunghezza di softening eps (positiva).
+ * @param spatialDim Dimensione spaziale del sistema (al più SOFTENING_MAX_DIM).
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int softening_setup(const int kernel, const long double length, const int spatialDim);
+
+/**
+ * Funzione che calcola le forze gravitazionali ammorbidite con il nucleo scelto da softening_setup. Come grav_force ogni coppia viene
+ * calcolata una sola volta (terza legge di Newton). Rispetta l'interfaccia del puntatore a funzione richiesto da velverlet_ndim_npart.
+ */
+void softening_force(const long double *coord, const long double *masses, const long double G, const int nBodies, long double *force);
+
+/**
+ * Funzione che calcola l'energia potenziale ammorbidita, consistente con softening_force.
+ */
+long double softening_epot(const long double *coord, const long double *masses, const long double G, const int nBodies);
+
+#endif
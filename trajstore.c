@@ -0,0 +1,538 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "trajstore.h"
+
+#define TRAJ_MAGIC "TBTRAJ1"
+#define INDEX_MAGIC "TBIDX01"
+#define MAGIC_LEN 8
+
+// campi salvati per ogni corpo: coord, vel e acc
+#define N_FIELDS 3
+
+// un intero a 64 bit codificato a lunghezza variabile occupa al massimo 10 byte
+#define MAX_VARINT_LEN 10
+
+// modulo massimo dell'intero quantizzato: la previsione 2 * prev1 - prev2 arriva a 3 volte questo valore e il residuo q - previsione
+// a 4 volte, che deve restare sotto 2^63 per non uscire dall'int64_t
+#define MAX_QUANTIZED 2.0e18
+
+/**
+ * Funzione che porta la capacità del buffer *buf ad almeno needed byte, raddoppiandola. Il buffer cresce con i blocchi effettivamente
+ * scritti o letti, che sono di solito molto più piccoli del caso peggiore di MAX_VARINT_LEN byte per valore.
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+static int reserve_chunk(unsigned char **buf, size_t *cap, const size_t needed)
+{
+    if (needed <= *cap)
+        return 0;
+
+    size_t newCap = *cap ? *cap : 4096;
+    while (newCap < needed)
+        newCap *= 2;
+
+    unsigned char *grown = (unsigned char *)realloc(*buf, newCap);
+    if (!grown)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return -1;
+    }
+
+    *buf = grown;
+    *cap = newCap;
+
+    return 0;
+}
+
+static size_t put_varint(unsigned char *out, int64_t value)
+{
+    // zigzag: i numeri piccoli in modulo, positivi o negativi, diventano interi senza segno piccoli
+    uint64_t u = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t n = 0;
+
+    while (u >= 0x80)
+    {
+        out[n++] = (unsigned char)(u | 0x80);
+        u >>= 7;
+    }
+    out[n++] = (unsigned char)u;
+
+    return n;
+}
+
+/**
+ * Funzione che decodifica un intero scritto con put_varint senza leggere oltre end.
+ *
+ * @return Numero di byte letti, 0 se l'intero supera end o MAX_VARINT_LEN byte (file danneggiato).
+ */
+static size_t get_varint(const unsigned char *in, const unsigned char *end, int64_t *value)
+{
+    uint64_t u = 0;
+    size_t n = 0;
+    int bits = 0;
+
+    do
+    {
+        if (n == MAX_VARINT_LEN || in + n >= end)
+            return 0;
+
+        u |= (uint64_t)(in[n] & 0x7f) << bits;
+        bits += 7;
+    } while (in[n++] & 0x80);
+
+    *value = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+
+    return n;
+}
+
+/**
+ * Funzione che restituisce la previsione lineare del valore a partire dai due frame precedenti del blocco.
+ */
+static int64_t predict(const int frameInChunk, const int64_t prev1, const int64_t prev2)
+{
+    if (frameInChunk == 0)
+        return 0;
+    if (frameInChunk == 1)
+        return prev1;
+    return 2 * prev1 - prev2;
+}
+
+static int flush_chunk(TrajStore *store)
+{
+    if (store->chunkFrames == 0)
+        return 0;
+
+    if (store->nChunks == store->capChunks)
+    {
+        long int cap = store->capChunks ? 2 * store->capChunks : 64;
+        uint64_t *offsets = (uint64_t *)realloc(store->indexOffsets, cap * sizeof(uint64_t));
+        if (offsets)
+            store->indexOffsets = offsets;
+        uint64_t *frames = (uint64_t *)realloc(store->indexFrames, cap * sizeof(uint64_t));
+        if (frames)
+            store->indexFrames = frames;
+        double *times = (double *)realloc(store->indexTimes, cap * sizeof(double));
+        if (times)
+            store->indexTimes = times;
+
+        if (!offsets || !frames || !times)
+        {
+            fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+            return -1;
+        }
+        store->capChunks = cap;
+    }
+
+    double firstTime;
+    memcpy(&firstTime, store->chunk, sizeof(double));
+
+    store->indexOffsets[store->nChunks] = (uint64_t)ftell(store->file);
+    store->indexFrames[store->nChunks] = (uint64_t)(store->nFrames - store->chunkFrames);
+    store->indexTimes[store->nChunks] = firstTime;
+    store->nChunks++;
+
+    uint32_t chunkHeader[2] = {(uint32_t)store->chunkFrames, (uint32_t)store->chunkUsed};
+    if (fwrite(chunkHeader, sizeof(uint32_t), 2, store->file) != 2 ||
+        fwrite(store->chunk, 1, store->chunkUsed, store->file) != store->chunkUsed)
+    {
+        fprintf(stderr, "\nErrore nella scrittura del file di traiettoria.\n\n");
+        return -1;
+    }
+
+    store->chunkFrames = 0;
+    store->chunkUsed = 0;
+
+    return 0;
+}
+
+TrajStore *trajstore_create(const char *path, const int nBodies, const int spatialDim, const int framesPerChunk, const double quantum,
+                            const long double *masses)
+{
+    if (framesPerChunk <= 0 || quantum <= 0.)
+    {
+        fprintf(stderr, "\nIl file di traiettoria a blocchi richiede framesPerChunk e quantum positivi.\n\n");
+        return NULL;
+    }
+
+    TrajStore *store = (TrajStore *)calloc(1, sizeof(TrajStore));
+    if (!store)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return NULL;
+    }
+
+    store->nBodies = nBodies;
+    store->spatialDim = spatialDim;
+    store->framesPerChunk = framesPerChunk;
+    store->quantum = quantum;
+    store->nValues = (long int)N_FIELDS * nBodies * spatialDim;
+
+    store->prev1 = (int64_t *)malloc(store->nValues * sizeof(int64_t));
+    store->prev2 = (int64_t *)malloc(store->nValues * sizeof(int64_t));
+    store->file = fopen(path, "wb");
+
+    if (!store->prev1 || !store->prev2 || !store->file)
+    {
+        fprintf(stderr, "\nImpossibile creare il file di traiettoria: %s\n\n", path);
+        trajstore_close(store);
+        return NULL;
+    }
+
+    int32_t header[3] = {nBodies, spatialDim, framesPerChunk};
+    char magic[MAGIC_LEN] = TRAJ_MAGIC;
+    int written = fwrite(magic, 1, MAGIC_LEN, store->file) == MAGIC_LEN && fwrite(header, sizeof(int32_t), 3, store->file) == 3 &&
+                  fwrite(&store->quantum, sizeof(double), 1, store->file) == 1;
+    for (int j = 0; j < nBodies && written; j++)
+    {
+        double m = (double)masses[j];
+        written = fwrite(&m, sizeof(double), 1, store->file) == 1;
+    }
+
+    if (!written)
+    {
+        fprintf(stderr, "\nErrore nella scrittura del file di traiettoria.\n\n");
+        trajstore_close(store);
+        return NULL;
+    }
+
+    return store;
+}
+
+int trajstore_write(TrajStore *store, const long double time, const long double *coord, const long double *vel, const long double *acc)
+{
+    const long double *fields[N_FIELDS] = {coord, vel, acc};
+    long int perField = (long int)store->nBodies * store->spatialDim;
+    size_t maxFrameBytes = sizeof(double) + (size_t)store->nValues * MAX_VARINT_LEN;
+    double t = (double)time;
+
+    if (reserve_chunk(&store->chunk, &store->chunkCap, store->chunkUsed + maxFrameBytes) == -1)
+        return -1;
+
+    unsigned char *out = store->chunk + store->chunkUsed;
+
+    memcpy(out, &t, sizeof(double));
+    out += sizeof(double);
+
+    for (int f = 0; f < N_FIELDS; f++)
+    {
+        for (long int i = 0; i < perField; i++)
+        {
+            long int v = i + f * perField;
+            long double scaled = fields[f][i] / store->quantum;
+
+            if (!(fabsl(scaled) < MAX_QUANTIZED))
+            {
+                fprintf(stderr, "\nValore non rappresentabile con il quantum scelto per il file di traiettoria.\n\n");
+                return -1;
+            }
+
+            int64_t q = (int64_t)llroundl(scaled);
+            out += put_varint(out, q - predict(store->chunkFrames, store->prev1[v], store->prev2[v]));
+            store->prev2[v] = store->prev1[v];
+            store->prev1[v] = q;
+        }
+    }
+
+    store->chunkUsed = (size_t)(out - store->chunk);
+
+    // la lunghezza del blocco viene salvata in 32 bit: un blocco che li supera viene rifiutato invece di essere scritto con una
+    // lunghezza troncata
+    if (store->chunkUsed > UINT32_MAX)
+    {
+        fprintf(stderr, "\nBlocco del file di traiettoria oltre i 4 GiB: ridurre il numero di frame per blocco.\n\n");
+        return -1;
+    }
+    store->chunkFrames++;
+    store->nFrames++;
+
+    if (store->chunkFrames == store->framesPerChunk)
+    {
+        return flush_chunk(store);
+    }
+
+    return 0;
+}
+
+int trajstore_close(TrajStore *store)
+{
+    int result = 0;
+
+    if (!store)
+        return 0;
+
+    if (store->file)
+    {
+        result = flush_chunk(store);
+
+        uint64_t indexOffset = (uint64_t)ftell(store->file);
+        for (long int c = 0; c < store->nChunks && result == 0; c++)
+        {
+            if (fwrite(store->indexOffsets + c, sizeof(uint64_t), 1, store->file) != 1 ||
+                fwrite(store->indexFrames + c, sizeof(uint64_t), 1, store->file) != 1 ||
+                fwrite(store->indexTimes + c, sizeof(double), 1, store->file) != 1)
+            {
+                fprintf(stderr, "\nErrore nella scrittura del file di traiettoria.\n\n");
+                result = -1;
+            }
+        }
+
+        uint64_t trailer[3] = {(uint64_t)store->nChunks, (uint64_t)store->nFrames, indexOffset};
+        char magic[MAGIC_LEN] = INDEX_MAGIC;
+        if (result == 0 &&
+            (fwrite(trailer, sizeof(uint64_t), 3, store->file) != 3 || fwrite(magic, 1, MAGIC_LEN, store->file) != MAGIC_LEN))
+        {
+            fprintf(stderr, "\nErrore nella scrittura del file di traiettoria.\n\n");
+            result = -1;
+        }
+
+        if (fclose(store->file) != 0)
+            result = -1;
+    }
+
+    free(store->prev1);
+    free(store->prev2);
+    free(store->chunk);
+    free(store->indexOffsets);
+    free(store->indexFrames);
+    free(store->indexTimes);
+    free(store);
+
+    return result;
+}
+
+TrajReader *trajreader_open(const char *path)
+{
+    TrajReader *reader = (TrajReader *)calloc(1, sizeof(TrajReader));
+    if (!reader)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        return NULL;
+    }
+
+    reader->file = fopen(path, "rb");
+    if (!reader->file)
+    {
+        fprintf(stderr, "\nImpossibile aprire il file di traiettoria: %s\n\n", path);
+        trajreader_close(reader);
+        return NULL;
+    }
+
+    char magic[MAGIC_LEN];
+    int32_t header[3];
+    if (fread(magic, 1, MAGIC_LEN, reader->file) != MAGIC_LEN || memcmp(magic, TRAJ_MAGIC, MAGIC_LEN) != 0 ||
+        fread(header, sizeof(int32_t), 3, reader->file) != 3 || fread(&reader->quantum, sizeof(double), 1, reader->file) != 1 ||
+        header[0] <= 0 || header[1] <= 0 || header[2] <= 0)
+    {
+        fprintf(stderr, "\nIl file %s non è un file di traiettoria a blocchi valido.\n\n", path);
+        trajreader_close(reader);
+        return NULL;
+    }
+
+    reader->nBodies = header[0];
+    reader->spatialDim = header[1];
+    reader->framesPerChunk = header[2];
+    reader->nValues = (long int)N_FIELDS * reader->nBodies * reader->spatialDim;
+
+    reader->masses = (long double *)malloc(reader->nBodies * sizeof(long double));
+    reader->prev1 = (int64_t *)malloc(reader->nValues * sizeof(int64_t));
+    reader->prev2 = (int64_t *)malloc(reader->nValues * sizeof(int64_t));
+    if (!reader->masses || !reader->prev1 || !reader->prev2)
+    {
+        fprintf(stderr, "\nErrore nell'allocazione dinamica della memoria.\n\n");
+        trajreader_close(reader);
+        return NULL;
+    }
+
+    for (int j = 0; j < reader->nBodies; j++)
+    {
+        double m = 0.;
+        if (fread(&m, sizeof(double), 1, reader->file) != 1)
+        {
+            fprintf(stderr, "\nIl file %s non è un file di traiettoria a blocchi valido.\n\n", path);
+            trajreader_close(reader);
+            return NULL;
+        }
+        reader->masses[j] = m;
+    }
+
+    // la coda a dimensione fissa in fondo al file indica dove si trova l'indice
+    uint64_t trailer[3];
+    if (fseek(reader->file, -(long int)(3 * sizeof(uint64_t) + MAGIC_LEN), SEEK_END) != 0 ||
+        fread(trailer, sizeof(uint64_t), 3, reader->file) != 3 || fread(magic, 1, MAGIC_LEN, reader->file) != MAGIC_LEN ||
+        memcmp(magic, INDEX_MAGIC, MAGIC_LEN) != 0)
+    {
+        fprintf(stderr, "\nIl file %s non contiene l'indice dei frame (la scrittura è stata interrotta?).\n\n", path);
+        trajreader_close(reader);
+        return NULL;
+    }
+
+    reader->nChunks = (long int)trailer[0];
+    reader->nFrames = (long int)trailer[1];
+    reader->indexOffsets = (uint64_t *)malloc((reader->nChunks + 1) * sizeof(uint64_t));
+    reader->indexFrames = (uint64_t *)malloc((reader->nChunks + 1) * sizeof(uint64_t));
+    reader->indexTimes = (double *)malloc((reader->nChunks + 1) * sizeof(double));
+    if (!reader->indexOffsets || !reader->indexFrames || !reader->indexTimes || fseek(reader->file, (long int)trailer[2], SEEK_SET) != 0)
+    {
+        fprintf(stderr, "\nErrore nella lettura dell'indice dei frame.\n\n");
+        trajreader_close(reader);
+        return NULL;
+    }
+
+    for (long int c = 0; c < reader->nChunks; c++)
+    {
+        if (fread(reader->indexOffsets + c, sizeof(uint64_t), 1, reader->file) != 1 ||
+            fread(reader->indexFrames + c, sizeof(uint64_t), 1, reader->file) != 1 ||
+            fread(reader->indexTimes + c, sizeof(double), 1, reader->file) != 1)
+        {
+            fprintf(stderr, "\nErrore nella lettura dell'indice dei frame.\n\n");
+            trajreader_close(reader);
+            return NULL;
+        }
+    }
+
+    return reader;
+}
+
+/**
+ * Funzione che decodifica il blocco chunkIdx fino al frame frameInChunk compreso, fermandosi prima se un frame ha tempo maggiore
+ * di maxTime. I valori quantizzati dell'ultimo frame decodificato restano in reader->prev1.
+ *
+ * @return Indice nel blocco dell'ultimo frame decodificato, -1 in caso di errore.
+ */
+static int decode_chunk(TrajReader *reader, const long int chunkIdx, const int frameInChunk, const double maxTime, double *time)
+{
+    uint32_t chunkHeader[2];
+
+    if (fseek(reader->file, (long int)reader->indexOffsets[chunkIdx], SEEK_SET) != 0 ||
+        fread(chunkHeader, sizeof(uint32_t), 2, reader->file) != 2)
+    {
+        fprintf(stderr, "\nErrore nella lettura di un blocco del file di traiettoria.\n\n");
+        return -1;
+    }
+
+    if (reserve_chunk(&reader->chunk, &reader->chunkCap, chunkHeader[1]) == -1)
+        return -1;
+
+    if (fread(reader->chunk, 1, chunkHeader[1], reader->file) != chunkHeader[1])
+    {
+        fprintf(stderr, "\nErrore nella lettura di un blocco del file di traiettoria.\n\n");
+        return -1;
+    }
+
+    const unsigned char *in = reader->chunk, *end = reader->chunk + chunkHeader[1];
+    int last = -1;
+
+    for (int f = 0; f < (int)chunkHeader[0] && f <= frameInChunk; f++)
+    {
+        double t;
+        if (end - in < (long int)sizeof(double))
+        {
+            fprintf(stderr, "\nBlocco del file di traiettoria danneggiato.\n\n");
+            return -1;
+        }
+        memcpy(&t, in, sizeof(double));
+        if (t > maxTime && f > 0)
+            break;
+        in += sizeof(double);
+
+        for (long int v = 0; v < reader->nValues; v++)
+        {
+            int64_t delta;
+            size_t n = get_varint(in, end, &delta);
+            if (n == 0)
+            {
+                fprintf(stderr, "\nBlocco del file di traiettoria danneggiato.\n\n");
+                return -1;
+            }
+            in += n;
+
+            int64_t q = predict(f, reader->prev1[v], reader->prev2[v]) + delta;
+            reader->prev2[v] = reader->prev1[v];
+            reader->prev1[v] = q;
+        }
+
+        *time = t;
+        last = f;
+    }
+
+    return last;
+}
+
+int trajreader_frame(TrajReader *reader, const long int frame, long double *time, long double *coord, long double *vel, long double *acc)
+{
+    if (frame < 0 || frame >= reader->nFrames)
+    {
+        return -1;
+    }
+
+    long int chunkIdx = frame / reader->framesPerChunk;
+    double t;
+
+    if (decode_chunk(reader, chunkIdx, (int)(frame - (long int)reader->indexFrames[chunkIdx]), INFINITY, &t) < 0)
+    {
+        return -1;
+    }
+
+    long int perField = (long int)reader->nBodies * reader->spatialDim;
+    long double *fields[N_FIELDS] = {coord, vel, acc};
+
+    for (int f = 0; f < N_FIELDS; f++)
+    {
+        if (!fields[f])
+            continue;
+
+        for (long int i = 0; i < perField; i++)
+        {
+            fields[f][i] = (long double)reader->prev1[i + f * perField] * reader->quantum;
+        }
+    }
+
+    *time = t;
+
+    return 0;
+}
+
+long int trajreader_find_time(TrajReader *reader, const double time)
+{
+    if (reader->nChunks == 0 || time < reader->indexTimes[0])
+    {
+        return -1;
+    }
+
+    // ultimo blocco che inizia non dopo time
+    long int lo = 0, hi = reader->nChunks - 1;
+    while (lo < hi)
+    {
+        long int mid = (lo + hi + 1) / 2;
+        if (reader->indexTimes[mid] <= time)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    double t;
+    int last = decode_chunk(reader, lo, reader->framesPerChunk - 1, time, &t);
+
+    return last < 0 ? -1 : (long int)reader->indexFrames[lo] + last;
+}
+
+void trajreader_close(TrajReader *reader)
+{
+    if (!reader)
+        return;
+
+    if (reader->file)
+        fclose(reader->file);
+
+    free(reader->masses);
+    free(reader->indexOffsets);
+    free(reader->indexFrames);
+    free(reader->indexTimes);
+    free(reader->chunk);
+    free(reader->prev1);
+    free(reader->prev2);
+    free(reader);
+}
@@ -0,0 +1,147 @@
+#ifndef TRAJSTORE_H
+#define TRAJSTORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// numero di frame per blocco di default
+#define TRAJSTORE_DEFAULT_CHUNK 256
+
+/**
+ * Struct per la scrittura di un file di traiettoria a blocchi.
+ *
+ * Formato del file (valori binari nell'ordine dei byte della macchina che lo scrive):
+ * - intestazione: "TBTRAJ1" con terminatore, nBodies, spatialDim, framesPerChunk (int32), quantum (double), masse (nBodies double);
+ * - blocchi: numero di frame (uint32) e lunghezza in byte (uint32) del contenuto, poi per ogni frame il tempo (double) e le
+ * componenti di coord, vel e acc quantizzate (intero più vicino a valore / quantum). Ogni intero è codificato come differenza
+ * dalla previsione lineare dei due frame precedenti dello stesso blocco, in zigzag e a lunghezza variabile (7 bit per byte);
+ * - indice: per ogni blocco la posizione nel file (uint64), il primo frame (uint64) e il tempo del primo frame (double);
+ * - coda: numero di blocchi, numero di frame, posizione dell'indice (uint64) e "TBIDX01" con terminatore.
+ *
+ * Ogni blocco si decodifica da solo, quindi per leggere il frame k basta leggere la coda, l'indice e un solo blocco.
+ */
+typedef struct
+{
+    FILE *file;
+    int nBodies;
+    int spatialDim;
+    int framesPerChunk;
+    double quantum;
+    long int nValues;
+    int64_t *prev1;
+    int64_t *prev2;
+    unsigned char *chunk;
+    size_t chunkCap;
+    size_t chunkUsed;
+    int chunkFrames;
+    uint64_t *indexOffsets;
+    uint64_t *indexFrames;
+    double *indexTimes;
+    long int nChunks;
+    long int capChunks;
+    long int nFrames;
+} TrajStore;
+
+/**
+ * Struct per la lettura ad accesso casuale di un file scritto con TrajStore.
+ */
+typedef struct
+{
+    FILE *file;
+    int nBodies;
+    int spatialDim;
+    int framesPerChunk;
+    double quantum;
+    long int nValues;
+    long double *masses;
+    long int nChunks;
+    long int nFrames;
+    uint64_t *indexOffsets;
+    uint64_t *indexFrames;
+    double *indexTimes;
+    unsigned char *chunk;
+    size_t chunkCap;
+    int64_t *prev1;
+    int64_t *prev2;
+} TrajReader;
+
+/**
+ * Funzione che crea un file di traiettoria a blocchi e ne scrive l'intestazione.
+ *
+ * @param path Percorso del file da creare.
+ * @param nBodies Numero di corpi del sistema.
+ * @param spatialDim Dimensione spaziale del sistema.
+ * @param framesPerChunk Numero di frame per blocco.
+ * @param quantum Passo di quantizzazione dei valori salvati (errore massimo quantum / 2).
+ * @param masses Puntatore al vettore delle masse dei corpi, salvate nell'intestazione.
+ *
+ * @return Puntatore alla struct allocata, NULL in caso di errore.
+ *
+ * @note La struct va chiusa con trajstore_close().
+ */
+TrajStore *trajstore_create(const char *path, const int nBodies, const int spatialDim, const int framesPerChunk, const double quantum,
+                            const long double *masses);
+
+/**
+ * Funzione che aggiunge un frame al blocco corrente e scrive il blocco nel file quando è completo.
+ *
+ * @param store Puntatore alla struct creata con trajstore_create.
+ * @param time Tempo fisico del frame.
+ * @param coord Puntatore al vettore delle posizioni dei corpi.
+ * @param vel Puntatore al vettore delle velocità dei corpi.
+ * @param acc Puntatore al vettore delle accelerazioni dei corpi.
+ *
+ * @return -1 in caso di errore (scrittura fallita o valore troppo grande per il quantum scelto), 0 di default.
+ */
+int trajstore_write(TrajStore *store, const long double time, const long double *coord, const long double *vel, const long double *acc);
+
+/**
+ * Funzione che scrive l'ultimo blocco, l'indice e la coda, chiude il file e libera la struct.
+ *
+ * @param store Puntatore alla struct creata con trajstore_create (può essere NULL).
+ *
+ * @return -1 in caso di errore, 0 di default.
+ */
+int trajstore_close(TrajStore *store);
+
+/**
+ * Funzione che apre un file di traiettoria a blocchi leggendone intestazione e indice.
+ *
+ * @param path Percorso del file.
+ *
+ * @return Puntatore alla struct allocata, NULL in caso di errore. Va chiusa con trajreader_close().
+ */
+TrajReader *trajreader_open(const char *path);
+
+/**
+ * Funzione che legge il frame numero frame (a partire da 0) decodificando soltanto il blocco che lo contiene.
+ *
+ * @param reader Puntatore alla struct aperta con trajreader_open.
+ * @param frame Numero del frame da leggere.
+ * @param time Puntatore in cui salvare il tempo del frame.
+ * @param coord Puntatore al vettore di nBodies * spatialDim elementi in cui salvare le posizioni (può essere NULL).
+ * @param vel Puntatore al vettore in cui salvare le velocità (può essere NULL).
+ * @param acc Puntatore al vettore in cui salvare le accelerazioni (può essere NULL).
+ *
+ * @return -1 in caso di errore o frame inesistente, 0 di default.
+ */
+int trajreader_frame(TrajReader *reader, const long int frame, long double *time, long double *coord, long double *vel, long double *acc);
+
+/**
+ * Funzione che cerca l'ultimo frame con tempo non superiore a time (ricerca binaria sull'indice e poi nel blocco).
+ *
+ * @param reader Puntatore alla struct aperta con trajreader_open.
+ * @param time Tempo cercato.
+ *
+ * @return Numero del frame, -1 se time precede il primo frame o in caso di errore.
+ */
+long int trajreader_find_time(TrajReader *reader, const double time);
+
+/**
+ * Funzione che chiude il file e libera la struct.
+ *
+ * @param reader Puntatore alla struct aperta con trajreader_open (può essere NULL).
+ */
+void trajreader_close(TrajReader *reader);
+
+#endif
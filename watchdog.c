@@ -0,0 +1,85 @@
+#include <math.h>
+
+#include "watchdog.h"
+
+void watchdog_init(Watchdog *wd, const long double tol, const long double energy0)
+{
+    wd->tol = tol;
+    wd->energy0 = energy0;
+    wd->energyScale = fabsl(energy0);
+    wd->maxErr = 0.L;
+    wd->lastTime = 0.L;
+    wd->nFit = 0;
+    wd->sumX = 0.L;
+    wd->sumY = 0.L;
+    wd->sumXX = 0.L;
+    wd->sumXY = 0.L;
+}
+
+int watchdog_check(Watchdog *wd, const long double time, const long double energy)
+{
+    long double err = fabsl(energy - wd->energy0);
+
+    if (wd->energyScale != 0.L)
+    {
+        err /= wd->energyScale;
+    }
+
+    if (err > wd->maxErr)
+    {
+        wd->maxErr = err;
+    }
+
+    // si usa il massimo (non l'errore istantaneo, che oscilla) e solo quando è diverso da 0 perché serve il logaritmo
+    if (wd->maxErr > 0.L && time > 0.L)
+    {
+        long double x = logl(time), y = logl(wd->maxErr);
+
+        wd->nFit++;
+        wd->sumX += x;
+        wd->sumY += y;
+        wd->sumXX += x * x;
+        wd->sumXY += x * y;
+    }
+
+    wd->lastTime = time;
+
+    return err > wd->tol;
+}
+
+long double watchdog_suggest_dt(const Watchdog *wd, const long double dt, const int order, const long double tEnd, long double *beta)
+{
+    long double slope = 0.L;
+    long double den = wd->nFit * wd->sumXX - wd->sumX * wd->sumX;
+
+    if (wd->nFit >= 2 && den > 0.L)
+    {
+        slope = (wd->nFit * wd->sumXY - wd->sumX * wd->sumY) / den;
+    }
+
+    // un errore massimo non può decrescere; una crescita più veloce di t^2 viene limitata per non suggerire dt inutilmente piccoli
+    // a causa di pochi punti iniziali
+    if (slope < 0.L)
+        slope = 0.L;
+    if (slope > 2.L)
+        slope = 2.L;
+
+    if (beta)
+    {
+        *beta = slope;
+    }
+
+    if (wd->maxErr <= 0.L)
+    {
+        return dt;
+    }
+
+    // errore previsto alla fine della simulazione con il dt attuale, poi dt ridotto secondo err ~ dt^order
+    long double projected = wd->maxErr;
+    if (tEnd > wd->lastTime && wd->lastTime > 0.L)
+    {
+        projected *= powl(tEnd / wd->lastTime, slope);
+    }
+
+    return WATCHDOG_SAFETY * dt * powl(wd->tol / projected, 1.L / order);
+}
@@ -0,0 +1,62 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+// fattore di sicurezza applicato al dt suggerito
+#define WATCHDOG_SAFETY 0.8L
+
+/**
+ * Struct del controllo sulla deriva dell'energia. Ad ogni controllo viene aggiornato il massimo dell'errore relativo sull'energia
+ * osservato fino a quel momento e, per stimare come cresce nel tempo, viene accumulata la regressione lineare di log(errore massimo)
+ * su log(t): la pendenza beta descrive una crescita dell'errore come t^beta (0 per errore limitato, 1 per deriva lineare, ecc.).
+ * energy0 è l'energia di riferimento, che le fusioni spostano, mentre l'errore resta relativo a energyScale = |E0| iniziale: dopo una
+ * fusione l'energia di riferimento può essere molto più piccola di quella iniziale e l'errore relativo a essa perderebbe significato.
+ */
+typedef struct
+{
+    long double tol;
+    long double energy0;
+    long double energyScale;
+    long double maxErr;
+    long double lastTime;
+    long int nFit;
+    long double sumX;
+    long double sumY;
+    long double sumXX;
+    long double sumXY;
+} Watchdog;
+
+/**
+ * Funzione che inizializza il controllo sulla deriva dell'energia.
+ *
+ * @param wd Puntatore alla struct da inizializzare.
+ * @param tol Errore relativo massimo tollerato sull'energia totale.
+ * @param energy0 Energia totale iniziale.
+ */
+void watchdog_init(Watchdog *wd, const long double tol, const long double energy0);
+
+/**
+ * Funzione che aggiorna il controllo con l'energia totale al tempo time.
+ *
+ * @param wd Puntatore alla struct inizializzata con watchdog_init.
+ * @param time Tempo fisico (positivo).
+ * @param energy Energia totale al tempo time.
+ *
+ * @return 1 se l'errore relativo supera la tolleranza e la simulazione va interrotta, 0 di default.
+ */
+int watchdog_check(Watchdog *wd, const long double time, const long double energy);
+
+/**
+ * Funzione che suggerisce il dt con cui l'errore sull'energia resterebbe entro la tolleranza fino al tempo finale tEnd, estrapolando
+ * l'errore osservato con la crescita t^beta stimata e usando la scala dt^order dell'integratore.
+ *
+ * @param wd Puntatore alla struct aggiornata con watchdog_check.
+ * @param dt Passo di integrazione usato.
+ * @param order Ordine dell'integratore (2 per Velocity Verlet, 4 per Yoshida).
+ * @param tEnd Tempo fisico finale previsto della simulazione.
+ * @param beta Puntatore in cui salvare l'esponente di crescita stimato (può essere NULL).
+ *
+ * @return dt suggerito.
+ */
+long double watchdog_suggest_dt(const Watchdog *wd, const long double dt, const int order, const long double tEnd, long double *beta);
+
+#endif